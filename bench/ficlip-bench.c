@@ -0,0 +1,412 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "ficlip.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <argp.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef FI_VERSION
+#define FI_VERSION "unknown"
+#endif
+
+static char args_doc[] = "[-f csv|json] [-s SEED] [-r REPEAT] [-n SCALE] "
+                         "[-w WORKLOAD]";
+
+static char doc[] =
+    "\nBenchmark of ficlip on generated workloads (random polygons, stars, "
+    "spirals, near-degenerate grids, curve-heavy paths and large rings).\n"
+    "For each workload and stage (parse, linearize, offset, copy, draw, "
+    "draw_shortest and clip), prints the mean time per operation, the time "
+    "per vertex of the input and the heap allocations per operation.";
+
+static struct argp_option options[] = {
+    {"format", 'f', "FORMAT", 0, "Output format, csv (default) or json"},
+    {"seed", 's', "SEED", 0, "Seed of the generators (default 1)"},
+    {"repeat", 'r', "REPEAT", 0, "Runs of each stage (default 10)"},
+    {"scale", 'n', "SCALE", 0, "Size factor of the workloads (default 1)"},
+    {"workload", 'w', "WORKLOAD", 0, "Only run this workload"},
+    {0}};
+
+struct arguments {
+    bool json;
+    uint64_t seed;
+    int repeat;
+    double scale;
+    char *workload;
+};
+
+/*
+ * Allocation counter: malloc and friends are wrapped to count the calls made
+ * by the library (glibc only, the counts are -1 elsewhere).
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static _Atomic size_t n_alloc = 0;
+
+void *malloc(size_t size) {
+    n_alloc++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    n_alloc++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    n_alloc++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) { __libc_free(ptr); }
+
+#define BENCH_ALLOCS() ((long)n_alloc)
+#else
+#define BENCH_ALLOCS() (-1L)
+#endif
+
+/* Deterministic generator (xorshift64*), same sequence on all platforms. */
+typedef struct {
+    uint64_t state;
+} BENCH_RNG;
+
+double bench_rand(BENCH_RNG *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return (rng->state * 0x2545F4914F6CDD1DULL >> 11) * 0x1.0p-53;
+}
+
+/* Generators, writing SVG path data of n vertices (roughly) in ~[0, 1000]. */
+typedef void (*BENCH_GEN)(BENCH_RNG *rng, size_t n, FILE *out);
+
+int bench_compare_double_p(const void *in_1, const void *in_2) {
+    double d1 = *(const double *)in_1;
+    double d2 = *(const double *)in_2;
+    return d1 < d2 ? -1 : d1 > d2;
+}
+
+void gen_random(BENCH_RNG *rng, size_t n, FILE *out) {
+    // star-shaped around the center: random angles in order, random radii
+    double *angles = malloc(n * sizeof(double));
+    for (size_t i = 0; i < n; i++)
+        angles[i] = bench_rand(rng) * 2 * M_PI;
+    qsort(angles, n, sizeof(double), bench_compare_double_p);
+    for (size_t i = 0; i < n; i++) {
+        double r = 100 + 400 * bench_rand(rng);
+        fprintf(out, "%c %.17g,%.17g ", i ? 'L' : 'M',
+                500 + r * cos(angles[i]), 500 + r * sin(angles[i]));
+    }
+    fprintf(out, "Z");
+    free(angles);
+}
+
+void gen_star(BENCH_RNG *rng, size_t n, FILE *out) {
+    double phase = bench_rand(rng);
+    for (size_t i = 0; i < n; i++) {
+        double a = (i + phase) * 2 * M_PI / n;
+        double r = i % 2 ? 150 : 480;
+        fprintf(out, "%c %.17g,%.17g ", i ? 'L' : 'M', 500 + r * cos(a),
+                500 + r * sin(a));
+    }
+    fprintf(out, "Z");
+}
+
+void gen_spiral(BENCH_RNG *rng, size_t n, FILE *out) {
+    // a band wound 8 times, out along its outer side, back along its inner one
+    size_t half = n / 2;
+    double turns = 8;
+    double phase = bench_rand(rng) * 2 * M_PI;
+    for (size_t i = 0; i < n; i++) {
+        size_t j = i < half ? i : n - 1 - i;
+        double t = (double)j / half;
+        double a = phase + t * turns * 2 * M_PI;
+        double r = 20 + t * 440 + (i < half ? 20 : 0);
+        fprintf(out, "%c %.17g,%.17g ", i ? 'L' : 'M', 500 + r * cos(a),
+                500 + r * sin(a));
+    }
+    fprintf(out, "Z");
+}
+
+void gen_grid(BENCH_RNG *rng, size_t n, FILE *out) {
+    // squares sharing their sides, moved by a few ulps
+    size_t side = (size_t)ceil(sqrt(n / 4.0));
+    double cell = 1000.0 / side;
+    for (size_t i = 0; i < side; i++) {
+        for (size_t j = 0; j < side; j++) {
+            double x = i * cell + (bench_rand(rng) - 0.5) * 1e-12;
+            double y = j * cell + (bench_rand(rng) - 0.5) * 1e-12;
+            fprintf(out, "M %.17g,%.17g L %.17g,%.17g L %.17g,%.17g "
+                         "L %.17g,%.17g Z ",
+                    x, y, x + cell, y, x + cell, y + cell, x, y + cell);
+        }
+    }
+}
+
+void gen_curves(BENCH_RNG *rng, size_t n, FILE *out) {
+    // a ring of quadratic and cubic Bezier curves and elliptic arcs
+    size_t n_seg = n / 3 ? n / 3 : 1;
+    fprintf(out, "M 980,500 ");
+    for (size_t i = 0; i < n_seg; i++) {
+        double a0 = i * 2 * M_PI / n_seg;
+        double a1 = (i + 1) * 2 * M_PI / n_seg;
+        double r = 380 + 100 * bench_rand(rng);
+        double x = 500 + 480 * cos(a1);
+        double y = 500 + 480 * sin(a1);
+        double c = 2 * M_PI / n_seg / 3;
+        switch (i % 3) {
+        case 0:
+            fprintf(out, "Q %.17g,%.17g %.17g,%.17g ",
+                    500 + r * cos(a0 + c), 500 + r * sin(a0 + c), x, y);
+            break;
+        case 1:
+            fprintf(out, "C %.17g,%.17g %.17g,%.17g %.17g,%.17g ",
+                    500 + r * cos(a0 + c), 500 + r * sin(a0 + c),
+                    500 + r * cos(a1 - c), 500 + r * sin(a1 - c), x, y);
+            break;
+        default:
+            fprintf(out, "A %.17g,%.17g %.17g 0,1 %.17g,%.17g ", r / 2, r / 3,
+                    bench_rand(rng) * 90, x, y);
+            break;
+        }
+    }
+    fprintf(out, "Z");
+}
+
+void gen_large(BENCH_RNG *rng, size_t n, FILE *out) {
+    // a regular polygon, slightly noisy
+    for (size_t i = 0; i < n; i++) {
+        double a = i * 2 * M_PI / n;
+        double r = 480 - bench_rand(rng) * 1e-3;
+        fprintf(out, "%c %.17g,%.17g ", i ? 'L' : 'M', 500 + r * cos(a),
+                500 + r * sin(a));
+    }
+    fprintf(out, "Z");
+}
+
+typedef struct {
+    const char *name; /* Name of the workload. */
+    BENCH_GEN gen;    /* Generator of the subject. */
+    size_t n;         /* Number of vertices at scale 1. */
+    FI_POINT_D shift; /* Offset of the clip (a copy of the subject). */
+} BENCH_WORKLOAD;
+
+static BENCH_WORKLOAD workloads[] = {
+    {"random", gen_random, 2000, {50, 30}},
+    {"star", gen_star, 2000, {7, 3}},
+    {"spiral", gen_spiral, 4000, {11, 0}},
+    {"grid", gen_grid, 4000, {31.25, 0}},
+    {"curves", gen_curves, 600, {40, 20}},
+    {"large", gen_large, 100000, {1, 1}},
+};
+
+/* Stages, each run on the subject (and the clip for the clippings). */
+typedef enum {
+    STAGE_PARSE,
+    STAGE_LINEARIZE,
+    STAGE_OFFSET,
+    STAGE_COPY,
+    STAGE_DRAW,
+    STAGE_DRAW_SHORTEST,
+    STAGE_CLIP_AND,
+    STAGE_CLIP_OR,
+    STAGE_CLIP_XOR,
+    STAGE_CLIP_DIFF,
+    STAGE_COUNT,
+} BENCH_STAGE;
+
+static const char *stage_names[] = {
+    "parse",         "linearize", "offset",  "copy",     "draw",
+    "draw_shortest", "clip_and",  "clip_or", "clip_xor", "clip_diff"};
+
+typedef struct {
+    const char *svg; /* Path data of the subject. */
+    FI_PATH *subject;
+    FI_PATH *clip;
+    FI_PATH *moved; /* Copy of the subject moved by the offsets. */
+    FILE *null;
+} BENCH_INPUT;
+
+size_t bench_vertices(FI_PATH *path) {
+    size_t n = 0;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next)
+        n += tmp->section.n_point;
+    return n;
+}
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Run a stage once, returns its duration (ns), *allocs its allocations. */
+double bench_run(BENCH_INPUT *in, BENCH_STAGE stage, long *allocs) {
+    static const FI_OPS ops[] = {FI_AND, FI_OR, FI_XOR, FI_DIFF};
+    FI_PATH *out = NULL;
+    FI_WRITER w;
+    long a0 = BENCH_ALLOCS();
+    double t0 = bench_now();
+    switch (stage) {
+    case STAGE_PARSE:
+        fi_parse_path(in->svg, strlen(in->svg), &out);
+        break;
+    case STAGE_LINEARIZE:
+        fi_linearize_to(in->subject, 0, &out);
+        break;
+    case STAGE_OFFSET:
+        fi_offset_path(in->moved, (FI_POINT_D){1, -1});
+        break;
+    case STAGE_COPY:
+        fi_copy_path(in->subject, &out);
+        break;
+    case STAGE_DRAW:
+        fi_draw_path(in->subject, in->null);
+        fflush(in->null);
+        break;
+    case STAGE_DRAW_SHORTEST:
+        // shortest text which reads back exactly, in memory
+        fi_writer_init(&w, NULL, 0);
+        w.precision = -1;
+        fi_write_path(&w, in->subject);
+        fi_writer_free(&w);
+        break;
+    default:
+        fi_clip(in->subject, in->clip, ops[stage - STAGE_CLIP_AND], &out);
+        break;
+    }
+    double t = bench_now() - t0;
+    *allocs = BENCH_ALLOCS() - a0;
+    if (out != NULL)
+        fi_free_path(out);
+    return t;
+}
+
+void bench_workload(BENCH_WORKLOAD *wl, struct arguments *args, bool *first) {
+    BENCH_RNG rng = {args->seed * 0x9E3779B97F4A7C15ULL + 1};
+    size_t n = (size_t)(wl->n * args->scale);
+    char *svg;
+    size_t len;
+    FILE *stream = open_memstream(&svg, &len);
+    wl->gen(&rng, n > 3 ? n : 3, stream);
+    fclose(stream);
+
+    BENCH_INPUT in = {svg, NULL, NULL, NULL, fopen("/dev/null", "w")};
+    if (fi_parse_path(svg, len, &in.subject)) {
+        fprintf(stderr, "%s: invalid generated path\n", wl->name);
+        exit(EXIT_FAILURE);
+    }
+    fi_copy_path(in.subject, &in.clip);
+    fi_offset_path(in.clip, wl->shift);
+    fi_copy_path(in.subject, &in.moved);
+    size_t n_vertex = bench_vertices(in.subject);
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        // the first run warms the caches up and is not counted
+        long allocs;
+        double total = 0;
+        double best = INFINITY;
+        bench_run(&in, stage, &allocs);
+        for (int i = 0; i < args->repeat; i++) {
+            double t = bench_run(&in, stage, &allocs);
+            total += t;
+            best = t < best ? t : best;
+        }
+        double mean = total / args->repeat;
+
+        if (args->json)
+            printf("%s\n    {\"workload\": \"%s\", \"stage\": \"%s\", "
+                   "\"vertices\": %zu, \"runs\": %d, \"ns_per_op\": %.0f, "
+                   "\"ns_per_op_min\": %.0f, \"ns_per_vertex\": %.3f, "
+                   "\"allocs_per_op\": %ld}",
+                   *first ? "" : ",", wl->name, stage_names[stage], n_vertex,
+                   args->repeat, mean, best, mean / n_vertex, allocs);
+        else
+            printf("%s,%s,%zu,%d,%.0f,%.0f,%.3f,%ld\n", wl->name,
+                   stage_names[stage], n_vertex, args->repeat, mean, best,
+                   mean / n_vertex, allocs);
+        *first = false;
+    }
+
+    fclose(in.null);
+    fi_free_path(in.subject);
+    fi_free_path(in.clip);
+    fi_free_path(in.moved);
+    free(svg);
+}
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state) {
+    struct arguments *args = state->input;
+    switch (key) {
+    case 'f':
+        if (strcmp(arg, "json") && strcmp(arg, "csv"))
+            argp_error(state, "unknown format '%s'", arg);
+        args->json = !strcmp(arg, "json");
+        break;
+    case 's':
+        args->seed = strtoull(arg, NULL, 10);
+        break;
+    case 'r':
+        args->repeat = atoi(arg);
+        if (args->repeat < 1)
+            argp_error(state, "invalid repeat count '%s'", arg);
+        break;
+    case 'n':
+        args->scale = atof(arg);
+        if (!(args->scale > 0))
+            argp_error(state, "invalid scale '%s'", arg);
+        break;
+    case 'w':
+        args->workload = arg;
+        break;
+    default:
+        return ARGP_ERR_UNKNOWN;
+    }
+    return 0;
+}
+
+static struct argp argp = {options, parse_opt, args_doc, doc};
+
+int main(int argc, char **argv) {
+    struct arguments args = {false, 1, 10, 1, NULL};
+    argp_parse(&argp, argc, argv, 0, 0, &args);
+
+    size_t n_workload = sizeof(workloads) / sizeof(workloads[0]);
+    size_t i = 0;
+    while (args.workload != NULL && i < n_workload &&
+           strcmp(args.workload, workloads[i].name))
+        i++;
+    if (i == n_workload) {
+        fprintf(stderr, "unknown workload '%s'\n", args.workload);
+        return EXIT_FAILURE;
+    }
+
+    if (args.json)
+        printf("{\"version\": \"%s\", \"seed\": %llu, \"scale\": %g, "
+               "\"results\": [",
+               FI_VERSION, (unsigned long long)args.seed, args.scale);
+    else
+        printf("workload,stage,vertices,runs,ns_per_op,ns_per_op_min,"
+               "ns_per_vertex,allocs_per_op\n");
+
+    bool first = true;
+    for (size_t i = 0; i < n_workload; i++)
+        if (args.workload == NULL || !strcmp(args.workload, workloads[i].name))
+            bench_workload(&workloads[i], &args, &first);
+    if (args.json)
+        printf("\n]}\n");
+    return EXIT_SUCCESS;
+}
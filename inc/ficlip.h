@@ -9,18 +9,19 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /**
- * @brief Default maximum length of a path.
+ * @brief Default maximum length of a path (0 for no limit).
  */
-#define DEFAULT_MAX_PATH_LENGTH 1000
+#define DEFAULT_MAX_PATH_LENGTH 0
 
 /**
  * @brief Error code for parsing failure.
  */
 #define ERR_PARSING_FAIL 0x01
 /**
- * @brief Error code for path being too long.
+ * @brief Error code for path being longer than its n_max.
  */
 #define ERR_PATH_TOO_LONG 0x02
 /**
@@ -31,6 +32,37 @@
  * @brief Error code for section being too short.
  */
 #define ERR_PATH_SECTION_TOO_SHORT 0x04
+/**
+ * @brief Error code for a full output buffer.
+ */
+#define ERR_BUFFER_FULL 0x05
+/**
+ * @brief Error code for invalid binary path data.
+ */
+#define ERR_BINARY_FORMAT 0x06
+/**
+ * @brief Error code for binary path data of an unsupported version.
+ */
+#define ERR_BINARY_VERSION 0x07
+/**
+ * @brief Error code for a file which cannot be read or mapped.
+ */
+#define ERR_IO 0x08
+/**
+ * @brief Error code for a fixed-point scale which is not positive, or puts a
+ *        point out of the grid.
+ */
+#define ERR_FIXED_RANGE 0x09
+
+/**
+ * @brief Magic string at the start of binary path data (8 bytes with the
+ * terminating 0).
+ */
+#define FI_BINARY_MAGIC "FICLIPB"
+/**
+ * @brief Version of the binary path data written by fi_save_binary().
+ */
+#define FI_BINARY_VERSION 1
 
 /**
  * @brief Type of segments.
@@ -87,13 +119,28 @@ typedef struct _FI_META {
     struct _FI_PATH *last;  /**< Pointer to the last path. */
     struct _FI_PATH *first; /**< Pointer to the first path. */
     int n_total;            /**< Total number of paths. */
-    int n_max;              /**< Maximum number of paths. */
+    int n_max;              /**< Maximum number of paths (0 for no
+                               limit). */
     int n_end;              /**< Number of end segments. */
     int n_move;             /**< Number of move segments. */
     int n_line;             /**< Number of line segments. */
     int n_arc;              /**< Number of arc segments. */
     int n_qbez;             /**< Number of quadratic Bezier segments. */
     int n_cbez;             /**< Number of cubic Bezier segments. */
+    struct _FI_PACKED_PATH *packed; /**< Packed path the points of a view are
+                                       borrowed from (NULL otherwise). */
+    struct _FI_PATH *nodes;         /**< Block holding the segments of a
+                                       view. */
+    struct _FI_ARENA *arena;        /**< Arena the segments are allocated
+                                       from (NULL if allocated one by
+                                       one). */
+    FI_POINT_D bbox[2]; /**< Bounding box cached by fi_path_bbox(). */
+    bool bbox_valid;    /**< bbox is up to date, cleared when a segment is
+                           added (set it to false after changing points in
+                           place). */
+    bool convex;        /**< Convexity cached by fi_path_convex(). */
+    bool convex_valid;  /**< convex is up to date, cleared along with
+                           bbox_valid. */
 } FI_META;
 
 /**
@@ -106,10 +153,97 @@ typedef struct _FI_PATH {
     struct _FI_PATH *prev;   /**< Pointer to the previous path. */
 } FI_PATH;
 
+/**
+ * @brief Contiguous representation of a path.
+ *
+ * @details Segments are stored in a packed type array and their points in a
+ * packed coordinate array, in order (0 point for Z, 1 for M/L, 2 for Q, 3 for
+ * C/A, as in FI_PATH_SECTION). Each subpath starts with a M segment.
+ */
+typedef struct _FI_PACKED_PATH {
+    unsigned char *types; /**< Type of each segment (low nibble) and its flags
+                             (high nibble). */
+    FI_POINT_D *points;   /**< Points of all the segments. */
+    size_t *subpaths;     /**< Index of the first segment of each subpath. */
+    size_t n_seg;         /**< Number of segments. */
+    size_t n_point;       /**< Number of points. */
+    size_t n_subpath;     /**< Number of subpaths. */
+    size_t s_seg;         /**< Allocated size of types. */
+    size_t s_point;       /**< Allocated size of points. */
+    size_t s_subpath;     /**< Allocated size of subpaths. */
+    bool borrowed;        /**< The arrays are not owned (loaded binary data),
+                             they are copied before being grown. */
+    void *map;            /**< File mapping the arrays point into (or NULL),
+                             unmapped by fi_free_packed(). */
+    size_t s_map;         /**< Size of the mapping. */
+} FI_PACKED_PATH;
+
+/**
+ * @brief Header of binary path data.
+ *
+ * @details Binary path data is this header followed by the packed points
+ * (n_point pairs of doubles), the index of the first segment of each subpath
+ * (n_subpath 64 bits integers) and the segment types (n_seg bytes, as in
+ * FI_PACKED_PATH), then padded with zeros to a multiple of 8 bytes. All the
+ * values are little-endian. The arrays start at offset header_size, a multiple
+ * of 16, so that data mapped from a file can be used in place.
+ */
+typedef struct _FI_BINARY_HEADER {
+    char magic[8];        /**< FI_BINARY_MAGIC. */
+    uint32_t version;     /**< Version of the format. */
+    uint32_t header_size; /**< Size of the header in bytes. */
+    uint64_t n_seg;       /**< Number of segments. */
+    uint64_t n_point;     /**< Number of points. */
+    uint64_t n_subpath;   /**< Number of subpaths. */
+    uint32_t n_end;       /**< Number of end segments. */
+    uint32_t n_move;      /**< Number of move segments. */
+    uint32_t n_line;      /**< Number of line segments. */
+    uint32_t n_arc;       /**< Number of arc segments. */
+    uint32_t n_qbez;      /**< Number of quadratic Bezier segments. */
+    uint32_t n_cbez;      /**< Number of cubic Bezier segments. */
+    FI_POINT_D bbox[2];   /**< Minimum and maximum of the points of the
+                             path (control points included, arcs bounded
+                             by the circle of their largest radius). */
+} FI_BINARY_HEADER;
+
+/**
+ * @brief Writer of SVG path data in a memory buffer.
+ *
+ * @details Initialized by fi_writer_init(), the output options can then be
+ * changed. The buffer is always terminated by 0.
+ */
+typedef struct _FI_WRITER {
+    char *buf;      /**< Output buffer. */
+    size_t len;     /**< Number of characters in the buffer. */
+    size_t size;    /**< Size of the buffer. */
+    bool growable;  /**< The buffer is allocated by the writer and grows. */
+    FILE *out;      /**< Stream where the buffer is flushed when full (or
+                       NULL). */
+    int precision;  /**< Digits after the point (4 by default, at most 22), < 0
+                       for the shortest text which reads back exactly. */
+    bool relative;  /**< Relative commands (m, l, a, q, c, z). */
+    int err;        /**< Error code of the last failed write. */
+    FI_POINT_D cur; /**< Current point, as read back. */
+    FI_POINT_D start; /**< Start of the current subpath, as read back. */
+} FI_WRITER;
+
 /**
  * @brief Build the clipping path from paths "p1" and "p2" with operation "ops".
  *        Result in FIPATH **out, return integer error code.
  *
+ * @details Operands with disjoint bounding boxes, or one of them within the
+ * other with no edges crossing its box, are answered without a sweep: nothing
+ * for AND, a copy of p1 for DIFF, the two paths one after the other for OR and
+ * XOR (see fi_path_bbox()). Likewise, the subpaths whose box meets no box of
+ * another subpath are left out of the sweep, and copied to the result when
+ * they are part of it. Small operands whose edges have no common point (see
+ * fi_intersects()) are answered ring by ring, each ring being inside or
+ * outside of the other operand.
+ *
+ * The AND of convex paths (see fi_path_convex()) walks along both boundaries
+ * at once, and an axis-aligned rectangle clips the other path with
+ * fi_clip_rect(), in linear time either way.
+ *
  * @param p1   The first path.
  * @param p2   The second path.
  * @param ops  The operation to be performed (AND, OR, XOR, DIFF).
@@ -119,6 +253,190 @@ typedef struct _FI_PATH {
  */
 int fi_clip(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
 
+/**
+ * @brief Same as fi_clip(), with the points on a fixed-point grid.
+ *
+ * @details The coordinates are multiplied by scale and rounded to integers,
+ * which must stay within +/-33554431 (2^25 - 1): in that range every
+ * orientation test of the sweep is exact. The intersections are rounded to the
+ * grid with snap rounding: a first sweep finds them, and every edge going
+ * through the pixel of a rounded intersection or of a vertex is bent through
+ * its grid point. The result only depends on the grid points: it is the same
+ * on every machine and for every call, for 2 to 3 times the cost of
+ * fi_clip(). The points of the result are the grid points divided by scale.
+ *
+ * @param p1     The first path.
+ * @param p2     The second path.
+ * @param ops    The operation to be performed (AND, OR, XOR, DIFF).
+ * @param scale  Grid points per unit (1000 to keep 3 decimals).
+ * @param out    Pointer to the result path.
+ *
+ * @return       Integer error code (0 if successful, ERR_FIXED_RANGE if the
+ *               scale is not positive or a point is out of the grid).
+ */
+int fi_clip_fixed(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, double scale,
+                  FI_PATH **out);
+
+/**
+ * @brief Clip a path to an axis-aligned rectangle, same result as fi_clip()
+ * with FI_AND and the rectangle as clip path.
+ *
+ * @details Runs in linear time (plus sorting the points where the subject
+ * crosses the border). The parts of the rings inside the rectangle are joined
+ * by the parts of the border inside the subject (even-odd rule), concave
+ * subjects and many rings included; no zero-width spike is left along the
+ * border. An empty rectangle gives an empty result.
+ *
+ * @param subject  The subject path.
+ * @param rect     Minimum and maximum corners of the rectangle.
+ * @param out      Pointer to the result path.
+ *
+ * @return         Integer error code (0 if successful).
+ */
+int fi_clip_rect(FI_PATH *subject, FI_POINT_D *rect, FI_PATH **out);
+
+/**
+ * @brief Clip path prepared for clipping many subjects (see
+ * fi_prepare_clip()).
+ */
+typedef struct _FI_PREPARED FI_PREPARED;
+
+/**
+ * @brief Prepare a clip path for clipping many subjects with
+ * fi_clip_prepared().
+ *
+ * @details The clip path is validated, linearized and swept once: its edges
+ * are split at their self intersections, sorted and indexed by x buckets, and
+ * its bounding box is kept. The prepared path does not refer to the clip path,
+ * and is only read by fi_clip_prepared() (which can run in parallel).
+ *
+ * @param clip  The clip path.
+ * @param out   Pointer to the prepared clip path.
+ *
+ * @return      Integer error code (0 if successful).
+ */
+int fi_prepare_clip(FI_PATH *clip, FI_PREPARED **out);
+
+/**
+ * @brief Clip a path with a prepared clip path, same result as
+ * fi_clip(subject, clip, ops, out).
+ *
+ * @details For FI_AND and FI_DIFF, only the edges of the clip path in the x
+ * range of the subject are part of the sweep, and a subject out of the
+ * bounding box of the clip path is answered at once as by fi_clip().
+ *
+ * @param prepared  The prepared clip path.
+ * @param subject   The subject path.
+ * @param ops       The operation to be performed (AND, OR, XOR, DIFF).
+ * @param out       Pointer to the result path.
+ *
+ * @return          Integer error code (0 if successful).
+ */
+int fi_clip_prepared(FI_PREPARED *prepared, FI_PATH *subject, FI_OPS ops,
+                     FI_PATH **out);
+
+/**
+ * @brief Free a prepared clip path.
+ *
+ * @param prepared  Pointer to the prepared clip path.
+ */
+void fi_free_prepared(FI_PREPARED *prepared);
+
+/**
+ * @brief One clipping of a batch (see fi_clip_batch()).
+ */
+typedef struct _FI_CLIP_JOB {
+    FI_PATH *subject; /**< The first path. */
+    FI_PATH *clip;    /**< The second path. */
+    FI_OPS ops;       /**< The operation to be performed. */
+    FI_PATH *out;     /**< Result path, set by fi_clip_batch(). */
+    int ret;          /**< Error code of the clipping, set by
+                         fi_clip_batch(). */
+} FI_CLIP_JOB;
+
+/**
+ * @brief Run the clippings of a batch of jobs on a pool of threads.
+ *
+ * @details Each job gets the result of fi_clip(job->subject, job->clip,
+ * job->ops, &job->out), the results are in the order of the jobs. The jobs are
+ * split between the threads, a thread with no job left steals half of the
+ * remaining jobs of another one. Each thread reuses its sweep buffers from one
+ * job to the next. The bounding boxes of the paths (and the convexity of the
+ * operands of FI_AND) are cached before the threads start, the paths are then
+ * only read and the same path can be used by several jobs.
+ *
+ * @param jobs      The jobs.
+ * @param n_job     Number of jobs.
+ * @param n_thread  Number of threads (the calling thread included), <= 0 for
+ *                  the number of online processors.
+ *
+ * @return          Error code of the first job which failed (0 if all
+ *                  successful).
+ */
+int fi_clip_batch(FI_CLIP_JOB *jobs, size_t n_job, int n_thread);
+
+/**
+ * @brief Clip many paths together: their union (OR), intersection (AND),
+ * symmetric difference (XOR), or the first path minus all the others (DIFF).
+ *
+ * @details The paths are clipped in pairs, then the results in pairs, and so
+ * on, each level being a batch run with fi_clip_batch(). Nearby paths (by the
+ * center of their box) are paired first. The cost is close to the one of a
+ * single sweep over all the edges times the log of the number of paths,
+ * instead of one sweep of the growing result per path.
+ *
+ * @param paths     The paths (NULL for an empty one), only read.
+ * @param n         Number of paths.
+ * @param ops       The operation to be performed.
+ * @param n_thread  Number of threads (see fi_clip_batch()).
+ * @param out       Pointer to the result path (NULL for no path).
+ *
+ * @return          Integer error code (0 if successful).
+ */
+int fi_clip_many(FI_PATH **paths, size_t n, FI_OPS ops, int n_thread,
+                 FI_PATH **out);
+
+/**
+ * @brief Face of an overlay (see fi_overlay()).
+ */
+typedef struct _FI_OVERLAY_FACE {
+    FI_PATH *path;  /**< Part of the subject, one or more subpaths. */
+    size_t *labels; /**< Indexes of the clip paths covering it, ascending. */
+    size_t n_label; /**< Number of labels (0 for the part of the subject
+                       covered by no clip path). */
+} FI_OVERLAY_FACE;
+
+/**
+ * @brief Cut a subject along the boundaries of many clip paths at once.
+ *
+ * @details The subject is split in faces, each face being the part of the
+ * subject covered by exactly the same clip paths, given as its labels. All
+ * the faces with the same labels form a single path. The subject and the clip
+ * paths meeting its bounding box go through a single sweep, each edge being
+ * labeled with the operands covering the region above it, so that the cost
+ * grows with the total number of edges and intersections instead of the
+ * number of clip paths times the size of the subject. The faces are sorted by
+ * labels.
+ *
+ * @param subject   The subject path (NULL for no face).
+ * @param clips     The clip paths (NULL for an empty one).
+ * @param n_clip    Number of clip paths.
+ * @param faces     Pointer to the faces, to be freed with fi_free_overlay().
+ * @param n_face    Pointer to the number of faces.
+ *
+ * @return          Integer error code (0 if successful).
+ */
+int fi_overlay(FI_PATH *subject, FI_PATH **clips, size_t n_clip,
+               FI_OVERLAY_FACE **faces, size_t *n_face);
+
+/**
+ * @brief Free the faces of an overlay.
+ *
+ * @param faces   The faces.
+ * @param n_face  Number of faces.
+ */
+void fi_free_overlay(FI_OVERLAY_FACE *faces, size_t n_face);
+
 /**
  * @brief Add a new segment of a given type to a FI_PATH.
  *
@@ -129,6 +447,20 @@ int fi_clip(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
  */
 int fi_append_new_seg(FI_PATH **path, FI_SEG_TYPE type);
 
+/**
+ * @brief Reserve the storage of segments to be appended to a FI_PATH.
+ *
+ * @details The segments of the path are allocated from one arena, with room
+ * for n_seg more segments of up to one point (M, L or Z) in a single block, so
+ * that appending them does not allocate. Segments allocated one by one (no
+ * PATH_ARENA) are moved to the arena, *path is updated. Nothing is done for a
+ * NULL path.
+ *
+ * @param path   Pointer to the path.
+ * @param n_seg  Number of segments to reserve.
+ */
+void fi_reserve_path(FI_PATH **path, size_t n_seg);
+
 /**
  * @brief Free a FI_PATH structure.
  *
@@ -152,6 +484,83 @@ void fi_copy_path(FI_PATH *in, FI_PATH **out);
  */
 void fi_offset_path(FI_PATH *in, FI_POINT_D pt);
 
+/**
+ * @brief Bounding box of a path.
+ *
+ * @details The box holds all the points of the segments, the control points of
+ * the Bezier curves included (a curve is within their convex hull) and an arc
+ * is bounded by the circle of its largest radius. It is cached in the meta of
+ * the path until a segment is added.
+ *
+ * @param path  The path.
+ * @param bbox  Minimum and maximum corners of the box ({inf, inf} and {-inf,
+ *              -inf} for a path without points).
+ */
+void fi_path_bbox(FI_PATH *path, FI_POINT_D *bbox);
+
+/**
+ * @brief The path is a single convex ring.
+ *
+ * @details Found in one pass over the corners: they all turn the same way and
+ * the ring goes around once. Repeated and collinear points are allowed, rings
+ * without area and paths with curves (linearize them first) are not convex.
+ * The result is cached in the meta of the path like its box.
+ *
+ * @param path  The path.
+ *
+ * @return      true if the path is convex.
+ */
+bool fi_path_convex(FI_PATH *path);
+
+/**
+ * @brief The regions of 2 paths (even-odd rule) have a common point, their
+ * boundaries touching included.
+ *
+ * @details The edges of p2 are tested against each edge of p1 several at a
+ * time (with SSE2 or AVX), and the edges which may meet are checked exactly.
+ * Paths with curves are linearized first.
+ *
+ * @param p1   First path.
+ * @param p2   Second path.
+ * @param out  true if the paths intersect (false if one of them is NULL).
+ *
+ * @return     Integer error code (0 if successful).
+ */
+int fi_intersects(FI_PATH *p1, FI_PATH *p2, bool *out);
+
+/**
+ * @brief Orientation of 3 points, with an exact sign.
+ *
+ * @details Computed with doubles when the result is larger than a bound of
+ * its rounding error, and refined with exact arithmetic otherwise, so the
+ * near-degenerate cases only cost more than a few multiplications.
+ *
+ * @param pa  First point.
+ * @param pb  Second point.
+ * @param pc  Third point.
+ *
+ * @return    Twice the signed area of the triangle (pa, pb, pc), approximate
+ *            but of the sign of the exact area: positive if the points are in
+ *            counterclockwise order, negative if clockwise, 0 if collinear.
+ */
+double fi_orient2d(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc);
+
+/**
+ * @brief Position of a point relative to the circle through 3 points, with an
+ * exact sign (filtered like fi_orient2d()).
+ *
+ * @param pa  First point on the circle.
+ * @param pb  Second point on the circle.
+ * @param pc  Third point on the circle.
+ * @param pd  The point.
+ *
+ * @return    Approximate determinant of the exact sign: with pa, pb, pc in
+ *            counterclockwise order, positive if pd is inside the circle,
+ *            negative if outside, 0 if on it (the sign is reversed for a
+ *            clockwise order).
+ */
+double fi_incircle(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc, FI_POINT_D pd);
+
 /**
  * @brief Convert a complex path with Arc and Bezier segments into a series of
  * line segemnts..
@@ -161,7 +570,67 @@ void fi_offset_path(FI_PATH *in, FI_POINT_D pt);
 void fi_linearize(FI_PATH **in);
 
 /**
- * @brief Rough function to parse an SVG like path string to create a FI_PATH.
+ * @brief Convert a complex path with Arc and Bezier segments into a series of
+ * line segments, curves are approximated within a given tolerance.
+ *
+ * @details The number of segments of each Bezier curve is given by Wang's
+ * formula, the one of each arc by its largest radius and its angle, so that
+ * no point of the curve is further than tolerance from its approximation.
+ *
+ * @param in         Pointer to the input path.
+ * @param tolerance  Maximum distance between a curve and its segments
+ *                   (<= 0 for the fixed resolution of fi_linearize()).
+ */
+void fi_linearize_tolerance(FI_PATH **in, double tolerance);
+
+/**
+ * @brief Linearize a path into a new path, leaving the input untouched.
+ *
+ * @details The input is read once and the line segments are appended to an
+ * output allocated for the estimated number of segments (exact with the fixed
+ * resolution), unlike fi_linearize() no temporary path is created per curve.
+ *
+ * @param in         Pointer to the input path.
+ * @param tolerance  Maximum distance between a curve and its segments
+ *                   (<= 0 for the fixed resolution of fi_linearize()).
+ * @param out        Pointer to the created path.
+ *
+ * @return           Integer error code (0 if successful).
+ */
+int fi_linearize_to(FI_PATH *in, double tolerance, FI_PATH **out);
+
+/**
+ * @brief Flatten many elliptic arcs at once.
+ *
+ * @details Arc i goes from start[i] to arcs[3 * i + 2], with the radii
+ * arcs[3 * i], the rotation arcs[3 * i + 1].x and the flags flags[i] (same
+ * layout as the points of a FI_SEG_ARC segment). The points of all the arcs
+ * (start points excluded) are written one after the other in *out, which is
+ * reallocated once to the total size.
+ *
+ * @param start      Start points of the arcs.
+ * @param arcs       Points of the arcs (3 per arc).
+ * @param flags      Flags of the arcs.
+ * @param n          Number of arcs.
+ * @param tolerance  Maximum distance between an arc and its segments
+ *                   (<= 0 for the fixed resolution of fi_linearize()).
+ * @param out        Pointer to the output points (NULL or from malloc).
+ * @param offset     n + 1 indexes, offset[i] is the index of the first point
+ *                   of arc i and offset[n] the total number of points.
+ *
+ * @return           Integer error code (0 if successful).
+ */
+int fi_flatten_arcs(FI_POINT_D *start, FI_POINT_D *arcs, FI_SEG_FLAG *flags,
+                    size_t n, double tolerance, FI_POINT_D **out,
+                    size_t *offset);
+
+/**
+ * @brief Parse SVG path data to create a FI_PATH.
+ *
+ * @details The full SVG path grammar is supported (relative commands, H/V,
+ * S/T, exponents, numbers without separators like "1-2" or ".5.5"), all the
+ * segments are converted to absolute M, L, A, Q, C and Z segments. Numbers are
+ * correctly rounded and the heap is only used for the segments.
  *
  * @param in    The input path string.
  * @param s_in  Length of the input string.
@@ -171,11 +640,300 @@ void fi_linearize(FI_PATH **in);
  */
 int fi_parse_path(const char *in, int s_in, FI_PATH **out);
 
+/**
+ * @brief Callback of a FI_PARSER, called for each parsed segment.
+ *
+ * @param type    Type of the segment.
+ * @param flag    Flags of the segment (arcs only).
+ * @param points  Points of the segment (see fi_append_new_seg()), only valid
+ *                during the call.
+ * @param data    User data given to fi_parser_new().
+ *
+ * @return        0 to continue, an error code to stop the parsing.
+ */
+typedef int (*FI_PARSER_CB)(FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                            FI_POINT_D *points, void *data);
+
+/**
+ * @brief Incremental path data parser (see fi_parse_path()).
+ */
+typedef struct _FI_PARSER FI_PARSER;
+
+/**
+ * @brief Create an incremental parser.
+ *
+ * @details The path data is given in chunks of any size with
+ * fi_parser_feed(), a number can be cut between two chunks.
+ *
+ * @param cb    Function called for each segment as soon as it is complete,
+ *              NULL to append the segments to a path (see fi_parser_finish()).
+ * @param data  User data passed to cb.
+ *
+ * @return      The parser, to release with fi_parser_free().
+ */
+FI_PARSER *fi_parser_new(FI_PARSER_CB cb, void *data);
+
+/**
+ * @brief Parse a chunk of path data.
+ *
+ * @param parser  The parser.
+ * @param in      The chunk.
+ * @param s_in    Length of the chunk.
+ *
+ * @return        Integer error code (0 if successful), after an error the
+ *                parser returns it for all the following chunks.
+ */
+int fi_parser_feed(FI_PARSER *parser, const char *in, size_t s_in);
+
+/**
+ * @brief Parse the end of the path data.
+ *
+ * @param parser  The parser.
+ * @param out     Pointer to the created path (NULL with a callback), owned by
+ *                the caller.
+ *
+ * @return        Integer error code (0 if successful).
+ */
+int fi_parser_finish(FI_PARSER *parser, FI_PATH **out);
+
+/**
+ * @brief Free a parser.
+ *
+ * @param parser  The parser.
+ */
+void fi_parser_free(FI_PARSER *parser);
+
+/**
+ * @brief Initialize a writer.
+ *
+ * @param w     The writer.
+ * @param buf   Caller supplied buffer, NULL for a buffer allocated and grown
+ *              by the writer (see fi_writer_free()).
+ * @param size  Size of buf.
+ */
+void fi_writer_init(FI_WRITER *w, char *buf, size_t size);
+
+/**
+ * @brief Write the buffer of a writer to its stream (if any) and empty it.
+ *
+ * @param w  The writer.
+ *
+ * @return   Integer error code of the writer (0 if successful).
+ */
+int fi_writer_flush(FI_WRITER *w);
+
+/**
+ * @brief Free the buffer allocated by a writer.
+ *
+ * @param w  The writer.
+ */
+void fi_writer_free(FI_WRITER *w);
+
+/**
+ * @brief Write one segment.
+ *
+ * @param w       The writer.
+ * @param type    Type of the segment.
+ * @param flag    Flags of the segment (arcs only).
+ * @param points  Points of the segment.
+ *
+ * @return        Integer error code (0 if successful, ERR_BUFFER_FULL if a
+ *                caller supplied buffer without stream is full).
+ */
+int fi_write_seg(FI_WRITER *w, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                 FI_POINT_D *points);
+
+/**
+ * @brief Write a FI_PATH.
+ *
+ * @param w   The writer.
+ * @param in  Pointer to the input path.
+ *
+ * @return    Integer error code (0 if successful).
+ */
+int fi_write_path(FI_WRITER *w, FI_PATH *in);
+
+/**
+ * @brief Write a FI_PACKED_PATH.
+ *
+ * @param w   The writer.
+ * @param in  Pointer to the input packed path.
+ *
+ * @return    Integer error code (0 if successful).
+ */
+int fi_write_packed(FI_WRITER *w, FI_PACKED_PATH *in);
+
 /**
  * @brief Draw a FI_PATH like an SVG path (M x1,y1 L x2,y2 C x3,y3 x4,y4 x5,y5 A
- * x6,y6 x7,y7 Z).
+ * x6,y6 x7,y7 Z), with a precision of 4 digits (see fi_write_path()).
  *
  * @param in   Pointer to the input path.
  * @param out  Pointer to the output file stream.
  */
 void fi_draw_path(FI_PATH *in, FILE *out);
+
+/**
+ * @brief Add a new segment of a given type to a FI_PACKED_PATH, its points
+ * (zeroed) are the last points of the path.
+ *
+ * @param path   Pointer to the packed path (created if NULL).
+ * @param type   Type of the segment to be added.
+ * @param flag   Flags of the segment (arcs only).
+ *
+ * @return       Integer error code (0 if successful).
+ */
+int fi_append_packed_seg(FI_PACKED_PATH **path, FI_SEG_TYPE type,
+                         FI_SEG_FLAG flag);
+
+/**
+ * @brief Convert a FI_PATH to a FI_PACKED_PATH (one exactly sized copy).
+ *
+ * @param in   Pointer to the input path.
+ * @param out  Pointer to the packed path.
+ *
+ * @return     Integer error code (0 if successful).
+ */
+int fi_pack_path(FI_PATH *in, FI_PACKED_PATH **out);
+
+/**
+ * @brief Build a FI_PATH view of a FI_PACKED_PATH, without copying the
+ * points. The points of the view are those of the packed path, which must
+ * outlive the view and keep its segments unchanged. Segments appended to the
+ * view are allocated normally.
+ *
+ * @param in   Pointer to the packed path.
+ * @param out  Pointer to the view.
+ *
+ * @return     Integer error code (0 if successful).
+ */
+int fi_unpack_path(FI_PACKED_PATH *in, FI_PATH **out);
+
+/**
+ * @brief Free a FI_PACKED_PATH structure.
+ *
+ * @param path  Pointer to the packed path to be freed.
+ */
+void fi_free_packed(FI_PACKED_PATH *path);
+
+/**
+ * @brief Copy a FI_PACKED_PATH.
+ *
+ * @param in   Pointer to the input packed path.
+ * @param out  Pointer to the copied packed path.
+ */
+void fi_copy_packed(FI_PACKED_PATH *in, FI_PACKED_PATH **out);
+
+/**
+ * @brief Offset a FI_PACKED_PATH.
+ *
+ * @param in  Pointer to the input packed path.
+ * @param pt  Point by which the path will be offset.
+ */
+void fi_offset_packed(FI_PACKED_PATH *in, FI_POINT_D pt);
+
+/**
+ * @brief Convert the Arc and Bezier segments of a FI_PACKED_PATH into a
+ * series of line segments.
+ *
+ * @param in   Pointer to the input packed path.
+ */
+void fi_linearize_packed(FI_PACKED_PATH **in);
+
+/**
+ * @brief Convert the Arc and Bezier segments of a FI_PACKED_PATH into a
+ * series of line segments, curves are approximated within a given tolerance
+ * (see fi_linearize_tolerance()).
+ *
+ * @param in         Pointer to the input packed path.
+ * @param tolerance  Maximum distance between a curve and its segments
+ *                   (<= 0 for the fixed resolution of fi_linearize()).
+ */
+void fi_linearize_packed_tolerance(FI_PACKED_PATH **in, double tolerance);
+
+/**
+ * @brief Draw a FI_PACKED_PATH like an SVG path (same format as
+ * fi_draw_path()).
+ *
+ * @param in   Pointer to the input packed path.
+ * @param out  Pointer to the output file stream.
+ */
+void fi_draw_packed(FI_PACKED_PATH *in, FILE *out);
+
+/**
+ * @brief Size of the binary data of a FI_PACKED_PATH.
+ *
+ * @param in  Pointer to the input packed path.
+ *
+ * @return    Size in bytes (see FI_BINARY_HEADER).
+ */
+size_t fi_binary_size(FI_PACKED_PATH *in);
+
+/**
+ * @brief Encode a FI_PACKED_PATH as binary data in a buffer.
+ *
+ * @param in    Pointer to the input packed path.
+ * @param buf   Output buffer.
+ * @param size  Size of the buffer, at least fi_binary_size().
+ *
+ * @return      Integer error code (0 if successful, ERR_BUFFER_FULL if the
+ *              buffer is too small).
+ */
+int fi_encode_binary(FI_PACKED_PATH *in, void *buf, size_t size);
+
+/**
+ * @brief Write a FI_PACKED_PATH as binary data.
+ *
+ * @param in   Pointer to the input packed path.
+ * @param out  Pointer to the output file stream.
+ *
+ * @return     Integer error code (0 if successful, ERR_IO if the data could
+ *             not be written).
+ */
+int fi_save_binary(FI_PACKED_PATH *in, FILE *out);
+
+/**
+ * @brief Read and check the header of binary path data.
+ *
+ * @param data  Binary data.
+ * @param size  Size of the data.
+ * @param out   Pointer to the decoded header.
+ *
+ * @return      Integer error code (0 if successful, ERR_BINARY_FORMAT or
+ *              ERR_BINARY_VERSION).
+ */
+int fi_read_binary_header(const void *data, size_t size,
+                          FI_BINARY_HEADER *out);
+
+/**
+ * @brief Load binary path data as a FI_PACKED_PATH.
+ *
+ * @details The data is checked (header, segment types, number of points and
+ * subpaths) in one pass over the types. On a little-endian 64 bits host, with
+ * data aligned on 8 bytes, the arrays of the packed path point into the data
+ * which must outlive it (and is modified by fi_offset_packed()), otherwise
+ * they are decoded into a copy.
+ *
+ * @param data  Binary data.
+ * @param size  Size of the data.
+ * @param out   Pointer to the packed path.
+ *
+ * @return      Integer error code (0 if successful, ERR_BINARY_FORMAT or
+ *              ERR_BINARY_VERSION).
+ */
+int fi_load_binary(void *data, size_t size, FI_PACKED_PATH **out);
+
+/**
+ * @brief Map a file of binary path data as a FI_PACKED_PATH.
+ *
+ * @details The file is mapped privately (changes are not written back) and
+ * loaded with fi_load_binary(), the mapping is released by fi_free_packed().
+ * A view of the packed path (fi_unpack_path()) reads its points straight from
+ * the mapping.
+ *
+ * @param filename  Name of the file.
+ * @param out       Pointer to the packed path.
+ *
+ * @return          Integer error code (0 if successful, ERR_IO,
+ *                  ERR_BINARY_FORMAT or ERR_BINARY_VERSION).
+ */
+int fi_map_binary(const char *filename, FI_PACKED_PATH **out);
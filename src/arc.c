@@ -0,0 +1,187 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Elliptic arcs are converted once to their center parameterization, the
+ * points are then generated by rotating a unit vector by a constant angle
+ * (no trigonometry in the loop) and mapping it on the ellipse.
+ */
+
+// converts endpoints definition of arc to center defition for elliptic arc
+FI_PARAM_ARC fi_arc_endpoint_to_center(FI_POINT_D s, FI_POINT_D e, FI_POINT_D r,
+                                       double phi, FI_SEG_FLAG flag) {
+    // https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
+    FI_PARAM_ARC ret = {0};
+    double cos_phi = cos(phi * D2R);
+    double sin_phi = sin(phi * D2R);
+    double dx = (s.x - e.x) / 2;
+    double dy = (s.y - e.y) / 2;
+
+    FI_POINT_D p1;
+    p1.x = cos_phi * dx + sin_phi * dy;
+    p1.y = -sin_phi * dx + cos_phi * dy;
+    r.x = fabs(r.x);
+    r.y = fabs(r.y);
+
+    double px2 = p1.x * p1.x;
+    double py2 = p1.y * p1.y;
+    double delta = px2 / (r.x * r.x) + py2 / (r.y * r.y);
+    if (delta > 1) {
+        r.x = sqrt(delta) * r.x;
+        r.y = sqrt(delta) * r.y;
+    }
+    double rx2 = r.x * r.x;
+    double ry2 = r.y * r.y;
+
+    // the numerator is ~0 (maybe < 0) when the radii were scaled up
+    double num = rx2 * ry2 - rx2 * py2 - ry2 * px2;
+    double den = rx2 * py2 + ry2 * px2;
+    double coef = num > 0 && den > 0 ? sqrt(num / den) : 0;
+    if (((flag & FI_LARGE_ARC) != 0) == ((flag & FI_SWEEP) != 0))
+        coef = -coef;
+
+    FI_POINT_D cp;
+    cp.x = coef * r.x * p1.y / r.y;
+    cp.y = -coef * r.y * p1.x / r.x;
+
+    ret.center.x = cos_phi * cp.x - sin_phi * cp.y + (s.x + e.x) / 2;
+    ret.center.y = sin_phi * cp.x + cos_phi * cp.y + (s.y + e.y) / 2;
+
+    FI_POINT_D u;
+    FI_POINT_D v;
+    u.x = (p1.x - cp.x) / r.x;
+    u.y = (p1.y - cp.y) / r.y;
+    v.x = (-p1.x - cp.x) / r.x;
+    v.y = (-p1.y - cp.y) / r.y;
+    ret.angle_s = atan2(u.y, u.x);
+    ret.angle_d = atan2(u.x * v.y - u.y * v.x, u.x * v.x + u.y * v.y);
+    if (!(flag & FI_SWEEP) && ret.angle_d > 0)
+        ret.angle_d -= 2 * M_PI;
+    else if ((flag & FI_SWEEP) && ret.angle_d < 0)
+        ret.angle_d += 2 * M_PI;
+
+    ret.cos_phi = cos_phi;
+    ret.sin_phi = sin_phi;
+    ret.radius = r;
+    return ret;
+}
+
+// the chords of an arc of angle a on a circle of radius r are within tol of
+// the circle if a <= 2 * acos(1 - tol / r), an ellipse is within the circle
+// of its largest radius (and at least 4 segments per turn)
+int fi_arc_n_seg(FI_PARAM_ARC *param, double tolerance) {
+    if (tolerance <= 0)
+        return ARC_RES;
+    double r = fmax(param->radius.x, param->radius.y);
+    double step = tolerance < r ? 2 * acos(1 - tolerance / r) : M_PI;
+    double n = ceil(fabs(param->angle_d) / fmin(step, M_PI / 2));
+    if (!(n >= 1))
+        return 1;
+    if (n > ARC_MAX_SEG)
+        return ARC_MAX_SEG;
+    return (int)n;
+}
+
+void fi_arc_param_points(FI_PARAM_ARC *param, int n, int first,
+                         FI_POINT_D *out) {
+    double step = param->angle_d / n;
+    double cos_d = cos(step);
+    double sin_d = sin(step);
+    double c = cos(param->angle_s);
+    double s = sin(param->angle_s);
+
+    // rotation and radii of the ellipse in one matrix
+    double m00 = param->radius.x * param->cos_phi;
+    double m01 = -param->radius.y * param->sin_phi;
+    double m10 = param->radius.x * param->sin_phi;
+    double m11 = param->radius.y * param->cos_phi;
+
+    for (int i = 0; i <= n; i++) {
+        if (i >= first) {
+            out->x = m00 * c + m01 * s + param->center.x;
+            out->y = m10 * c + m11 * s + param->center.y;
+            out++;
+        }
+        double tmp = c * cos_d - s * sin_d;
+        s = s * cos_d + c * sin_d;
+        c = tmp;
+    }
+}
+
+int fi_arc_flatten(FI_POINT_D ref, FI_POINT_D *in, FI_SEG_FLAG flag,
+                   double tolerance, FI_POINT_D **buf, int *s_buf) {
+    FI_POINT_D r = in[0];
+    FI_POINT_D e = in[2];
+    if (*s_buf < ARC_RES + 1) {
+        *s_buf = ARC_RES + 1;
+        *buf = realloc(*buf, *s_buf * sizeof(FI_POINT_D));
+    }
+    // degenerated arcs are straight lines
+    if (r.x == 0 || r.y == 0 || (ref.x == e.x && ref.y == e.y)) {
+        (*buf)[0] = e;
+        return 1;
+    }
+
+    FI_PARAM_ARC param = fi_arc_endpoint_to_center(ref, e, r, in[1].x, flag);
+    int n = fi_arc_n_seg(&param, tolerance);
+    if (n + 1 > *s_buf) {
+        *s_buf = n + 1;
+        *buf = realloc(*buf, *s_buf * sizeof(FI_POINT_D));
+    }
+    // the fixed resolution mode also emits the start point
+    int first = tolerance <= 0 ? 0 : 1;
+    fi_arc_param_points(&param, n, first, *buf);
+    // the end points must be exact to keep the path connected
+    if (first == 0)
+        (*buf)[0] = ref;
+    (*buf)[n - first] = e;
+    return n + 1 - first;
+}
+
+int fi_flatten_arcs(FI_POINT_D *start, FI_POINT_D *arcs, FI_SEG_FLAG *flags,
+                    size_t n, double tolerance, FI_POINT_D **out,
+                    size_t *offset) {
+    FI_PARAM_ARC *param = malloc((n ? n : 1) * sizeof(FI_PARAM_ARC));
+    int *n_seg = malloc((n ? n : 1) * sizeof(int));
+
+    // first pass: parameters and number of points of each arc
+    offset[0] = 0;
+    for (size_t i = 0; i < n; i++) {
+        FI_POINT_D *in = &arcs[3 * i];
+        FI_POINT_D s = start[i];
+        if (in[0].x == 0 || in[0].y == 0 ||
+            (s.x == in[2].x && s.y == in[2].y)) {
+            param[i] = (FI_PARAM_ARC){0};
+            n_seg[i] = 1;
+        } else {
+            param[i] =
+                fi_arc_endpoint_to_center(s, in[2], in[0], in[1].x, flags[i]);
+            n_seg[i] = fi_arc_n_seg(&param[i], tolerance);
+        }
+        offset[i + 1] = offset[i] + n_seg[i];
+    }
+
+    // second pass: the points, in one allocation
+    *out = realloc(*out, (offset[n] ? offset[n] : 1) * sizeof(FI_POINT_D));
+    for (size_t i = 0; i < n; i++) {
+        FI_POINT_D *pt = *out + offset[i];
+        if (param[i].radius.x != 0)
+            fi_arc_param_points(&param[i], n_seg[i], 1, pt);
+        pt[n_seg[i] - 1] = arcs[3 * i + 2];
+    }
+    free(param);
+    free(n_seg);
+    return 0;
+}
@@ -0,0 +1,86 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/* size of the block header, rounded so the data stays aligned */
+#define FI_ARENA_HEADER                                                        \
+    ((sizeof(FI_ARENA_BLOCK) + FI_ARENA_ALIGN - 1) & ~(FI_ARENA_ALIGN - 1))
+
+void fi_arena_init(FI_ARENA *arena, size_t block_size) {
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : FI_ARENA_BLOCK_SIZE;
+}
+
+void fi_arena_reserve(FI_ARENA *arena, size_t size) {
+    FI_ARENA_BLOCK *block = arena->head;
+    if (block != NULL && block->used + size <= block->size)
+        return;
+    // oversized requests get a block of their own
+    size_t block_size = size > arena->block_size ? size : arena->block_size;
+    block = malloc(FI_ARENA_HEADER + block_size);
+    block->size = block_size;
+    block->used = 0;
+    block->next = arena->head;
+    arena->head = block;
+    if (arena->block_size < FI_ARENA_MAX_BLOCK_SIZE)
+        arena->block_size *= 2;
+}
+
+void *fi_arena_alloc(FI_ARENA *arena, size_t size) {
+    size = (size + FI_ARENA_ALIGN - 1) & ~(FI_ARENA_ALIGN - 1);
+    fi_arena_reserve(arena, size);
+
+    FI_ARENA_BLOCK *block = arena->head;
+    void *ret = (char *)block + FI_ARENA_HEADER + block->used;
+    block->used += size;
+    memset(ret, 0, size);
+    return ret;
+}
+
+void fi_arena_reset(FI_ARENA *arena) {
+    if (arena->head == NULL)
+        return;
+    // keep the last allocated block, it is most likely the largest one
+    FI_ARENA_BLOCK *keep = arena->head;
+    arena->head = keep->next;
+    fi_arena_free(arena);
+    keep->next = NULL;
+    keep->used = 0;
+    arena->head = keep;
+}
+
+void fi_arena_free(FI_ARENA *arena) {
+    FI_ARENA_BLOCK *block = arena->head;
+    while (block != NULL) {
+        FI_ARENA_BLOCK *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+void fi_arena_merge(FI_ARENA *dst, FI_ARENA *src) {
+    FI_ARENA_BLOCK *last = src->head;
+    if (last == NULL)
+        return;
+    while (last->next != NULL)
+        last = last->next;
+    // keep the current block of dst in front, it is the one still in use
+    if (dst->head == NULL) {
+        dst->head = src->head;
+    } else {
+        last->next = dst->head->next;
+        dst->head->next = src->head;
+    }
+    src->head = NULL;
+}
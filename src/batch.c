@@ -0,0 +1,155 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/* jobs [first, last) of a thread, the owner takes them from the front and the
+ * other threads steal them from the back
+ */
+struct _FI_BATCH_QUEUE {
+    pthread_mutex_t lock;
+    size_t first;
+    size_t last;
+};
+
+/* one thread of a batch
+ */
+typedef struct _FI_BATCH_WORKER {
+    FI_BATCH *batch;
+    int id;
+    pthread_t thread;
+    bool started;
+} FI_BATCH_WORKER;
+
+struct _FI_BATCH {
+    FI_CLIP_JOB *jobs;
+    FI_BATCH_QUEUE *queues;
+    FI_BATCH_WORKER *workers;
+    int n_thread;
+};
+
+bool fi_batch_pop(FI_BATCH_QUEUE *queue, size_t *job) {
+    bool ret = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->first < queue->last) {
+        *job = queue->first++;
+        ret = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ret;
+}
+
+bool fi_batch_steal(FI_BATCH *batch, int id) {
+    for (int i = 1; i < batch->n_thread; i++) {
+        FI_BATCH_QUEUE *victim = &batch->queues[(id + i) % batch->n_thread];
+        pthread_mutex_lock(&victim->lock);
+        size_t n = victim->last - victim->first;
+        size_t last = victim->last;
+        victim->last -= (n + 1) / 2;
+        size_t first = victim->last;
+        pthread_mutex_unlock(&victim->lock);
+        if (n == 0)
+            continue;
+
+        // the queue of a thread which steals is empty, nobody adds to it
+        FI_BATCH_QUEUE *queue = &batch->queues[id];
+        pthread_mutex_lock(&queue->lock);
+        queue->first = first;
+        queue->last = last;
+        pthread_mutex_unlock(&queue->lock);
+        return true;
+    }
+    return false;
+}
+
+void fi_batch_run(FI_BATCH *batch, int id) {
+    // sweep buffers reused from one job to the next
+    FI_SWEEP_STATE sweep = {0};
+    size_t i;
+    do {
+        while (fi_batch_pop(&batch->queues[id], &i)) {
+            FI_CLIP_JOB *job = &batch->jobs[i];
+            job->ret =
+                fi_clip_with(&sweep, job->subject, job->clip, job->ops,
+                             &job->out);
+        }
+    } while (fi_batch_steal(batch, id));
+    fi_free_sweep(&sweep);
+}
+
+void *fi_batch_thread(void *arg) {
+    FI_BATCH_WORKER *worker = arg;
+    fi_batch_run(worker->batch, worker->id);
+    return NULL;
+}
+
+int fi_clip_batch(FI_CLIP_JOB *jobs, size_t n_job, int n_thread) {
+    if (n_job == 0)
+        return 0;
+    if (n_thread <= 0) {
+        long n_cpu = sysconf(_SC_NPROCESSORS_ONLN);
+        n_thread = n_cpu > 0 ? (int)n_cpu : 1;
+    }
+    if ((size_t)n_thread > n_job)
+        n_thread = (int)n_job;
+
+    // the threads only read the cached boxes (and convexity, checked by the
+    // intersections) of shared paths
+    FI_POINT_D bbox[2];
+    for (size_t i = 0; i < n_job; i++) {
+        fi_path_bbox(jobs[i].subject, bbox);
+        fi_path_bbox(jobs[i].clip, bbox);
+        if (jobs[i].ops == FI_AND) {
+            fi_path_convex(jobs[i].subject);
+            fi_path_convex(jobs[i].clip);
+        }
+    }
+
+    FI_BATCH batch;
+    batch.jobs = jobs;
+    batch.n_thread = n_thread;
+    batch.queues = calloc(n_thread, sizeof(FI_BATCH_QUEUE));
+    batch.workers = calloc(n_thread, sizeof(FI_BATCH_WORKER));
+    for (int i = 0; i < n_thread; i++) {
+        FI_BATCH_QUEUE *queue = &batch.queues[i];
+        pthread_mutex_init(&queue->lock, NULL);
+        queue->first = n_job * i / n_thread;
+        queue->last = n_job * (i + 1) / n_thread;
+        batch.workers[i].batch = &batch;
+        batch.workers[i].id = i;
+    }
+
+    // the calling thread is worker 0, the jobs of a thread which could not
+    // be created are stolen by the others
+    for (int i = 1; i < n_thread; i++)
+        batch.workers[i].started =
+            pthread_create(&batch.workers[i].thread, NULL, fi_batch_thread,
+                           &batch.workers[i]) == 0;
+    fi_batch_run(&batch, 0);
+    for (int i = 1; i < n_thread; i++)
+        if (batch.workers[i].started)
+            pthread_join(batch.workers[i].thread, NULL);
+
+    for (int i = 0; i < n_thread; i++)
+        pthread_mutex_destroy(&batch.queues[i].lock);
+    free(batch.queues);
+    free(batch.workers);
+
+    for (size_t i = 0; i < n_job; i++)
+        if (jobs[i].ret)
+            return jobs[i].ret;
+    return 0;
+}
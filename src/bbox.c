@@ -0,0 +1,317 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Bounding boxes of paths and of their subpaths (rings), and the clippings
+ * they decide without a sweep. A region bounded by the edges of a path is
+ * within its box, so a box which meets no edge of the other operand is either
+ * entirely inside or entirely outside of it.
+ */
+
+void fi_bbox_add(FI_POINT_D *bbox, FI_POINT_D pt) {
+    bbox[0].x = fmin(bbox[0].x, pt.x);
+    bbox[0].y = fmin(bbox[0].y, pt.y);
+    bbox[1].x = fmax(bbox[1].x, pt.x);
+    bbox[1].y = fmax(bbox[1].y, pt.y);
+}
+
+void fi_bbox_add_seg(FI_POINT_D *bbox, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                     FI_POINT_D ref, FI_POINT_D *pt) {
+    if (type == FI_SEG_ARC) {
+        // the arc is within the circle of its largest radius
+        FI_PARAM_ARC param =
+            fi_arc_endpoint_to_center(ref, pt[2], pt[0], pt[1].x, flag);
+        double r = fmax(param.radius.x, param.radius.y);
+        FI_POINT_D lo = {param.center.x - r, param.center.y - r};
+        FI_POINT_D hi = {param.center.x + r, param.center.y + r};
+        fi_bbox_add(bbox, lo);
+        fi_bbox_add(bbox, hi);
+        fi_bbox_add(bbox, pt[2]);
+        return;
+    }
+    for (int i = 0; i < fi_seg_n_point(type); i++)
+        fi_bbox_add(bbox, pt[i]);
+}
+
+void fi_path_bbox(FI_PATH *path, FI_POINT_D *bbox) {
+    bbox[0] = (FI_POINT_D){INFINITY, INFINITY};
+    bbox[1] = (FI_POINT_D){-INFINITY, -INFINITY};
+    if (path == NULL)
+        return;
+    FI_META *meta = path->meta;
+    if (path == meta->first && meta->bbox_valid) {
+        memcpy(bbox, meta->bbox, sizeof(meta->bbox));
+        return;
+    }
+
+    FI_POINT_D ref = {0};
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        int n = tmp->section.n_point;
+        fi_bbox_add_seg(bbox, tmp->section.type, tmp->section.flag, ref,
+                        tmp->section.points);
+        if (n > 0)
+            ref = tmp->section.points[n - 1];
+    }
+    if (path == meta->first) {
+        memcpy(meta->bbox, bbox, sizeof(meta->bbox));
+        meta->bbox_valid = true;
+    }
+}
+
+bool fi_bbox_overlap(FI_POINT_D *a, FI_POINT_D *b) {
+    return a[0].x <= b[1].x && b[0].x <= a[1].x && a[0].y <= b[1].y &&
+           b[0].y <= a[1].y;
+}
+
+bool fi_edge_hits_box(FI_POINT_D s, FI_POINT_D e, FI_POINT_D *box) {
+    if (fmax(s.x, e.x) < box[0].x || fmin(s.x, e.x) > box[1].x ||
+        fmax(s.y, e.y) < box[0].y || fmin(s.y, e.y) > box[1].y)
+        return false;
+    // the box of the edge meets the box, the line of the edge must not leave
+    // the 4 corners on the same side
+    FI_POINT_D corners[4] = {box[0], {box[1].x, box[0].y}, box[1],
+                             {box[0].x, box[1].y}};
+    int below = 0;
+    int above = 0;
+    for (int i = 0; i < 4; i++) {
+        double area = fi_signed_area(s, e, corners[i]);
+        below += area <= 0;
+        above += area >= 0;
+    }
+    return below > 0 && above > 0;
+}
+
+bool fi_path_hits_box(FI_PATH *path, FI_POINT_D *box) {
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
+            break;
+        case FI_SEG_END:
+            if (fi_edge_hits_box(last, first, box))
+                return true;
+            last = first;
+            break;
+        default:
+            if (fi_edge_hits_box(last, pt[0], box))
+                return true;
+            last = pt[0];
+            break;
+        }
+    }
+    return false;
+}
+
+bool fi_point_in_path(FI_POINT_D pt, FI_PATH *path) {
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    bool inside = false;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *p = tmp->section.points;
+        FI_POINT_D next;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = p[0];
+            last = p[0];
+            continue;
+        case FI_SEG_END:
+            next = first;
+            break;
+        default:
+            next = p[0];
+            break;
+        }
+        // crossings of the ray going right from pt, even-odd rule: pt is on
+        // the left of the edge going up (or on its right going down)
+        if ((last.y > pt.y) != (next.y > pt.y) &&
+            (fi_orient2d(last, next, pt) > 0) == (next.y > last.y))
+            inside = !inside;
+        last = next;
+    }
+    return inside;
+}
+
+void fi_concat_copy(FI_PATH *p1, FI_PATH *p2, FI_PATH **out) {
+    *out = NULL;
+    fi_append_copy(p1, NULL, out);
+    fi_append_copy(p2, NULL, out);
+}
+
+bool fi_clip_apart(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    *out = NULL;
+    if (ops == FI_OR || ops == FI_XOR)
+        fi_concat_copy(p1, p2, out);
+    else if (ops == FI_DIFF)
+        fi_copy_path(p1, out);
+    return true;
+}
+
+bool fi_clip_disjoint(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    FI_POINT_D b1[2];
+    FI_POINT_D b2[2];
+    fi_path_bbox(p1, b1);
+    fi_path_bbox(p2, b2);
+    if (fi_bbox_overlap(b1, b2))
+        return false;
+    return fi_clip_apart(p1, p2, ops, out);
+}
+
+bool fi_clip_contained(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    FI_POINT_D b1[2];
+    FI_POINT_D b2[2];
+    fi_path_bbox(p1, b1);
+    fi_path_bbox(p2, b2);
+
+    *out = NULL;
+    if (!fi_path_hits_box(p2, b1)) {
+        if (!fi_point_in_path(b1[0], p2))
+            return fi_clip_apart(p1, p2, ops, out);
+        // p1 is inside p2
+        if (ops == FI_AND)
+            fi_copy_path(p1, out);
+        else if (ops == FI_OR)
+            fi_copy_path(p2, out);
+        else if (ops == FI_XOR)
+            fi_concat_copy(p2, p1, out);
+        return true;
+    }
+    if (!fi_path_hits_box(p1, b2)) {
+        if (!fi_point_in_path(b2[0], p1))
+            return fi_clip_apart(p1, p2, ops, out);
+        // p2 is inside p1, and a hole of the difference
+        if (ops == FI_AND)
+            fi_copy_path(p2, out);
+        else if (ops == FI_OR)
+            fi_copy_path(p1, out);
+        else
+            fi_concat_copy(p1, p2, out);
+        return true;
+    }
+    return false;
+}
+
+size_t fi_path_rings(FI_PATH *path, FI_POLYGON_TYPE type, FI_RING *rings) {
+    size_t n = 0;
+    FI_PATH *tmp = path;
+    while (tmp != NULL) {
+        FI_RING *ring = &rings[n++];
+        ring->first = tmp;
+        ring->type = type;
+        ring->bbox[0] = (FI_POINT_D){INFINITY, INFINITY};
+        ring->bbox[1] = (FI_POINT_D){-INFINITY, -INFINITY};
+        ring->isolated = true;
+        ring->cross = false;
+        // the path is linear, its points are the corners of its edges
+        for (; tmp != NULL; tmp = tmp->next) {
+            if (tmp->section.n_point > 0)
+                fi_bbox_add(ring->bbox, tmp->section.points[0]);
+            if (tmp->section.type == FI_SEG_END) {
+                tmp = tmp->next;
+                break;
+            }
+        }
+        ring->end = tmp;
+    }
+    return n;
+}
+
+int fi_compare_rings_p(const void *in_1, const void *in_2) {
+    const FI_RING *r1 = *(const FI_RING **)in_1;
+    const FI_RING *r2 = *(const FI_RING **)in_2;
+    if (r1->bbox[0].x < r2->bbox[0].x)
+        return -1;
+    return r1->bbox[0].x > r2->bbox[0].x;
+}
+
+void fi_rings_overlap(FI_RING *rings, size_t n) {
+    FI_RING **sorted = malloc((n ? n : 1) * sizeof(FI_RING *));
+    for (size_t i = 0; i < n; i++)
+        sorted[i] = &rings[i];
+    qsort(sorted, n, sizeof(FI_RING *), fi_compare_rings_p);
+
+    // only the following rings starting before the end of a ring can meet it
+    for (size_t i = 0; i < n; i++) {
+        FI_RING *r1 = sorted[i];
+        for (size_t j = i + 1; j < n && sorted[j]->bbox[0].x <= r1->bbox[1].x;
+             j++) {
+            FI_RING *r2 = sorted[j];
+            if (!fi_bbox_overlap(r1->bbox, r2->bbox))
+                continue;
+            r1->isolated = false;
+            r2->isolated = false;
+            if (r1->type != r2->type) {
+                r1->cross = true;
+                r2->cross = true;
+            }
+        }
+    }
+    free(sorted);
+}
+
+FI_RING_ACTION fi_ring_action(FI_RING *ring, FI_OPS ops) {
+    // a ring without area adds nothing to any result
+    if (!(ring->bbox[0].x < ring->bbox[1].x) ||
+        !(ring->bbox[0].y < ring->bbox[1].y))
+        return FI_RING_DROP;
+    switch (ops) {
+    case FI_AND:
+        return ring->cross ? FI_RING_SWEEP : FI_RING_DROP;
+    case FI_DIFF:
+        if (ring->type == FI_CLIPPED)
+            return ring->cross ? FI_RING_SWEEP : FI_RING_DROP;
+        return ring->isolated ? FI_RING_COPY : FI_RING_SWEEP;
+    case FI_OR:
+    case FI_XOR:
+        break;
+    }
+    return ring->isolated ? FI_RING_COPY : FI_RING_SWEEP;
+}
+
+int fi_clip_rings(FI_SWEEP_STATE *sweep, FI_PATH *subject, FI_PATH *clip,
+                  FI_PATH **out) {
+    int ret = 0;
+    size_t n_ring = subject->meta->n_move + clip->meta->n_move;
+    FI_RING *rings = malloc((n_ring ? n_ring : 1) * sizeof(FI_RING));
+    n_ring = fi_path_rings(subject, FI_SUBJECT, rings);
+    n_ring += fi_path_rings(clip, FI_CLIPPED, &rings[n_ring]);
+    fi_rings_overlap(rings, n_ring);
+
+    if (sweep->events.block_size == 0)
+        fi_arena_init(&sweep->events, 0);
+    sweep->current = NULL;
+    size_t n_sweep = 0;
+    for (size_t i = 0; i < n_ring; i++) {
+        if (fi_ring_action(&rings[i], sweep->ops) != FI_RING_SWEEP)
+            continue;
+        fi_insert_ring(sweep, rings[i].first, rings[i].type);
+        n_sweep++;
+    }
+
+    *out = NULL;
+    if (n_sweep > 0) {
+        fi_sort_events(&sweep->queue);
+        fi_subdivide(sweep);
+        ret = fi_connect_edges(sweep, out);
+    }
+    for (size_t i = 0; i < n_ring && !ret; i++)
+        if (fi_ring_action(&rings[i], sweep->ops) == FI_RING_COPY)
+            fi_append_copy(rings[i].first, rings[i].end, out);
+    free(rings);
+    return ret;
+}
@@ -0,0 +1,116 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * Bezier curves are sampled in their power basis with Horner's scheme,
+ * P(t) = ((a * t + b) * t + c) * t + d, x and y being computed together in
+ * the 2 lanes of a SSE2 register (or 2 values of t at once with AVX).
+ * FI_POINT_D is 2 packed doubles, so the results are stored directly in the
+ * output buffer.
+ */
+
+/* Horner evaluation of points first to n (t = i / n) of a polynomial of degree
+ * 3 (a = 0 for degree 2), written from out[0]
+ */
+void fi_horner_points(FI_POINT_D a, FI_POINT_D b, FI_POINT_D c, FI_POINT_D d,
+                      int n, int first, FI_POINT_D *out) {
+    double step = 1.0 / n;
+    int i = first;
+    FI_POINT_D *pt = out;
+
+#if defined(__AVX__)
+    __m256d a4 = _mm256_setr_pd(a.x, a.y, a.x, a.y);
+    __m256d b4 = _mm256_setr_pd(b.x, b.y, b.x, b.y);
+    __m256d c4 = _mm256_setr_pd(c.x, c.y, c.x, c.y);
+    __m256d d4 = _mm256_setr_pd(d.x, d.y, d.x, d.y);
+    for (; i + 1 <= n; i += 2, pt += 2) {
+        double t0 = i * step;
+        double t1 = (i + 1) * step;
+        __m256d t = _mm256_setr_pd(t0, t0, t1, t1);
+        __m256d p = _mm256_add_pd(_mm256_mul_pd(a4, t), b4);
+        p = _mm256_add_pd(_mm256_mul_pd(p, t), c4);
+        p = _mm256_add_pd(_mm256_mul_pd(p, t), d4);
+        _mm256_storeu_pd((double *)pt, p);
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+    __m128d a2 = _mm_setr_pd(a.x, a.y);
+    __m128d b2 = _mm_setr_pd(b.x, b.y);
+    __m128d c2 = _mm_setr_pd(c.x, c.y);
+    __m128d d2 = _mm_setr_pd(d.x, d.y);
+    for (; i <= n; i++, pt++) {
+        __m128d t = _mm_set1_pd(i * step);
+        __m128d p = _mm_add_pd(_mm_mul_pd(a2, t), b2);
+        p = _mm_add_pd(_mm_mul_pd(p, t), c2);
+        p = _mm_add_pd(_mm_mul_pd(p, t), d2);
+        _mm_storeu_pd((double *)pt, p);
+    }
+#else
+    for (; i <= n; i++, pt++) {
+        double t = i * step;
+        pt->x = ((a.x * t + b.x) * t + c.x) * t + d.x;
+        pt->y = ((a.y * t + b.y) * t + c.y) * t + d.y;
+    }
+#endif
+}
+
+// points of one cubic bezier curve
+void fi_cub_bezier_points(FI_POINT_D ref, FI_POINT_D *in, int n, int first,
+                          FI_POINT_D *out) {
+    FI_POINT_D P0 = ref;
+    FI_POINT_D P1 = in[0];
+    FI_POINT_D P2 = in[1];
+    FI_POINT_D P3 = in[2];
+    FI_POINT_D a, b, c;
+
+    a.x = P3.x - P0.x + 3 * (P1.x - P2.x);
+    a.y = P3.y - P0.y + 3 * (P1.y - P2.y);
+    b.x = 3 * (P0.x - 2 * P1.x + P2.x);
+    b.y = 3 * (P0.y - 2 * P1.y + P2.y);
+    c.x = 3 * (P1.x - P0.x);
+    c.y = 3 * (P1.y - P0.y);
+    fi_horner_points(a, b, c, P0, n, first, out);
+
+    // the end points must be exact to keep the path connected
+    if (first == 0)
+        out[0] = P0;
+    out[n - first] = P3;
+}
+
+// points of one quadratic bezier curve
+void fi_qua_bezier_points(FI_POINT_D ref, FI_POINT_D *in, int n, int first,
+                          FI_POINT_D *out) {
+    FI_POINT_D P0 = ref;
+    FI_POINT_D P1 = in[0];
+    FI_POINT_D P2 = in[1];
+    FI_POINT_D a = {0, 0};
+    FI_POINT_D b, c;
+
+    b.x = P0.x - 2 * P1.x + P2.x;
+    b.y = P0.y - 2 * P1.y + P2.y;
+    c.x = 2 * (P1.x - P0.x);
+    c.y = 2 * (P1.y - P0.y);
+    fi_horner_points(a, b, c, P0, n, first, out);
+
+    if (first == 0)
+        out[0] = P0;
+    out[n - first] = P2;
+}
@@ -0,0 +1,366 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define FI_HAVE_MMAP
+#endif
+
+/*
+ * Binary path data, the layout of FI_PACKED_PATH in little-endian. On a
+ * little-endian host with a 64 bits size_t the arrays are used in place, a
+ * mapped file is then a packed path without any copy. Otherwise the values are
+ * decoded one by one.
+ */
+
+bool fi_host_little_endian(void) {
+    uint16_t one = 1;
+    unsigned char c;
+    memcpy(&c, &one, 1);
+    return c == 1;
+}
+
+uint64_t fi_le_get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+void fi_le_put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++, v >>= 8)
+        p[i] = v & 0xff;
+}
+
+uint32_t fi_le_get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+void fi_le_put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++, v >>= 8)
+        p[i] = v & 0xff;
+}
+
+double fi_le_get_f64(const unsigned char *p) {
+    uint64_t u = fi_le_get_u64(p);
+    double v;
+    memcpy(&v, &u, 8);
+    return v;
+}
+
+void fi_le_put_f64(unsigned char *p, double v) {
+    uint64_t u;
+    memcpy(&u, &v, 8);
+    fi_le_put_u64(p, u);
+}
+
+bool fi_binary_in_place(const void *data) {
+    return fi_host_little_endian() && sizeof(size_t) == 8 &&
+           ((uintptr_t)data & 7) == 0;
+}
+
+void fi_binary_header(FI_PACKED_PATH *in, FI_BINARY_HEADER *hdr) {
+    memset(hdr, 0, sizeof(FI_BINARY_HEADER));
+    memcpy(hdr->magic, FI_BINARY_MAGIC, sizeof(hdr->magic));
+    hdr->version = FI_BINARY_VERSION;
+    hdr->header_size = FI_BINARY_HEADER_SIZE;
+    if (in == NULL)
+        return;
+    hdr->n_seg = in->n_seg;
+    hdr->n_point = in->n_point;
+    hdr->n_subpath = in->n_subpath;
+
+    uint32_t *count[] = {&hdr->n_end, &hdr->n_move, &hdr->n_line,
+                         &hdr->n_arc, &hdr->n_qbez, &hdr->n_cbez};
+    FI_POINT_D *pt = in->points;
+    FI_POINT_D ref = {0};
+    hdr->bbox[0] = (FI_POINT_D){INFINITY, INFINITY};
+    hdr->bbox[1] = (FI_POINT_D){-INFINITY, -INFINITY};
+    for (size_t i = 0; i < in->n_seg; i++) {
+        unsigned int type = in->types[i] & 0x0f;
+        if (type > FI_SEG_CUB_BEZIER)
+            continue;
+        (*count[type])++;
+        int n = fi_seg_n_point(type);
+        fi_bbox_add_seg(hdr->bbox, type, (FI_SEG_FLAG)(in->types[i] >> 4), ref,
+                        pt);
+        if (n > 0)
+            ref = pt[n - 1];
+        pt += n;
+    }
+    if (in->n_point == 0)
+        memset(hdr->bbox, 0, sizeof(hdr->bbox));
+}
+
+void fi_binary_put_header(unsigned char *p, FI_BINARY_HEADER *hdr) {
+    memset(p, 0, FI_BINARY_HEADER_SIZE);
+    memcpy(p, hdr->magic, 8);
+    fi_le_put_u32(p + 8, hdr->version);
+    fi_le_put_u32(p + 12, hdr->header_size);
+    fi_le_put_u64(p + 16, hdr->n_seg);
+    fi_le_put_u64(p + 24, hdr->n_point);
+    fi_le_put_u64(p + 32, hdr->n_subpath);
+    fi_le_put_u32(p + 40, hdr->n_end);
+    fi_le_put_u32(p + 44, hdr->n_move);
+    fi_le_put_u32(p + 48, hdr->n_line);
+    fi_le_put_u32(p + 52, hdr->n_arc);
+    fi_le_put_u32(p + 56, hdr->n_qbez);
+    fi_le_put_u32(p + 60, hdr->n_cbez);
+    fi_le_put_f64(p + 64, hdr->bbox[0].x);
+    fi_le_put_f64(p + 72, hdr->bbox[0].y);
+    fi_le_put_f64(p + 80, hdr->bbox[1].x);
+    fi_le_put_f64(p + 88, hdr->bbox[1].y);
+}
+
+size_t fi_binary_size(FI_PACKED_PATH *in) {
+    size_t size = FI_BINARY_HEADER_SIZE;
+    if (in != NULL)
+        size += in->n_point * sizeof(FI_POINT_D) + in->n_subpath * 8 +
+                in->n_seg;
+    return (size + 7) & ~(size_t)7;
+}
+
+int fi_encode_binary(FI_PACKED_PATH *in, void *buf, size_t size) {
+    size_t total = fi_binary_size(in);
+    if (size < total)
+        return ERR_BUFFER_FULL;
+
+    FI_BINARY_HEADER hdr;
+    unsigned char *p = buf;
+    fi_binary_header(in, &hdr);
+    fi_binary_put_header(p, &hdr);
+    p += FI_BINARY_HEADER_SIZE;
+    for (uint64_t i = 0; i < hdr.n_point; i++, p += 16) {
+        fi_le_put_f64(p, in->points[i].x);
+        fi_le_put_f64(p + 8, in->points[i].y);
+    }
+    for (uint64_t i = 0; i < hdr.n_subpath; i++, p += 8)
+        fi_le_put_u64(p, in->subpaths[i]);
+    if (hdr.n_seg > 0)
+        memcpy(p, in->types, hdr.n_seg);
+    p += hdr.n_seg;
+    memset(p, 0, (unsigned char *)buf + total - p);
+    return 0;
+}
+
+int fi_save_binary(FI_PACKED_PATH *in, FILE *out) {
+    size_t total = fi_binary_size(in);
+    unsigned char head[FI_BINARY_HEADER_SIZE];
+    int err = 0;
+
+    // encoded value by value if the arrays do not have the layout of the data
+    if (in == NULL || !fi_host_little_endian() || sizeof(size_t) != 8) {
+        unsigned char *buf = malloc(total);
+        fi_encode_binary(in, buf, total);
+        if (fwrite(buf, 1, total, out) != total)
+            err = ERR_IO;
+        free(buf);
+        return err;
+    }
+
+    FI_BINARY_HEADER hdr;
+    unsigned char pad[8] = {0};
+    fi_binary_header(in, &hdr);
+    fi_binary_put_header(head, &hdr);
+    size_t n_pad = total - FI_BINARY_HEADER_SIZE -
+                   hdr.n_point * sizeof(FI_POINT_D) - hdr.n_subpath * 8 -
+                   hdr.n_seg;
+    if (fwrite(head, 1, FI_BINARY_HEADER_SIZE, out) != FI_BINARY_HEADER_SIZE ||
+        fwrite(in->points, sizeof(FI_POINT_D), hdr.n_point, out) !=
+            hdr.n_point ||
+        fwrite(in->subpaths, 8, hdr.n_subpath, out) != hdr.n_subpath ||
+        fwrite(in->types, 1, hdr.n_seg, out) != hdr.n_seg ||
+        fwrite(pad, 1, n_pad, out) != n_pad)
+        err = ERR_IO;
+    return err;
+}
+
+int fi_read_binary_header(const void *data, size_t size,
+                          FI_BINARY_HEADER *out) {
+    const unsigned char *p = data;
+    if (size < FI_BINARY_HEADER_SIZE || memcmp(p, FI_BINARY_MAGIC, 8) != 0)
+        return ERR_BINARY_FORMAT;
+    memcpy(out->magic, p, 8);
+    out->version = fi_le_get_u32(p + 8);
+    out->header_size = fi_le_get_u32(p + 12);
+    if (out->version != FI_BINARY_VERSION)
+        return ERR_BINARY_VERSION;
+    out->n_seg = fi_le_get_u64(p + 16);
+    out->n_point = fi_le_get_u64(p + 24);
+    out->n_subpath = fi_le_get_u64(p + 32);
+    out->n_end = fi_le_get_u32(p + 40);
+    out->n_move = fi_le_get_u32(p + 44);
+    out->n_line = fi_le_get_u32(p + 48);
+    out->n_arc = fi_le_get_u32(p + 52);
+    out->n_qbez = fi_le_get_u32(p + 56);
+    out->n_cbez = fi_le_get_u32(p + 60);
+    out->bbox[0].x = fi_le_get_f64(p + 64);
+    out->bbox[0].y = fi_le_get_f64(p + 72);
+    out->bbox[1].x = fi_le_get_f64(p + 80);
+    out->bbox[1].y = fi_le_get_f64(p + 88);
+
+    // sizes checked one by one, their sum cannot overflow
+    if (out->header_size < FI_BINARY_HEADER_SIZE || out->header_size % 16 ||
+        out->header_size > size)
+        return ERR_BINARY_FORMAT;
+    size_t avail = size - out->header_size;
+    if (out->n_point > avail / sizeof(FI_POINT_D))
+        return ERR_BINARY_FORMAT;
+    avail -= out->n_point * sizeof(FI_POINT_D);
+    if (out->n_subpath > avail / 8)
+        return ERR_BINARY_FORMAT;
+    avail -= out->n_subpath * 8;
+    if (out->n_seg > avail)
+        return ERR_BINARY_FORMAT;
+    return 0;
+}
+
+int fi_binary_check(FI_BINARY_HEADER *hdr, const unsigned char *types,
+                    const unsigned char *subpaths) {
+    uint64_t count[FI_SEG_CUB_BEZIER + 1] = {0};
+    uint64_t n_point = 0;
+    for (uint64_t i = 0; i < hdr->n_seg; i++) {
+        unsigned int type = types[i] & 0x0f;
+        if (type > FI_SEG_CUB_BEZIER)
+            return ERR_BINARY_FORMAT;
+        count[type]++;
+        n_point += fi_seg_n_point(type);
+    }
+    if (n_point != hdr->n_point || count[FI_SEG_MOVE] != hdr->n_subpath ||
+        count[FI_SEG_END] != hdr->n_end || count[FI_SEG_LINE] != hdr->n_line ||
+        count[FI_SEG_ARC] != hdr->n_arc ||
+        count[FI_SEG_QUA_BEZIER] != hdr->n_qbez ||
+        count[FI_SEG_CUB_BEZIER] != hdr->n_cbez)
+        return ERR_BINARY_FORMAT;
+
+    // each subpath starts with its own M segment
+    uint64_t prev = 0;
+    for (uint64_t i = 0; i < hdr->n_subpath; i++) {
+        uint64_t first = fi_le_get_u64(subpaths + 8 * i);
+        if (first >= hdr->n_seg || (i > 0 && first <= prev) ||
+            (types[first] & 0x0f) != FI_SEG_MOVE)
+            return ERR_BINARY_FORMAT;
+        prev = first;
+    }
+    return 0;
+}
+
+int fi_load_binary(void *data, size_t size, FI_PACKED_PATH **out) {
+    FI_BINARY_HEADER hdr;
+    *out = NULL;
+    int ret = fi_read_binary_header(data, size, &hdr);
+    if (ret)
+        return ret;
+
+    unsigned char *points = (unsigned char *)data + hdr.header_size;
+    unsigned char *subpaths = points + hdr.n_point * sizeof(FI_POINT_D);
+    unsigned char *types = subpaths + hdr.n_subpath * 8;
+    ret = fi_binary_check(&hdr, types, subpaths);
+    if (ret)
+        return ret;
+
+    FI_PACKED_PATH *path;
+    if (fi_binary_in_place(data)) {
+        path = calloc(1, sizeof(FI_PACKED_PATH));
+        path->types = types;
+        path->points = (FI_POINT_D *)points;
+        path->subpaths = (size_t *)subpaths;
+        path->borrowed = true;
+    } else {
+        path = fi_new_packed(hdr.n_seg, hdr.n_point, hdr.n_subpath);
+        for (uint64_t i = 0; i < hdr.n_point; i++) {
+            path->points[i].x = fi_le_get_f64(points + 16 * i);
+            path->points[i].y = fi_le_get_f64(points + 16 * i + 8);
+        }
+        for (uint64_t i = 0; i < hdr.n_subpath; i++)
+            path->subpaths[i] = fi_le_get_u64(subpaths + 8 * i);
+        if (hdr.n_seg > 0)
+            memcpy(path->types, types, hdr.n_seg);
+    }
+    path->n_seg = hdr.n_seg;
+    path->n_point = hdr.n_point;
+    path->n_subpath = hdr.n_subpath;
+    *out = path;
+    return 0;
+}
+
+void fi_binary_unmap(void *map, size_t size) {
+#ifdef FI_HAVE_MMAP
+    munmap(map, size);
+#else
+    (void)size;
+    free(map);
+#endif
+}
+
+int fi_map_binary(const char *filename, FI_PACKED_PATH **out) {
+    *out = NULL;
+    void *map = NULL;
+    size_t size = 0;
+
+#ifdef FI_HAVE_MMAP
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return ERR_IO;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return ERR_IO;
+    }
+    size = st.st_size;
+    if (size < FI_BINARY_HEADER_SIZE) {
+        close(fd);
+        return ERR_BINARY_FORMAT;
+    }
+    // private and writable, fi_offset_packed() works on a copy of the pages
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return ERR_IO;
+#else
+    // no mapping, the file is read in one block
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL)
+        return ERR_IO;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        long end = ftell(f);
+        size = end > 0 ? (size_t)end : 0;
+    }
+    rewind(f);
+    map = malloc(size ? size : 1);
+    if (fread(map, 1, size, f) != size) {
+        fclose(f);
+        free(map);
+        return ERR_IO;
+    }
+    fclose(f);
+#endif
+
+    int ret = fi_load_binary(map, size, out);
+    if (ret != 0 || !(*out)->borrowed) {
+        fi_binary_unmap(map, size);
+        return ret;
+    }
+    (*out)->map = map;
+    (*out)->s_map = size;
+    return 0;
+}
@@ -13,10 +13,74 @@
 #include "ficlip.h"
 #include "ficlip-private.h"
 
-int fi_clip(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+int fi_clip_empty(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    *out = NULL;
+    switch (ops) {
+    case FI_AND:
+        break;
+    case FI_OR:
+    case FI_XOR:
+        if (p1 != NULL || p2 != NULL)
+            fi_copy_path(p1 != NULL ? p1 : p2, out);
+        break;
+    case FI_DIFF:
+        if (p1 != NULL)
+            fi_copy_path(p1, out);
+        break;
+    }
     return 0;
 }
 
+int fi_clip(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    FI_SWEEP_STATE sweep = {0};
+    int ret = fi_clip_with(&sweep, p1, p2, ops, out);
+    fi_free_sweep(&sweep);
+    return ret;
+}
+
+int fi_clip_with(FI_SWEEP_STATE *sweep, FI_PATH *p1, FI_PATH *p2, FI_OPS ops,
+                 FI_PATH **out) {
+    FI_PATH *subject = NULL;
+    FI_PATH *clip = NULL;
+    int ret = 0;
+
+    *out = NULL;
+    if (p1 != NULL && (ret = fi_validate_path(p1)))
+        return ret;
+    if (p2 != NULL && (ret = fi_validate_path(p2)))
+        return ret;
+
+    // trivial cases, one of the operands is empty
+    if (p1 == NULL || p2 == NULL)
+        return fi_clip_empty(p1, p2, ops, out);
+
+    // operands far apart
+    if (fi_clip_disjoint(p1, p2, ops, out))
+        return 0;
+
+    // the sweep only handles straight edges, work on linearized copies
+    subject = p1;
+    if (p1->meta->n_arc + p1->meta->n_qbez + p1->meta->n_cbez)
+        fi_linearize_to(p1, 0, &subject);
+    clip = p2;
+    if (p2->meta->n_arc + p2->meta->n_qbez + p2->meta->n_cbez)
+        fi_linearize_to(p2, 0, &clip);
+
+    if (!fi_clip_contained(subject, clip, ops, out) &&
+        !fi_clip_separate(subject, clip, ops, out) &&
+        !fi_clip_convex(subject, clip, ops, out, &ret)) {
+        sweep->ops = ops;
+        ret = fi_clip_rings(sweep, subject, clip, out);
+        fi_reset_sweep(sweep);
+    }
+
+    if (subject != p1)
+        fi_free_path(subject);
+    if (clip != p2)
+        fi_free_path(clip);
+    return ret;
+}
+
 int fi_compare_point(FI_POINT_D p1, FI_POINT_D p2) {
     int ret = 0;
     if (p1.x < p2.x)
@@ -117,78 +181,853 @@ int fi_validate_path(FI_PATH *path) {
         return 0;
 }
 
-void fi_insert_events(FI_PATH *path, FI_SWEEPEVENT **event_queue,
-                      FI_POLYGON_TYPE type) {
-    FI_PATH *tmp = path;
-    FI_SWEEPEVENT *segment_start;
-    FI_SWEEPEVENT *last_segment = NULL;
-    FI_SWEEPEVENT *ret = NULL;
+FI_SWEEPEVENT *fi_new_event(FI_SWEEP_STATE *sweep, FI_POINT_D pt, bool left,
+                            FI_SWEEPEVENT *other, FI_POLYGON_TYPE type,
+                            int contour_id) {
+    FI_SWEEPEVENT *event =
+        fi_arena_alloc(&sweep->events, sizeof(FI_SWEEPEVENT));
+    event->point = pt;
+    event->is_left_event = left;
+    event->other = other;
+    event->polygon_type = type;
+    event->contour_id = contour_id;
+    return event;
+}
+
+void fi_queue_append(FI_EVENT_QUEUE *queue, FI_SWEEPEVENT *event) {
+    if (queue->n == queue->size) {
+        queue->size = queue->size ? queue->size * 2 : 256;
+        queue->heap =
+            realloc(queue->heap, queue->size * sizeof(FI_SWEEPEVENT *));
+    }
+    queue->heap[queue->n++] = event;
+}
+
+void fi_queue_sift_up(FI_EVENT_QUEUE *queue, size_t i) {
+    FI_SWEEPEVENT **heap = queue->heap;
+    FI_SWEEPEVENT *event = heap[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / 4;
+        if (fi_compare_events(event, heap[parent]) >= 0)
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = event;
+}
+
+void fi_queue_sift_down(FI_EVENT_QUEUE *queue, size_t i) {
+    FI_SWEEPEVENT **heap = queue->heap;
+    FI_SWEEPEVENT *event = heap[i];
+    size_t n = queue->n;
+    while (true) {
+        size_t child = 4 * i + 1;
+        if (child >= n)
+            break;
+        // smallest of the (up to) 4 children
+        size_t min = child;
+        size_t last = child + 4 < n ? child + 4 : n;
+        for (child++; child < last; child++)
+            if (fi_compare_events(heap[child], heap[min]) < 0)
+                min = child;
+        if (fi_compare_events(heap[min], event) >= 0)
+            break;
+        heap[i] = heap[min];
+        i = min;
+    }
+    heap[i] = event;
+}
+
+void fi_queue_push(FI_EVENT_QUEUE *queue, FI_SWEEPEVENT *event) {
+    fi_queue_append(queue, event);
+    fi_queue_sift_up(queue, queue->n - 1);
+}
+
+FI_SWEEPEVENT *fi_queue_pop(FI_EVENT_QUEUE *queue) {
+    if (queue->n == 0)
+        return NULL;
+    FI_SWEEPEVENT *ret = queue->heap[0];
+    queue->heap[0] = queue->heap[--queue->n];
+    if (queue->n > 0)
+        fi_queue_sift_down(queue, 0);
+    return ret;
+}
+
+void fi_insert_edge(FI_SWEEP_STATE *sweep, FI_POINT_D s, FI_POINT_D e,
+                    FI_POLYGON_TYPE type) {
+    // zero length edges have no effect on the result
+    if (fi_compare_point(s, e) == 0)
+        return;
+    FI_SWEEPEVENT *e1 =
+        fi_new_event(sweep, s, false, NULL, type, sweep->n_contour);
+    FI_SWEEPEVENT *e2 =
+        fi_new_event(sweep, e, false, e1, type, sweep->n_contour);
+    e1->other = e2;
+    e1->seg[0] = e2->seg[0] = s;
+    e1->seg[1] = e2->seg[1] = e;
+    e1->is_left_event = fi_is_left_event(e1);
+    e2->is_left_event = !e1->is_left_event;
+    fi_queue_append(&sweep->queue, e1);
+    fi_queue_append(&sweep->queue, e2);
+}
+
+FI_PATH *fi_insert_ring(FI_SWEEP_STATE *sweep, FI_PATH *ring,
+                        FI_POLYGON_TYPE type) {
+    FI_PATH *tmp = ring;
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
 
+    /*
+     * each edge (last point <-> current point) gives 2 events, one for each
+     * of its endpoints, linked together by "other"
+     */
     while (tmp != NULL) {
         FI_POINT_D *pt = tmp->section.points;
-        int pt_index = tmp->section.n_point - 1;
-        FI_SEG_TYPE type = tmp->section.type;
-        /*
-         * for each point, we create 2 events:
-         * - one for the segment prev_point <-> current_point
-         * - one for the segment current_point <-> next_point
-         */
-        FI_SWEEPEVENT *new_event_prev = calloc(1, sizeof(FI_SWEEPEVENT));
-        FI_SWEEPEVENT *new_event_next = calloc(1, sizeof(FI_SWEEPEVENT));
-        if (ret == NULL)
-            ret = new_event_prev;
-        switch (type) {
+        switch (tmp->section.type) {
         case FI_SEG_END:
-            if (last_segment != NULL) {
-                segment_start->other = last_segment;
-                segment_start->is_left_event = fi_is_left_event(segment_start);
-                last_segment->other = segment_start;
-                last_segment->is_left_event = fi_is_left_event(last_segment);
-            }
-            free(new_event_prev);
-            free(new_event_next);
+            fi_insert_edge(sweep, last, first, type);
+            last = first;
+            sweep->n_contour++;
+            break;
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
             break;
         case FI_SEG_LINE:
+            fi_insert_edge(sweep, last, pt[0], type);
+            last = pt[0];
+            break;
         case FI_SEG_ARC:
+            fi_insert_edge(sweep, last, pt[2], type);
+            last = pt[2];
+            break;
         case FI_SEG_QUA_BEZIER:
+            fi_insert_edge(sweep, last, pt[1], type);
+            last = pt[1];
+            break;
         case FI_SEG_CUB_BEZIER:
-        case FI_SEG_MOVE:
-            if (last_segment != NULL) {
-                last_segment->other = new_event_prev;
-                last_segment->is_left_event = fi_is_left_event(last_segment);
-                last_segment->next = new_event_prev;
-            }
-            new_event_prev->other = last_segment;
-            new_event_prev->is_left_event = fi_is_left_event(new_event_prev);
-            new_event_prev->point = pt[pt_index];
-            new_event_prev->polygon_type = type;
-            new_event_prev->next = new_event_next;
-            new_event_next->prev = new_event_prev;
-            new_event_next->point = pt[pt_index];
-            new_event_next->polygon_type = type;
-            last_segment = new_event_next;
+            fi_insert_edge(sweep, last, pt[2], type);
+            last = pt[2];
             break;
         }
-        if (type == FI_SEG_MOVE)
-            segment_start = new_event_prev;
+        bool end = tmp->section.type == FI_SEG_END;
         tmp = tmp->next;
+        if (end)
+            break;
+    }
+    return tmp;
+}
+
+void fi_insert_events(FI_SWEEP_STATE *sweep, FI_PATH *path,
+                      FI_POLYGON_TYPE type) {
+    FI_PATH *tmp = path;
+    while (tmp != NULL)
+        tmp = fi_insert_ring(sweep, tmp, type);
+}
+
+int fi_compare_events_p(const void *in_1, const void *in_2) {
+    return fi_compare_events(*(FI_SWEEPEVENT **)in_1,
+                             *(FI_SWEEPEVENT **)in_2);
+}
+
+void fi_sort_events(FI_EVENT_QUEUE *queue) {
+    if (queue->n < 2)
+        return;
+    // bottom-up heap construction, from the last internal node
+    for (size_t i = (queue->n - 2) / 4 + 1; i > 0; i--)
+        fi_queue_sift_down(queue, i - 1);
+}
+
+void fi_create_sweepevent_queue(FI_SWEEP_STATE *sweep, FI_PATH *path_subject,
+                                FI_PATH *path_clip) {
+    // a reused sweep keeps the blocks of its arena
+    if (sweep->events.block_size == 0)
+        fi_arena_init(&sweep->events, 0);
+    sweep->current = NULL;
+    fi_insert_events(sweep, path_subject, FI_SUBJECT);
+    fi_insert_events(sweep, path_clip, FI_CLIPPED);
+    fi_sort_events(&sweep->queue);
+}
+
+void fi_reset_sweep(FI_SWEEP_STATE *sweep) {
+    fi_arena_reset(&sweep->events);
+    sweep->queue.n = 0;
+    sweep->n_processed = 0;
+    sweep->current = NULL;
+    sweep->status = NULL;
+    sweep->n_status = 0;
+    sweep->n_contour = 0;
+    sweep->requeue = false;
+    sweep->fixed_clip = false;
+}
+
+void fi_free_sweep(FI_SWEEP_STATE *sweep) {
+    fi_arena_free(&sweep->events);
+    free(sweep->queue.heap);
+    free(sweep->processed);
+    memset(sweep, 0, sizeof(FI_SWEEP_STATE));
+}
+
+double fi_orient2d(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc) {
+    double detleft = (pa.x - pc.x) * (pb.y - pc.y);
+    double detright = (pa.y - pc.y) * (pb.x - pc.x);
+    double det = detleft - detright;
+    // the rounding errors are below a fraction of the products, only a
+    // cancellation (products of the same sign) can make the sign wrong
+    double detsum = fabs(detleft) + fabs(detright);
+    if (fabs(det) >= FI_CCW_ERRBOUND_A * detsum)
+        return det;
+    return fi_orient2d_adapt(pa, pb, pc, detsum);
+}
+
+double fi_signed_area(FI_POINT_D p0, FI_POINT_D p1, FI_POINT_D p2) {
+    return fi_orient2d(p0, p1, p2);
+}
+
+bool fi_is_below(FI_SWEEPEVENT *e, FI_POINT_D p) {
+    if (e->is_left_event)
+        return fi_signed_area(e->point, e->other->point, p) > 0;
+    return fi_signed_area(e->other->point, e->point, p) > 0;
+}
+
+bool fi_is_vertical(FI_SWEEPEVENT *e) {
+    return e->point.x == e->other->point.x;
+}
+
+int fi_compare_events(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2) {
+    int cmp = fi_compare_point(e1->point, e2->point);
+    if (cmp != 0)
+        return cmp;
+    // same point, process the right events first
+    if (e1->is_left_event != e2->is_left_event)
+        return e1->is_left_event ? 1 : -1;
+    // same point, both left or both right, the lowest edge goes first
+    if (fi_signed_area(e1->point, e1->other->point, e2->other->point) != 0)
+        return fi_is_below(e1, e2->other->point) ? -1 : 1;
+    // collinear edges, subject first
+    if (e1->polygon_type == e2->polygon_type)
+        return 0;
+    return e1->polygon_type == FI_CLIPPED ? 1 : -1;
+}
+
+bool fi_same_line(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2) {
+    if (!e1->off_seg && !e2->off_seg)
+        return false;
+    return fi_orient2d(e1->seg[0], e1->seg[1], e2->seg[0]) == 0 &&
+           fi_orient2d(e1->seg[0], e1->seg[1], e2->seg[1]) == 0;
+}
+
+int fi_compare_segments(FI_SWEEPEVENT *le1, FI_SWEEPEVENT *le2) {
+    if (le1 == le2)
+        return 0;
+
+    if (!fi_same_line(le1, le2) &&
+        (fi_signed_area(le1->point, le1->other->point, le2->point) != 0 ||
+         fi_signed_area(le1->point, le1->other->point, le2->other->point) !=
+             0)) {
+        // edges are not collinear
+        if (fi_compare_point(le1->point, le2->point) == 0)
+            return fi_is_below(le1, le2->other->point) ? -1 : 1;
+        if (le1->point.x == le2->point.x)
+            return le1->point.y < le2->point.y ? -1 : 1;
+        // le2 was inserted first, is le1 above or below it?
+        if (fi_compare_events(le1, le2) == 1)
+            return fi_is_below(le2, le1->point) ? 1 : -1;
+        // le1 was inserted first, is le2 above or below it?
+        return fi_is_below(le1, le2->point) ? -1 : 1;
+    }
+
+    if (le1->polygon_type == le2->polygon_type) {
+        // collinear edges of the same polygon
+        if (fi_compare_point(le1->point, le2->point) == 0) {
+            if (fi_compare_point(le1->other->point, le2->other->point) == 0)
+                return 0;
+            return le1->contour_id > le2->contour_id ? 1 : -1;
+        }
+    } else {
+        // collinear edges of different polygons, subject first
+        return le1->polygon_type == FI_SUBJECT ? -1 : 1;
+    }
+    return fi_compare_events(le1, le2) == 1 ? 1 : -1;
+}
+
+FI_POINT_D fi_lerp(FI_POINT_D p, double s, FI_POINT_D d) {
+    FI_POINT_D ret;
+    ret.x = p.x + s * d.x;
+    ret.y = p.y + s * d.y;
+    return ret;
+}
+
+bool fi_near_point(FI_POINT_D p1, FI_POINT_D p2) {
+    double scale = fmax(fmax(fabs(p1.x), fabs(p1.y)), 1.0) * FI_EPSILON;
+    return fabs(p1.x - p2.x) <= scale && fabs(p1.y - p2.y) <= scale;
+}
+
+/* computed intersection points only a few ulps away from an endpoint are
+ * snapped on it, otherwise rounding errors can split the same edges forever
+ */
+FI_POINT_D fi_snap_intersection(FI_POINT_D p, FI_POINT_D a1, FI_POINT_D a2,
+                                FI_POINT_D b1, FI_POINT_D b2) {
+    if (fi_near_point(p, a1))
+        return a1;
+    if (fi_near_point(p, a2))
+        return a2;
+    if (fi_near_point(p, b1))
+        return b1;
+    if (fi_near_point(p, b2))
+        return b2;
+    return p;
+}
+
+int fi_segment_intersection(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                            FI_POINT_D b2, FI_POINT_D *out) {
+    FI_POINT_D va = {a2.x - a1.x, a2.y - a1.y};
+    FI_POINT_D vb = {b2.x - b1.x, b2.y - b1.y};
+    FI_POINT_D e = {b1.x - a1.x, b1.y - a1.y};
+    double kross = va.x * vb.y - va.y * vb.x;
+    double sqr_len_a = va.x * va.x + va.y * va.y;
+
+    if (kross != 0) {
+        double s = (e.x * vb.y - e.y * vb.x) / kross;
+        double t = (e.x * va.y - e.y * va.x) / kross;
+        FI_POINT_D p = fi_lerp(a1, s, va);
+        // lines are not parallel, an endpoint exactly on the other segment is
+        // the crossing, as is: the computed one is within a tiny fraction of
+        // the lengths of it, unless the lines are close to parallel
+        double lengths = fabs(va.x) + fabs(va.y) + fabs(vb.x) + fabs(vb.y);
+        bool near_parallel = fabs(kross) < 1e-6 * (fabs(va.x) + fabs(va.y)) *
+                                               (fabs(vb.x) + fabs(vb.y));
+        FI_POINT_D ends[4] = {b1, b2, a1, a2};
+        for (int i = 0; i < 4; i++) {
+            FI_POINT_D s1 = i < 2 ? a1 : b1;
+            FI_POINT_D s2 = i < 2 ? a2 : b2;
+            double dist = fabs(p.x - ends[i].x) + fabs(p.y - ends[i].y);
+            if ((near_parallel || dist <= 1e-6 * lengths) &&
+                fi_on_segment(s1, s2, ends[i])) {
+                out[0] = ends[i];
+                return 1;
+            }
+        }
+        // a crossing just past an endpoint is a rounding error, keep it
+        if ((s < 0 || s > 1) && !fi_near_point(p, a1) && !fi_near_point(p, a2))
+            return 0;
+        if ((t < 0 || t > 1) && !fi_near_point(p, b1) && !fi_near_point(p, b2))
+            return 0;
+        if (s == 0 || s == 1) {
+            // on an endpoint of a, use it as is
+            out[0] = s == 0 ? a1 : a2;
+            return 1;
+        }
+        if (t == 0 || t == 1) {
+            out[0] = t == 0 ? b1 : b2;
+            return 1;
+        }
+        out[0] = fi_snap_intersection(p, a1, a2, b1, b2);
+        return 1;
+    }
+
+    // lines are parallel, are they the same line?
+    if (fi_orient2d(a1, a2, b1) != 0 || fi_orient2d(a1, a2, b2) != 0)
+        return 0;
+
+    double sa = (va.x * e.x + va.y * e.y) / sqr_len_a;
+    double sb = sa + (va.x * vb.x + va.y * vb.y) / sqr_len_a;
+    double smin = sa < sb ? sa : sb;
+    double smax = sa < sb ? sb : sa;
+    if (smin > 1 || smax < 0)
+        return 0;
+    if (smin == 1) {
+        out[0] = a2;
+        return 1;
+    }
+    if (smax == 0) {
+        out[0] = a1;
+        return 1;
+    }
+    // the overlap ends are endpoints of a or b
+    out[0] = smin > 0 ? (sa < sb ? b1 : b2) : a1;
+    out[1] = smax < 1 ? (sa < sb ? b2 : b1) : a2;
+    return 2;
+}
+
+FI_POINT_D fi_refine_crossing(FI_SWEEPEVENT *se1, FI_SWEEPEVENT *se2,
+                              FI_POINT_D p) {
+    FI_SWEEPEVENT *se[2] = {se1, se2};
+    for (int i = 0; i < 2; i++)
+        if (fi_compare_point(p, se[i]->point) == 0 ||
+            fi_compare_point(p, se[i]->other->point) == 0)
+            return p;
+    FI_POINT_D q;
+    if (!fi_line_crossing(se1->seg[0], se1->seg[1], se2->seg[0], se2->seg[1],
+                          &q))
+        return p;
+    // the crossing must stay inside both parts, or they would be reversed
+    for (int i = 0; i < 2; i++)
+        if (fi_compare_point(q, se[i]->point) <= 0 ||
+            fi_compare_point(q, se[i]->other->point) >= 0)
+            return p;
+    return q;
+}
+
+bool fi_on_segment(FI_POINT_D a, FI_POINT_D b, FI_POINT_D p) {
+    // out of the bounding box or on an end, before the exact orientation
+    if (p.x < fmin(a.x, b.x) || p.x > fmax(a.x, b.x) ||
+        p.y < fmin(a.y, b.y) || p.y > fmax(a.y, b.y) ||
+        fi_compare_point(p, a) == 0 || fi_compare_point(p, b) == 0)
+        return false;
+    return fi_orient2d(a, b, p) == 0;
+}
+
+void fi_divide_segment(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *se, FI_POINT_D p) {
+    // never create an edge of (almost) zero length, but a point exactly on
+    // the edge (a vertex of another edge) splits it however close to its ends
+    if ((fi_near_point(se->point, p) || fi_near_point(se->other->point, p)) &&
+        !fi_on_segment(se->point, se->other->point, p))
+        return;
+
+    // right event of [se, p] and left event of [p, se->other]
+    FI_SWEEPEVENT *r =
+        fi_new_event(sweep, p, false, se, se->polygon_type, se->contour_id);
+    FI_SWEEPEVENT *l = fi_new_event(sweep, p, true, se->other,
+                                    se->polygon_type, se->contour_id);
+    l->in_out = se->in_out;
+    memcpy(r->seg, se->seg, sizeof(se->seg));
+    memcpy(l->seg, se->seg, sizeof(se->seg));
+    se->off_seg = se->off_seg || fi_orient2d(se->seg[0], se->seg[1], p) != 0;
+    se->other->off_seg = r->off_seg = l->off_seg = se->off_seg;
+
+    // avoid a rounding error, the left event would be processed after the
+    // right event
+    if (fi_compare_events(l, se->other) > 0) {
+        se->other->is_left_event = true;
+        l->is_left_event = false;
+    }
+    se->other->other = l;
+    se->other = r;
+    fi_queue_push(&sweep->queue, l);
+    fi_queue_push(&sweep->queue, r);
+
+    // an edge ends at the point being processed, it must leave the sweep
+    // line before the current left event is inserted
+    if (sweep->current->is_left_event &&
+        fi_compare_point(p, sweep->current->point) == 0)
+        sweep->requeue = true;
+}
+
+bool fi_near_overlap(FI_SWEEPEVENT *se1, FI_SWEEPEVENT *se2) {
+    bool left = fi_compare_point(se1->point, se2->point) == 0;
+    bool right = fi_compare_point(se1->other->point, se2->other->point) == 0;
+    if (left == right)
+        return false;
+    // the end of the shorter edge which is not shared
+    FI_SWEEPEVENT *shorter = se1;
+    FI_SWEEPEVENT *longer = se2;
+    if (left ? fi_compare_point(se2->other->point, se1->other->point) < 0
+             : fi_compare_point(se2->point, se1->point) > 0) {
+        shorter = se2;
+        longer = se1;
+    }
+    FI_POINT_D e = left ? shorter->other->point : shorter->point;
+    FI_POINT_D a = longer->point;
+    FI_POINT_D b = longer->other->point;
+    double tolerance = fmax(fmax(fabs(e.x), fabs(e.y)), 1.0) * FI_EPSILON;
+    return fabs(fi_orient2d(a, b, e)) <=
+           tolerance * hypot(b.x - a.x, b.y - a.y);
+}
+
+bool fi_is_coincident(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2) {
+    if (fi_compare_point(e1->point, e2->point) != 0)
+        return false;
+    return fi_compare_point(e1->other->point, e2->other->point) == 0 ||
+           fi_near_overlap(e1, e2);
+}
+
+void fi_coincident_edges(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event) {
+    FI_SWEEPEVENT *first = event;
+    FI_SWEEPEVENT *e;
+    while ((e = fi_status_prev(first)) != NULL && fi_is_coincident(e, event))
+        first = e;
+
+    // the edges of the group all end at the closest right endpoint
+    FI_POINT_D end = first->other->point;
+    size_t n = 0;
+    for (e = first; e != NULL && fi_is_coincident(e, first);
+         e = fi_status_next(e), n++)
+        if (fi_compare_point(e->other->point, end) < 0)
+            end = e->other->point;
+    // the group leaves the sweep line, with some of its edges already removed
+    if (sweep->current != NULL &&
+        fi_compare_point(end, sweep->current->point) == 0)
+        return;
+    e = first;
+    for (size_t i = 0; i < n; i++, e = fi_status_next(e))
+        if (fi_compare_point(e->other->point, end) != 0)
+            fi_divide_segment(sweep, e, end);
+
+    // the fields of the edges stacked in the status order, only while the
+    // sweep line is at their left point: they are set from the edges below
+    // them when they are inserted
+    bool inserted = sweep->current != NULL &&
+                    fi_compare_point(first->point, sweep->current->point) == 0;
+    FI_SWEEPEVENT *prev = fi_status_prev(first);
+    FI_SWEEPEVENT *lowest[2] = {NULL, NULL};
+    bool odd[2] = {false, false};
+    e = first;
+    for (size_t i = 0; i < n; i++, prev = e, e = fi_status_next(e)) {
+        int op = e->polygon_type == FI_SUBJECT ? 0 : 1;
+        if (inserted) {
+            e->type = FI_NORMAL;
+            fi_compute_fields(sweep, e, prev);
+        }
+        e->type = FI_NON_CONTRIBUTIN;
+        e->in_result = false;
+        if (lowest[op] == NULL)
+            lowest[op] = e;
+        odd[op] = !odd[op];
+    }
+    if (sweep->operand != NULL)
+        return;
+
+    // with the even-odd rule the edges of an operand cancel out by pairs, the
+    // lowest edge of each operand left stands for the group: its in_out is
+    // the side of the group in its operand
+    if (odd[0] && odd[1]) {
+        lowest[0]->type = lowest[0]->in_out == lowest[1]->in_out
+                              ? FI_SAME_TRANSITION
+                              : FI_DIFFERENT_TRANSITION;
+        lowest[0]->in_result = fi_in_result(lowest[0], sweep->ops);
+    } else if (odd[0] || odd[1]) {
+        // and it is inside the other operand as if the edges of the other
+        // operand were not there
+        int op = odd[0] ? 0 : 1;
+        FI_SWEEPEVENT alone = *lowest[op];
+        lowest[op]->type = FI_NORMAL;
+        alone.type = FI_NORMAL;
+        if (lowest[1 - op] != NULL)
+            alone.inside = lowest[1 - op]->in_out;
+        lowest[op]->in_result = fi_in_result(&alone, sweep->ops);
+    }
+}
+
+void fi_check_coincident(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event) {
+    FI_SWEEPEVENT *prev = fi_status_prev(event);
+    FI_SWEEPEVENT *next = fi_status_next(event);
+    if (event->type != FI_NORMAL ||
+        (prev != NULL && fi_is_coincident(prev, event)) ||
+        (next != NULL && fi_is_coincident(next, event)))
+        fi_coincident_edges(sweep, event);
+}
+
+int fi_possible_intersection(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *se1,
+                             FI_SWEEPEVENT *se2) {
+    FI_POINT_D inter[2];
+    int n_inter;
+    if (fi_same_line(se1, se2)) {
+        // parts of collinear input edges, their rounded ends are off the line
+        n_inter =
+            fi_compare_point(se1->point, se2->other->point) < 0 &&
+                    fi_compare_point(se2->point, se1->other->point) < 0
+                ? 2
+                : 0;
+    } else {
+        n_inter = fi_segment_intersection(se1->point, se1->other->point,
+                                          se2->point, se2->other->point, inter);
+        // edges split at inexact crossings can be collinear up to the
+        // rounding, even parallel, and still overlap
+        if (n_inter < 2 && fi_near_overlap(se1, se2))
+            n_inter = 2;
+    }
+
+    if (n_inter == 0)
+        return 0;
+
+    // the edges only share an endpoint, up to the rounding, unless the
+    // endpoint of one is exactly inside the other
+    if (n_inter == 1 &&
+        (fi_near_point(se1->point, se2->point) ||
+         fi_near_point(se1->other->point, se2->other->point)) &&
+        !fi_on_segment(se1->point, se1->other->point, inter[0]) &&
+        !fi_on_segment(se2->point, se2->other->point, inter[0]))
+        return 0;
+
+    if (n_inter == 1) {
+        inter[0] = fi_refine_crossing(se1, se2, inter[0]);
+        fi_divide_segment(sweep, se1, inter[0]);
+        fi_divide_segment(sweep, se2, inter[0]);
+        // shortened to the crossing, an edge can now overlap the edges next
+        // to it
+        fi_check_coincident(sweep, se1);
+        fi_check_coincident(sweep, se2);
+        return 1;
+    }
+
+    // the edges overlap
+    FI_SWEEPEVENT *events[4];
+    int n_events = 0;
+    bool left_coincide = false;
+    bool right_coincide = false;
+
+    if (fi_compare_point(se1->point, se2->point) == 0) {
+        left_coincide = true;
+    } else if (fi_compare_events(se1, se2) == 1) {
+        events[n_events++] = se2;
+        events[n_events++] = se1;
+    } else {
+        events[n_events++] = se1;
+        events[n_events++] = se2;
+    }
+
+    if (fi_compare_point(se1->other->point, se2->other->point) == 0) {
+        right_coincide = true;
+    } else if (fi_compare_events(se1->other, se2->other) == 1) {
+        events[n_events++] = se2->other;
+        events[n_events++] = se1->other;
+    } else {
+        events[n_events++] = se1->other;
+        events[n_events++] = se2->other;
     }
-    if (*event_queue != NULL) {
-        last_segment->next = *event_queue;
-        (*event_queue)->prev = last_segment;
+
+    if (left_coincide) {
+        // both edges are equal or share the left endpoint
+        if (!right_coincide)
+            fi_divide_segment(sweep, events[1]->other, events[0]->point);
+        fi_coincident_edges(sweep, se1);
+        return 2;
+    }
+
+    if (right_coincide) {
+        // the edges share the right endpoint
+        fi_divide_segment(sweep, events[0], events[1]->point);
+        return 3;
+    }
+
+    if (events[0] != events[3]->other) {
+        // no edge includes totally the other one
+        fi_divide_segment(sweep, events[0], events[1]->point);
+        fi_divide_segment(sweep, events[1], events[2]->point);
+        return 3;
+    }
+
+    // one edge includes the other one
+    fi_divide_segment(sweep, events[0], events[1]->point);
+    fi_divide_segment(sweep, events[3]->other, events[2]->point);
+    return 3;
+}
+
+bool fi_in_result(FI_SWEEPEVENT *event, FI_OPS ops) {
+    switch (event->type) {
+    case FI_NORMAL:
+        switch (ops) {
+        case FI_AND:
+            return event->inside;
+        case FI_OR:
+            return !event->inside;
+        case FI_XOR:
+            return true;
+        case FI_DIFF:
+            return (event->polygon_type == FI_SUBJECT && !event->inside) ||
+                   (event->polygon_type == FI_CLIPPED && event->inside);
+        }
+        break;
+    case FI_SAME_TRANSITION:
+        return ops == FI_AND || ops == FI_OR;
+    case FI_DIFFERENT_TRANSITION:
+        return ops == FI_DIFF;
+    case FI_NON_CONTRIBUTIN:
+        return false;
+    }
+    return false;
+}
+
+void fi_compute_fields(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                       FI_SWEEPEVENT *prev) {
+    if (sweep->operand != NULL) {
+        fi_overlay_fields(sweep, event, prev);
+        return;
+    }
+    bool in_out;
+    if (prev == NULL) {
+        in_out = false;
+        event->inside = false;
+    } else if (event->polygon_type == prev->polygon_type) {
+        // the edge below belongs to the same polygon
+        in_out = !prev->in_out;
+        event->inside = prev->inside;
+    } else {
+        // the edge below belongs to the other polygon
+        in_out = prev->inside;
+        event->inside = fi_is_vertical(prev) ? prev->in_out : !prev->in_out;
+    }
+    // the in_out of the edges of a prepared clip path is already known
+    if (!sweep->fixed_clip || event->polygon_type != FI_CLIPPED)
+        event->in_out = in_out;
+    event->in_result = fi_in_result(event, sweep->ops);
+}
+
+/* put back the current event in the queue, the events created at its point
+ * will be processed first
+ */
+void fi_requeue_current(FI_SWEEP_STATE *sweep) {
+    FI_SWEEPEVENT *event = sweep->current;
+    fi_status_remove(sweep, event);
+    sweep->requeue = false;
+    sweep->n_processed--;
+    fi_queue_push(&sweep->queue, event);
+}
+
+void fi_subdivide(FI_SWEEP_STATE *sweep) {
+    while ((sweep->current = fi_queue_pop(&sweep->queue)) != NULL) {
+        FI_SWEEPEVENT *event = sweep->current;
+        if (sweep->n_processed == sweep->s_processed) {
+            sweep->s_processed =
+                sweep->s_processed ? sweep->s_processed * 2 : 256;
+            sweep->processed =
+                realloc(sweep->processed,
+                        sweep->s_processed * sizeof(FI_SWEEPEVENT *));
+        }
+        sweep->processed[sweep->n_processed++] = event;
+
+        if (event->is_left_event) {
+            fi_status_insert(sweep, event);
+            FI_SWEEPEVENT *prev = fi_status_prev(event);
+            FI_SWEEPEVENT *next = fi_status_next(event);
+
+            // the fields of overlapping edges are computed with their group
+            // (see fi_coincident_edges())
+            fi_compute_fields(sweep, event, prev);
+            if (next != NULL)
+                fi_possible_intersection(sweep, event, next);
+            if (prev != NULL)
+                fi_possible_intersection(sweep, prev, event);
+            if (sweep->requeue)
+                fi_requeue_current(sweep);
+        } else {
+            FI_SWEEPEVENT *left = event->other;
+            if (left->node.linked) {
+                FI_SWEEPEVENT *prev = fi_status_prev(left);
+                FI_SWEEPEVENT *next = fi_status_next(left);
+                fi_status_remove(sweep, left);
+                if (prev != NULL && next != NULL)
+                    fi_possible_intersection(sweep, prev, next);
+            }
+        }
     }
-    *event_queue = ret;
 }
 
-void fi_sort_events(FI_SWEEPEVENT **event_queue) {
-    // TODO
-    return;
+/* next unprocessed event starting at the same point, or the closest
+ * unprocessed one before it */
+int fi_next_pos(int pos, FI_SWEEPEVENT **events, int n_events,
+                bool *processed, int orig_pos) {
+    FI_POINT_D p = events[pos]->point;
+    int new_pos = pos + 1;
+
+    while (new_pos < n_events &&
+           fi_compare_point(events[new_pos]->point, p) == 0) {
+        if (!processed[new_pos])
+            return new_pos;
+        new_pos++;
+    }
+
+    new_pos = pos - 1;
+    while (new_pos > orig_pos && processed[new_pos])
+        new_pos--;
+    return new_pos;
 }
 
-void fi_create_sweepevent_queue(FI_PATH *path_subject, FI_PATH *path_clip,
-                                FI_SWEEPEVENT **event_queue) {
-    *event_queue = NULL;
-    fi_insert_events(path_subject, event_queue, FI_SUBJECT);
-    fi_insert_events(path_clip, event_queue, FI_CLIPPED);
-    fi_sort_events(event_queue);
+int fi_connect_edges(FI_SWEEP_STATE *sweep, FI_PATH **out) {
+    int n_events = 0;
+
+    // keep the events of the edges part of the result
+    for (size_t i = 0; i < sweep->n_processed; i++) {
+        FI_SWEEPEVENT *tmp = sweep->processed[i];
+        if ((tmp->is_left_event && tmp->in_result) ||
+            (!tmp->is_left_event && tmp->other->in_result))
+            n_events++;
+    }
+    *out = NULL;
+    if (n_events == 0)
+        return 0;
+
+    // scratch arrays, released with the events of the sweep
+    FI_SWEEPEVENT **events =
+        fi_arena_alloc(&sweep->events, n_events * sizeof(FI_SWEEPEVENT *));
+    n_events = 0;
+    for (size_t i = 0; i < sweep->n_processed; i++) {
+        FI_SWEEPEVENT *tmp = sweep->processed[i];
+        if ((tmp->is_left_event && tmp->in_result) ||
+            (!tmp->is_left_event && tmp->other->in_result))
+            events[n_events++] = tmp;
+    }
+    return fi_connect_events(sweep, events, n_events, out);
+}
+
+int fi_connect_events(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT **events,
+                      int n_events, FI_PATH **out) {
+    FI_PATH *out_current = NULL;
+    int ret = 0;
+
+    *out = NULL;
+    if (n_events == 0)
+        return 0;
+    bool *processed = fi_arena_alloc(&sweep->events, n_events * sizeof(bool));
+
+    // overlapping edges can leave the queue slightly out of order
+    qsort(events, n_events, sizeof(FI_SWEEPEVENT *), fi_compare_events_p);
+
+    for (int i = 0; i < n_events; i++)
+        events[i]->pos = i;
+    // pos of an event now points to the position of its other event
+    for (int i = 0; i < n_events; i++) {
+        if (!events[i]->is_left_event) {
+            int swap = events[i]->pos;
+            events[i]->pos = events[i]->other->pos;
+            events[i]->other->pos = swap;
+        }
+    }
+
+    FI_POINT_D *contour =
+        fi_arena_alloc(&sweep->events, (n_events + 1) * sizeof(FI_POINT_D));
+    for (int i = 0; i < n_events && !ret; i++) {
+        if (processed[i])
+            continue;
+
+        int pos = i;
+        int n_contour = 0;
+        contour[n_contour++] = events[i]->point;
+        while (n_contour <= n_events) {
+            processed[pos] = true;
+            pos = events[pos]->pos;
+            processed[pos] = true;
+            contour[n_contour++] = events[pos]->point;
+            pos = fi_next_pos(pos, events, n_events, processed, i);
+            if (pos <= i || pos >= n_events)
+                break;
+        }
+
+        // the closing point is implied by Z
+        if (fi_compare_point(contour[n_contour - 1], contour[0]) == 0)
+            n_contour--;
+        if (n_contour < 3)
+            continue;
+
+        bool first = out_current == NULL;
+        ret = fi_append_new_seg(&out_current, FI_SEG_MOVE);
+        // at most one segment per event
+        if (first && !ret && out_current->meta->arena != NULL)
+            fi_reserve_path(&out_current, n_events);
+        for (int j = 0; j < n_contour && !ret; j++) {
+            if (j > 0)
+                ret = fi_append_new_seg(&out_current, FI_SEG_LINE);
+            if (!ret)
+                out_current->meta->last->section.points[0] = contour[j];
+        }
+        if (!ret)
+            ret = fi_append_new_seg(&out_current, FI_SEG_END);
+    }
+    if (ret) {
+        fi_free_path(out_current);
+        return ret;
+    }
+    *out = out_current;
+    return 0;
 }
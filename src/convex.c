@@ -0,0 +1,318 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Convex operands. The intersection of two convex polygons is convex, its
+ * boundary alternates between chains of both boundaries: walking along them
+ * at once (O'Rourke, Chien, Olson and Naddor), always advancing the edge which
+ * points towards the other one, finds it in O(n + m). The walk does not
+ * handle boundaries touching at a corner or along an edge, it gives up and
+ * the sweep takes over.
+ */
+
+void fi_convex_step(FI_CONVEX_WALK *walk, FI_POINT_D pt) {
+    if (walk->n > 0 && pt.x == walk->cur.x && pt.y == walk->cur.y)
+        return;
+    if (walk->n < 2)
+        walk->first[walk->n] = pt;
+    if (walk->n >= 2) {
+        double area = fi_signed_area(walk->prev, walk->cur, pt);
+        int turn = (area > 0) - (area < 0);
+        double dot = (walk->cur.x - walk->prev.x) * (pt.x - walk->cur.x) +
+                     (walk->cur.y - walk->prev.y) * (pt.y - walk->cur.y);
+        // a spike turns back along the same line
+        if (turn == 0 && dot < 0)
+            walk->convex = false;
+        if (turn != 0 && walk->turn != 0 && turn != walk->turn)
+            walk->convex = false;
+        if (walk->turn == 0)
+            walk->turn = turn;
+    }
+    if (walk->n >= 1 && pt.x != walk->cur.x) {
+        int dir = pt.x > walk->cur.x ? 1 : -1;
+        if (walk->dir != 0 && dir != walk->dir)
+            walk->flips++;
+        walk->dir = dir;
+    }
+    walk->prev = walk->cur;
+    walk->cur = pt;
+    walk->n++;
+}
+
+bool fi_path_convex(FI_PATH *path) {
+    if (path == NULL)
+        return false;
+    FI_META *meta = path->meta;
+    if (path == meta->first && meta->convex_valid)
+        return meta->convex;
+
+    FI_CONVEX_WALK walk = {.convex = true};
+    int n_ring = 0;
+    for (FI_PATH *tmp = path; tmp != NULL && walk.convex; tmp = tmp->next) {
+        switch (tmp->section.type) {
+        case FI_SEG_END:
+            break;
+        case FI_SEG_MOVE:
+            walk.convex = ++n_ring == 1;
+            fi_convex_step(&walk, tmp->section.points[0]);
+            break;
+        case FI_SEG_LINE:
+            fi_convex_step(&walk, tmp->section.points[0]);
+            break;
+        default:
+            walk.convex = false;
+            break;
+        }
+    }
+    // the turns at the first point and the flips across it
+    bool convex = walk.convex && walk.n >= 3;
+    if (convex) {
+        fi_convex_step(&walk, walk.first[0]);
+        fi_convex_step(&walk, walk.first[1]);
+        convex = walk.convex && walk.turn != 0 && walk.flips <= 2;
+    }
+    if (path == meta->first) {
+        meta->convex = convex;
+        meta->convex_valid = true;
+    }
+    return convex;
+}
+
+size_t fi_convex_points(FI_PATH *path, FI_POINT_D **pts) {
+    FI_POINT_D *p = malloc((path->meta->n_total + 1) * sizeof(FI_POINT_D));
+    size_t n = 0;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_SEG_TYPE type = tmp->section.type;
+        if (type != FI_SEG_MOVE && type != FI_SEG_LINE)
+            continue;
+        // a point repeated or between collinear edges is no corner
+        FI_POINT_D pt = tmp->section.points[0];
+        while (n >= 2 && fi_signed_area(p[n - 2], p[n - 1], pt) == 0)
+            n--;
+        if (n == 1 && pt.x == p[0].x && pt.y == p[0].y)
+            continue;
+        p[n++] = pt;
+    }
+    // same around the first point
+    size_t s = 0;
+    while (n - s > 3) {
+        if (fi_signed_area(p[n - 2], p[n - 1], p[s]) == 0)
+            n--;
+        else if (fi_signed_area(p[n - 1], p[s], p[s + 1]) == 0)
+            s++;
+        else
+            break;
+    }
+    n -= s;
+    memmove(p, &p[s], n * sizeof(FI_POINT_D));
+
+    double area = 0;
+    for (size_t i = 0; i < n; i++)
+        area += fi_signed_area(p[0], p[i], p[(i + 1) % n]);
+    for (size_t i = 0; area < 0 && i < n / 2; i++) {
+        FI_POINT_D tmp = p[i];
+        p[i] = p[n - 1 - i];
+        p[n - 1 - i] = tmp;
+    }
+    *pts = p;
+    return n;
+}
+
+bool fi_path_rect(FI_PATH *path, FI_POINT_D *rect) {
+    FI_META *meta = path->meta;
+    FI_POINT_D pts[6];
+    int n = 0;
+    // a move, 3 or 4 lines and an end
+    if (path != meta->first || meta->n_move != 1 || meta->n_total > 6 ||
+        meta->n_line + 2 != meta->n_total)
+        return false;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        if (tmp->section.type == FI_SEG_END)
+            continue;
+        FI_POINT_D pt = tmp->section.points[0];
+        if (n == 0 || pt.x != pts[n - 1].x || pt.y != pts[n - 1].y)
+            pts[n++] = pt;
+    }
+    if (n == 5 && pts[4].x == pts[0].x && pts[4].y == pts[0].y)
+        n--;
+    if (n != 4)
+        return false;
+    bool h = pts[0].y == pts[1].y && pts[1].x == pts[2].x &&
+             pts[2].y == pts[3].y && pts[3].x == pts[0].x;
+    bool v = pts[0].x == pts[1].x && pts[1].y == pts[2].y &&
+             pts[2].x == pts[3].x && pts[3].y == pts[0].y;
+    if (!h && !v)
+        return false;
+    rect[0] = (FI_POINT_D){fmin(pts[0].x, pts[2].x), fmin(pts[0].y, pts[2].y)};
+    rect[1] = (FI_POINT_D){fmax(pts[0].x, pts[2].x), fmax(pts[0].y, pts[2].y)};
+    return rect[0].x < rect[1].x && rect[0].y < rect[1].y;
+}
+
+int fi_convex_contains(FI_POINT_D *p, size_t n, FI_POINT_D pt) {
+    int ret = 1;
+    for (size_t i = 0; i < n; i++) {
+        double area = fi_signed_area(p[i], p[(i + 1) % n], pt);
+        if (area < 0)
+            return -1;
+        if (area == 0)
+            ret = 0;
+    }
+    return ret;
+}
+
+void fi_convex_push(FI_POINT_D *out, size_t *n_out, FI_POINT_D pt) {
+    if (*n_out > 0 && out[*n_out - 1].x == pt.x && out[*n_out - 1].y == pt.y)
+        return;
+    out[(*n_out)++] = pt;
+}
+
+bool fi_convex_intersect(FI_POINT_D *p, size_t n, FI_POINT_D *q, size_t m,
+                         FI_POINT_D *out, size_t *n_out) {
+    FI_CONVEX_INFLAG inflag = FI_CONVEX_UNKNOWN;
+    size_t a = 0;
+    size_t b = 0;
+    size_t aa = 0;
+    size_t ba = 0;
+    bool first = true;
+
+    *n_out = 0;
+    do {
+        // edges a1 -> a of p and b1 -> b of q
+        size_t a1 = (a + n - 1) % n;
+        size_t b1 = (b + m - 1) % m;
+        double cross = (p[a].x - p[a1].x) * (q[b].y - q[b1].y) -
+                       (p[a].y - p[a1].y) * (q[b].x - q[b1].x);
+        double a_hb = fi_signed_area(q[b1], q[b], p[a]);
+        double b_ha = fi_signed_area(p[a1], p[a], q[b]);
+        double a1_hb = fi_signed_area(q[b1], q[b], p[a1]);
+        double b1_ha = fi_signed_area(p[a1], p[a], q[b1]);
+
+        FI_POINT_D box_a[2] = {{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+        FI_POINT_D box_b[2] = {{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+        fi_bbox_add(box_a, p[a1]);
+        fi_bbox_add(box_a, p[a]);
+        fi_bbox_add(box_b, q[b1]);
+        fi_bbox_add(box_b, q[b]);
+        bool meet = fi_bbox_overlap(box_a, box_b);
+        if (meet && (a_hb == 0 || b_ha == 0 || a1_hb == 0 || b1_ha == 0))
+            return false;
+
+        if (meet && (a1_hb < 0) != (a_hb < 0) && (b1_ha < 0) != (b_ha < 0)) {
+            double t = a1_hb / (a1_hb - a_hb);
+            FI_POINT_D pt = {p[a1].x + t * (p[a].x - p[a1].x),
+                             p[a1].y + t * (p[a].y - p[a1].y)};
+            // the walk is counted again from the first crossing
+            if (first) {
+                first = false;
+                aa = 0;
+                ba = 0;
+            }
+            fi_convex_push(out, n_out, pt);
+            if (a_hb > 0)
+                inflag = FI_CONVEX_P_IN;
+            else if (b_ha > 0)
+                inflag = FI_CONVEX_Q_IN;
+        }
+
+        bool advance_a;
+        if (cross == 0 && a_hb < 0 && b_ha < 0) {
+            // parallel edges facing away from each other
+            if (!first)
+                return false;
+            *n_out = 0;
+            return true;
+        } else if (cross == 0 && a_hb == 0 && b_ha == 0) {
+            return false;
+        } else if (cross >= 0) {
+            advance_a = b_ha > 0;
+        } else {
+            advance_a = !(a_hb > 0);
+        }
+        if (advance_a) {
+            if (inflag == FI_CONVEX_P_IN)
+                fi_convex_push(out, n_out, p[a]);
+            a = (a + 1) % n;
+            aa++;
+        } else {
+            if (inflag == FI_CONVEX_Q_IN)
+                fi_convex_push(out, n_out, q[b]);
+            b = (b + 1) % m;
+            ba++;
+        }
+    } while ((aa < n || ba < m) && aa < 2 * n && ba < 2 * m);
+
+    if (!first) {
+        // the walk went around both boundaries, back to the first crossing
+        if (aa < n || ba < m)
+            return false;
+        while (*n_out > 1 && out[*n_out - 1].x == out[0].x &&
+               out[*n_out - 1].y == out[0].y)
+            (*n_out)--;
+        return *n_out >= 3;
+    }
+
+    // the boundaries do not cross: a polygon with a corner inside the other
+    // one is within it, or they are apart
+    FI_POINT_D *polys[2] = {p, q};
+    size_t sizes[2] = {n, m};
+    for (int k = 0; k < 2; k++) {
+        int inside =
+            fi_convex_contains(polys[1 - k], sizes[1 - k], polys[k][0]);
+        if (inside == 0)
+            return false;
+        if (inside > 0) {
+            memcpy(out, polys[k], sizes[k] * sizeof(FI_POINT_D));
+            *n_out = sizes[k];
+            return true;
+        }
+    }
+    return true;
+}
+
+bool fi_clip_convex(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out,
+                    int *ret) {
+    FI_POINT_D rect[2];
+    *ret = 0;
+    if (ops != FI_AND)
+        return false;
+
+    // a rectangle clips any path
+    if (fi_path_rect(p2, rect)) {
+        *ret = fi_clip_rect(p1, rect, out);
+        return true;
+    }
+    if (fi_path_rect(p1, rect)) {
+        *ret = fi_clip_rect(p2, rect, out);
+        return true;
+    }
+    if (!fi_path_convex(p1) || !fi_path_convex(p2))
+        return false;
+
+    FI_POINT_D *p;
+    FI_POINT_D *q;
+    size_t n = fi_convex_points(p1, &p);
+    size_t m = fi_convex_points(p2, &q);
+    FI_POINT_D *pts = malloc((4 * (n + m) + 2) * sizeof(FI_POINT_D));
+    size_t rings[2] = {0, 0};
+    bool done = fi_convex_intersect(p, n, q, m, pts, &rings[1]);
+    if (done) {
+        *out = NULL;
+        *ret = fi_points_path(pts, rings, rings[1] > 0, out);
+    }
+    free(pts);
+    free(p);
+    free(q);
+    return done;
+}
@@ -1,83 +1,709 @@
-/* A little macro magic to compute a bezier curve point
- * This is the parametric form of the bezier curve
- *
- * P0 -> start point of the bezier curve
- * P1 -> first control point
- * P2 -> second control point
- * P3 -> end point of the bezier curve
- * c  -> coordinate (x or y)
- * t  -> parameter (must be in [0,1]
- */
-#define CUB_BEZIER_POINT(P0, P1, P2, P3, c, t)                                 \
-    P0.c *pow((1 - t), 3) + 3 * P1.c *t *pow((1 - t), 2) +                     \
-        3 * P2.c *pow(t, 2) * (1 - t) + P3.c *pow(t, 3)
-
-#define QUA_BEZIER_POINT(P0, P1, P2, c, t)                                     \
-    P0.c *pow((1 - t), 2) + 2 * t * (1 - t) * P1.c + pow(t, 2) * P2.c
-
 /* Resolution of the bezier curve transformation (number of segments used to
  * approximate the bezier curve)
  */
 #define BEZIER_RES 100
+
+/* Maximum number of segments used to approximate a bezier curve with a
+ * tolerance
+ */
+#define BEZIER_MAX_SEG 65536
 #define ARC_RES 100
 
+/* Maximum number of segments used to approximate an arc with a tolerance
+ */
+#define ARC_MAX_SEG 65536
+
 #define M_PI 3.14159265358979323846
 
+/* Relative distance under which two points are considered the same when
+ * computing intersections
+ */
+#define FI_EPSILON 1e-13
+
+/* Largest coordinate on the grid of a fixed-point clipping: the differences
+ * of 2 coordinates stay below 2^26 and the products of fi_signed_area() below
+ * 2^52, all exact in a double
+ */
+#define FI_FIXED_MAX 33554431.0
+
+/* Relative rounding error of a double, and the bounds of the errors of the
+ * orientation and incircle determinants computed with doubles (see
+ * predicates.c)
+ */
+#define FI_ROUNDOFF 0x1p-53
+#define FI_RESULT_ERRBOUND ((3.0 + 8.0 * FI_ROUNDOFF) * FI_ROUNDOFF)
+#define FI_CCW_ERRBOUND_A ((3.0 + 16.0 * FI_ROUNDOFF) * FI_ROUNDOFF)
+#define FI_CCW_ERRBOUND_B ((2.0 + 12.0 * FI_ROUNDOFF) * FI_ROUNDOFF)
+#define FI_CCW_ERRBOUND_C                                                      \
+    ((9.0 + 64.0 * FI_ROUNDOFF) * FI_ROUNDOFF * FI_ROUNDOFF)
+#define FI_ICC_ERRBOUND_A ((10.0 + 96.0 * FI_ROUNDOFF) * FI_ROUNDOFF)
+#define FI_ICC_ERRBOUND_B ((4.0 + 48.0 * FI_ROUNDOFF) * FI_ROUNDOFF)
+
+/* Maximum number of pairs of edges of 2 operands checked for a common point
+ * before a sweep (see fi_clip_separate())
+ */
+#define FI_SEPARATE_MAX_PAIRS 65536
+
+/* Maximum number of components of the factors of fi_expansion_product(), and
+ * of a term of the exact incircle determinant
+ */
+#define FI_EXPANSION_MAX 16
+#define FI_INCIRCLE_TERM_MAX (2 * FI_EXPANSION_MAX * FI_EXPANSION_MAX)
+
+/* Alignment and default size of the blocks of an arena
+ */
+#define FI_ARENA_ALIGN 16
+#define FI_ARENA_BLOCK_SIZE 16384
+
+/* Blocks of an arena double in size up to this size
+ */
+#define FI_ARENA_MAX_BLOCK_SIZE (1 << 20)
+
+/* Size of the first block of the arena of a path
+ */
+#define FI_PATH_ARENA_BLOCK_SIZE 1024
+
+/* Size of a segment and its n points in an arena
+ */
+#define FI_SEG_SIZE(n)                                                         \
+    ((sizeof(FI_PATH) + (n) * sizeof(FI_POINT_D) + FI_ARENA_ALIGN - 1) &       \
+     ~(size_t)(FI_ARENA_ALIGN - 1))
+
+/* Average number of edges per bucket of the index of a prepared clip path,
+ * and maximum number of bucket entries per edge
+ */
+#define FI_PREPARED_BUCKET_EDGES 4
+#define FI_PREPARED_MAX_ENTRIES 8
+
+/* Estimated number of characters per segment of path data, for the storage
+ * reserved by fi_parse_path()
+ */
+#define FI_PARSE_CHARS_PER_SEG 16
+
+/* Estimated number of segments of a curve linearized with a tolerance
+ */
+#define LINEARIZE_EST_SEG 16
+
+/* Significant digits kept when converting a decimal number, enough for a
+ * correctly rounded double
+ */
+#define FI_NUMBER_MAX_DIGITS 800
+
+/* Maximum length of a formatted number, and maximum precision of a writer
+ */
+#define FI_NUMBER_MAX_CHARS 340
+#define FI_WRITER_MAX_PRECISION 22
+
+/* Size of the buffer of fi_draw_path() and fi_draw_packed()
+ */
+#define FI_DRAW_BUFFER_SIZE 4096
+
+/* Size of the header of binary path data written by this version
+ */
+#define FI_BINARY_HEADER_SIZE 96
+
 // Degree to radian conversion ratio
 #define D2R M_PI / 180.0
 // Radian to degree conversion ratio
 #define R2D 180.0 / M_PI
 
-/* parameterize structure for defining an elliptic arc
+/* parameterize structure for defining an elliptic arc (angles in radians)
  */
 typedef struct _FI_PARAM_ARC {
     FI_POINT_D center;
     FI_POINT_D radius;
-    double phi;
+    double cos_phi;
+    double sin_phi;
     double angle_s;
     double angle_d;
 } FI_PARAM_ARC;
 
+/* block of an arena, the data follows the header
+ */
+typedef struct _FI_ARENA_BLOCK {
+    struct _FI_ARENA_BLOCK *next;
+    size_t size;
+    size_t used;
+} FI_ARENA_BLOCK;
+
+/* bump allocator, everything allocated is freed at once
+ */
+typedef struct _FI_ARENA {
+    FI_ARENA_BLOCK *head;
+    size_t block_size;
+} FI_ARENA;
+
 typedef enum {
     FI_SUBJECT,
     FI_CLIPPED,
 } FI_POLYGON_TYPE;
 
 typedef enum {
+    FI_NORMAL,
     FI_NON_CONTRIBUTIN,
     FI_SAME_TRANSITION,
     FI_DIFFERENT_TRANSITION,
 } FI_EDGETYPE;
 
+struct _FI_SWEEPEVENT;
+
+/* operands covering a region of an overlay, sorted (0 is the subject, i + 1
+ * the clip path i), NULL for none
+ */
+typedef struct _FI_LABELS {
+    size_t n;
+    size_t op[];
+} FI_LABELS;
+
+/* node of the sweep line status (red-black tree)
+ */
+typedef struct _FI_STATUS_NODE {
+    struct _FI_SWEEPEVENT *parent;
+    struct _FI_SWEEPEVENT *child[2];
+    bool red;
+    bool linked;
+} FI_STATUS_NODE;
+
+/* one endpoint of an edge, the edge itself is the pair (event, other)
+ *
+ * in_out -> the edge is an inside-outside transition of its own polygon
+ * inside -> the edge is inside the other polygon
+ * labels -> operands covering the region above the edge, in an overlay
+ * seg    -> input edge the edge is a part of, crossings are computed on it
+ * off_seg -> an end of the edge is a rounded crossing, off the input edge
+ */
 typedef struct _FI_SWEEPEVENT {
     FI_POINT_D point;
+    FI_POINT_D seg[2];
     FI_POLYGON_TYPE polygon_type;
     FI_EDGETYPE type;
     bool in_out;
     bool inside;
+    bool in_result;
     bool is_left_event;
+    bool off_seg;
+    int contour_id;
+    int pos;
     struct _FI_SWEEPEVENT *other;
-    struct _FI_SWEEPEVENT *next;
-    struct _FI_SWEEPEVENT *prev;
+    FI_LABELS *labels;
+    FI_STATUS_NODE node;
 } FI_SWEEPEVENT;
 
+/* event queue, an array backed 4-ary min-heap of events
+ */
+typedef struct _FI_EVENT_QUEUE {
+    FI_SWEEPEVENT **heap;
+    size_t n;
+    size_t size;
+} FI_EVENT_QUEUE;
+
+/* state of a plane sweep
+ *
+ * events    -> storage of all the events
+ * queue     -> events not processed yet
+ * processed -> events already processed, in processing order
+ * current   -> event being processed
+ * status    -> root of the tree of the edges crossing the sweep line
+ * requeue   -> an edge was split at the point of the current left event
+ * fixed_clip -> the in_out fields of the clip edges are precomputed
+ * operand   -> operand of each contour of an overlay (NULL otherwise), the
+ *              edges get labels instead of in_out/inside
+ */
+typedef struct _FI_SWEEP_STATE {
+    FI_OPS ops;
+    FI_ARENA events;
+    FI_EVENT_QUEUE queue;
+    FI_SWEEPEVENT **processed;
+    size_t n_processed;
+    size_t s_processed;
+    FI_SWEEPEVENT *current;
+    FI_SWEEPEVENT *status;
+    size_t n_status;
+    int n_contour;
+    bool requeue;
+    bool fixed_clip;
+    size_t *operand;
+} FI_SWEEP_STATE;
+
+/* edge of a prepared clip path, s is its left point
+ */
+typedef struct _FI_PREPARED_EDGE {
+    FI_POINT_D s;
+    FI_POINT_D e;
+    int contour_id;
+    bool in_out;
+} FI_PREPARED_EDGE;
+
+/* clip path prepared for many clippings
+ *
+ * path     -> linearized copy of the clip path
+ * edges    -> edges split at the self intersections, in event order
+ * bbox     -> bounding box of the path
+ * x0, w    -> start and width of the x buckets
+ * bucket   -> n_bucket + 1 offsets in index
+ * index    -> edges overlapping each bucket
+ */
+struct _FI_PREPARED {
+    FI_PATH *path;
+    FI_PREPARED_EDGE *edges;
+    size_t n_edge;
+    int n_contour;
+    FI_POINT_D bbox[2];
+    double x0;
+    double w;
+    size_t n_bucket;
+    size_t *bucket;
+    size_t *index;
+};
+
+/* segments in SoA layout, for the segment intersection kernel
+ *
+ * x1, y1 -> first endpoints
+ * x2, y2 -> second endpoints
+ * n      -> number of segments
+ * size   -> size of the arrays
+ */
+typedef struct _FI_SEGMENTS {
+    double *x1;
+    double *y1;
+    double *x2;
+    double *y2;
+    size_t n;
+    size_t size;
+} FI_SEGMENTS;
+
+/* operand of an N-ary clipping, or result of a level of its reduction
+ *
+ * path  -> the path
+ * owned -> the path is an intermediate result, freed after its use
+ * index -> position of the operand
+ * key   -> Z-order of the center of its box
+ */
+typedef struct _FI_MANY_ITEM {
+    FI_PATH *path;
+    bool owned;
+    size_t index;
+    uint32_t key;
+} FI_MANY_ITEM;
+
+/* side of an edge of an overlay bounding a face, labels are the operands
+ * covering the face
+ */
+typedef struct _FI_OVERLAY_EDGE {
+    FI_LABELS *labels;
+    FI_SWEEPEVENT *left;
+} FI_OVERLAY_EDGE;
+
+/* subpath (M ... Z) of an operand of a clipping
+ *
+ * first    -> its move segment
+ * end      -> segment after its end segment (NULL for the last one)
+ * isolated -> its box meets no box of another ring
+ * cross    -> its box meets the box of a ring of the other operand
+ */
+typedef struct _FI_RING {
+    FI_PATH *first;
+    FI_PATH *end;
+    FI_POINT_D bbox[2];
+    FI_POLYGON_TYPE type;
+    bool isolated;
+    bool cross;
+} FI_RING;
+
+/* part of a ring inside a clip rectangle, between 2 points of its border
+ *
+ * first -> index of its first point in chain_pts
+ * cross -> index of the crossings of its first and last points, once sorted
+ */
+typedef struct _FI_RECT_CHAIN {
+    size_t first;
+    size_t n;
+    size_t cross[2];
+} FI_RECT_CHAIN;
+
+/* end of a chain, t is its position along the border of the rectangle
+ */
+typedef struct _FI_RECT_CROSS {
+    double t;
+    size_t chain;
+    bool last;
+} FI_RECT_CROSS;
+
+/* state of the clipping of a path to a rectangle
+ *
+ * pts, rings     -> points of the subject, ring r is [rings[r], rings[r + 1])
+ * codes          -> side of the rectangle of each point (0 inside)
+ * chain_pts      -> points of the chains, the current one from chain_first
+ * out, out_rings -> points of the loops of the result, the current one from
+ *                   out_first
+ */
+typedef struct _FI_RECT_STATE {
+    FI_POINT_D rect[2];
+    FI_POINT_D *pts;
+    size_t n_pts;
+    size_t s_pts;
+    size_t *rings;
+    size_t n_ring;
+    size_t s_rings;
+    unsigned char *codes;
+    FI_POINT_D *chain_pts;
+    size_t n_chain_pts;
+    size_t s_chain_pts;
+    size_t chain_first;
+    FI_RECT_CHAIN *chains;
+    size_t n_chain;
+    size_t s_chains;
+    FI_RECT_CROSS *cross;
+    size_t n_cross;
+    size_t s_cross;
+    FI_POINT_D *out;
+    size_t n_out;
+    size_t s_out;
+    size_t out_first;
+    size_t *out_rings;
+    size_t n_out_ring;
+    size_t s_out_rings;
+} FI_RECT_STATE;
+
+/* walk along the corners of a ring to find if it is convex
+ *
+ * first -> first 2 points, walked again to close the ring
+ * prev, cur -> last 2 points
+ * turn -> sign of the turns, 0 until the first one
+ * dir -> direction along x of the last edge not vertical
+ * flips -> changes of dir, 2 for a ring going around once
+ */
+typedef struct _FI_CONVEX_WALK {
+    FI_POINT_D first[2];
+    FI_POINT_D prev;
+    FI_POINT_D cur;
+    size_t n;
+    int turn;
+    int dir;
+    int flips;
+    bool convex;
+} FI_CONVEX_WALK;
+
+/* where the intersection of convex polygons is on the boundaries
+ */
+typedef enum {
+    FI_CONVEX_UNKNOWN,
+    FI_CONVEX_P_IN,
+    FI_CONVEX_Q_IN,
+} FI_CONVEX_INFLAG;
+
+/* what a clipping does with a ring
+ */
+typedef enum {
+    FI_RING_SWEEP, /* part of the sweep */
+    FI_RING_COPY,  /* copied to the result as is */
+    FI_RING_DROP,  /* no part of the result */
+} FI_RING_ACTION;
+
+/* unnormalized floating point number f * 2^e, for the shortest formatting
+ */
+typedef struct _FI_DIYFP {
+    uint64_t f;
+    int e;
+} FI_DIYFP;
+
+/* power of ten 10^k ~= f * 2^e, f normalized
+ */
+typedef struct _FI_CACHED_POWER {
+    uint64_t f;
+    int e;
+    int k;
+} FI_CACHED_POWER;
+
+/* state of the path data parser
+ */
+typedef struct _FI_PARSE_STATE {
+    FI_PATH *path;    /* output path (without callback) */
+    FI_PARSER_CB cb;  /* called for each segment */
+    void *data;       /* user data of cb */
+    char cmd;         /* current command */
+    char prev;        /* command of the last segment (upper case) */
+    bool pending;     /* command read, no segment emitted yet */
+    int n_arg;        /* arguments of the current command read so far */
+    double arg[7];    /* arguments of the current command */
+    FI_POINT_D cur;   /* current point */
+    FI_POINT_D start; /* start of the current subpath */
+    FI_POINT_D ctrl;  /* last control point, reflected by S and T */
+    size_t reserve;   /* segments reserved with the first one */
+} FI_PARSE_STATE;
+
+/* push parser, the characters of a number which may continue in the next
+ * chunk are kept in tok
+ */
+struct _FI_PARSER {
+    FI_PARSE_STATE st;
+    char *tok;
+    size_t n_tok;
+    size_t s_tok;
+    int err;
+};
+
 /* Convert elliptic arc from the endpoints to center parameterization
  */
 FI_PARAM_ARC fi_arc_endpoint_to_center(FI_POINT_D s, FI_POINT_D e, FI_POINT_D r,
                                        double phi, FI_SEG_FLAG flag);
 
-/* Convert elliptic arc to a series of segments
+/* Flatten an elliptic arc, the points to append as lines are written in buf
+ * (grown if needed), returns their number. tolerance is the maximum distance
+ * between the arc and its chords (<= 0 -> ARC_RES segments, start point
+ * included)
+ */
+int fi_arc_flatten(FI_POINT_D ref, FI_POINT_D *in, FI_SEG_FLAG flag,
+                   double tolerance, FI_POINT_D **buf, int *s_buf);
+
+/* number of segments needed to flatten an arc within tolerance
+ */
+int fi_arc_n_seg(FI_PARAM_ARC *param, double tolerance);
+
+/* points of an arc for angle_s + i / n * angle_d, i from first to n, written
+ * from out[0]
+ */
+void fi_arc_param_points(FI_PARAM_ARC *param, int n, int first,
+                         FI_POINT_D *out);
+
+/* Flatten a quadratic (degree 2) or cubic (degree 3) bezier curve, the points
+ * to append as lines are written in buf (grown if needed), returns their
+ * number. tolerance is the maximum distance between the curve and its chords
+ * (<= 0 -> BEZIER_RES segments, start point included)
+ */
+int fi_bezier_flatten(FI_POINT_D ref, FI_POINT_D *in, int degree,
+                      double tolerance, FI_POINT_D **buf, int *s_buf);
+
+/* number of segments needed to flatten the bezier curve of degree degree and
+ * control points p within tolerance (Wang's formula)
+ */
+int fi_bezier_n_seg(FI_POINT_D *p, int degree, double tolerance);
+
+/* powers of ten exactly representable as doubles, 1e0 to 1e22
+ */
+extern const double fi_pow10[];
+
+/* number of arguments of a path command, -1 if c is not a command
+ */
+int fi_cmd_arity(char c);
+
+/* type of the segments created by a path command
+ */
+FI_SEG_TYPE fi_cmd_type(char c);
+
+/* convert the number at in[*pos], *pos is moved after it
+ */
+int fi_parse_number(const char *in, size_t s_in, size_t *pos, double *out);
+
+/* correctly rounded conversion of the number at in[start] with strtod()
+ */
+double fi_parse_number_slow(const char *in, size_t s_in, size_t start);
+
+/* exponent of a number at in[*pos], *pos is moved after it
+ */
+int fi_parse_exponent(const char *in, size_t s_in, size_t *pos);
+
+bool fi_parse_is_separator(char c);
+
+/* characters which can be part of a number
+ */
+bool fi_parse_is_number(char c);
+
+/* parse a buffer where no number is cut
+ */
+int fi_parse_chunk(FI_PARSE_STATE *st, const char *in, size_t s_in);
+
+/* pass a segment to the callback or append it to the path
+ */
+int fi_parse_emit(FI_PARSE_STATE *st, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                  FI_POINT_D *pt);
+
+void fi_parse_init(FI_PARSE_STATE *st);
+
+/* complete the current command, missing arguments being 0 (a command
+ * without arguments gives a segment of 0 points)
+ */
+int fi_parse_flush(FI_PARSE_STATE *st);
+
+/* start a new command
+ */
+int fi_parse_command(FI_PARSE_STATE *st, char c);
+
+/* add an argument to the current command, the segment is emitted when all
+ * the arguments are read
+ */
+int fi_parse_argument(FI_PARSE_STATE *st, double v);
+
+/* add a segment of type type to the counters of meta
+ */
+void fi_meta_count(FI_META *meta, FI_SEG_TYPE type);
+
+/* append a segment with the points pt at the end of the path of meta, without
+ * checking n_max
+ */
+FI_PATH *fi_push_seg(FI_META *meta, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                     FI_POINT_D *pt);
+
+/* size of the segments of a path in an arena
+ */
+size_t fi_meta_size(FI_META *meta);
+
+/* append copies of the segments [in, end) to a path
+ */
+void fi_append_copy(FI_PATH *in, FI_PATH *end, FI_PATH **out);
+
+/* linear path with a ring for each range [rings[r], rings[r + 1]) of pts
+ */
+int fi_points_path(FI_POINT_D *pts, size_t *rings, size_t n_ring,
+                   FI_PATH **out);
+
+/* room for size bytes of segments in the arena of a path, the segments
+ * allocated one by one are moved to the arena
+ */
+void fi_meta_reserve(FI_META *meta, size_t size);
+
+/* number of segments (estimated with a tolerance) of a linearized path
+ */
+size_t fi_linearize_n_seg(FI_META *meta, double tolerance);
+
+/* append a line segment for each point
+ */
+void fi_append_lines(FI_POINT_D *pts, int n, FI_PATH **out);
+
+/* points of a cubic bezier curve for t = i / n, i from first to n, written
+ * from out[0]
+ */
+void fi_cub_bezier_points(FI_POINT_D ref, FI_POINT_D *in, int n, int first,
+                          FI_POINT_D *out);
+
+/* points of a quadratic bezier curve for t = i / n, i from first to n, written
+ * from out[0]
+ */
+void fi_qua_bezier_points(FI_POINT_D ref, FI_POINT_D *in, int n, int first,
+                          FI_POINT_D *out);
+
+/* points for t = i / n, i from first to n, of the polynomial
+ * ((a * t + b) * t + c) * t + d, written from out[0]
+ */
+void fi_horner_points(FI_POINT_D a, FI_POINT_D b, FI_POINT_D c, FI_POINT_D d,
+                      int n, int first, FI_POINT_D *out);
+
+/* number of points of a segment type
+ */
+int fi_seg_n_point(FI_SEG_TYPE type);
+
+/* offset the points of one segment
+ */
+void fi_offset_seg(FI_SEG_TYPE type, FI_POINT_D *points, FI_POINT_D pt);
+
+/* format a number with precision digits after the point (at most 22), same
+ * text as printf("%.*f"), returns the length
+ */
+int fi_format_fixed(double v, int precision, char *out);
+
+/* normalized powers of ten 10^-348 to 10^340, every 8th power
+ */
+extern const FI_CACHED_POWER fi_cached_powers[];
+
+/* product of 2 numbers, rounded to 64 bits
+ */
+FI_DIYFP fi_diyfp_mul(FI_DIYFP a, FI_DIYFP b);
+
+/* same number with the high bit of f set (f != 0)
+ */
+FI_DIYFP fi_diyfp_normalize(FI_DIYFP a);
+
+/* round the last digit of buf towards w, false if the digits are not sure to
+ * be the closest shortest ones (Grisu3)
+ */
+bool fi_grisu_round_weed(char *buf, int len, uint64_t distance_too_high_w,
+                         uint64_t unsafe_interval, uint64_t rest,
+                         uint64_t ten_kappa, uint64_t unit);
+
+/* shortest digits of w between the scaled bounds low and high, kappa the
+ * power of ten of the last digit, false if they are unsure (Grisu3)
+ */
+bool fi_grisu_digits(FI_DIYFP low, FI_DIYFP w, FI_DIYFP high, char *buf,
+                     int *len, int *kappa);
+
+/* shortest digits of v (finite, > 0), v = digits * 10^exponent; false for the
+ * few numbers Grisu3 cannot prove the digits of
+ */
+bool fi_grisu3(double v, char *buf, int *len, int *exponent);
+
+/* text of digits * 10^exponent, in fixed or scientific notation whichever is
+ * shorter, returns the length
+ */
+int fi_format_digits(const char *digits, int n, int exponent, bool negative,
+                     char *out);
+
+/* shortest representation of a number which reads back exactly, returns the
+ * length
+ */
+int fi_format_shortest(double v, char *out);
+
+/* room for n more characters in the buffer of a writer
+ */
+int fi_writer_reserve(FI_WRITER *w, size_t n);
+
+void fi_writer_append(FI_WRITER *w, const char *str, size_t n);
+
+/* write a number followed by sep, relative to *ref if ref is not NULL (*ref
+ * is then updated to the value read back)
+ */
+void fi_write_number(FI_WRITER *w, double v, double *ref, char sep);
+
+void fi_write_point(FI_WRITER *w, FI_POINT_D pt, bool relative);
+
+/* allocate a packed path able to hold exactly n_seg segments, n_point points
+ * and n_subpath subpaths
+ */
+FI_PACKED_PATH *fi_new_packed(size_t n_seg, size_t n_point, size_t n_subpath);
+
+/* grow an array to hold at least n elements of size elem
+ */
+void *fi_packed_grow(void *array, size_t *size, size_t n, size_t elem);
+
+/* copy borrowed arrays of a packed path so that they can be grown
+ */
+void fi_packed_own(FI_PACKED_PATH *path);
+
+bool fi_host_little_endian(void);
+
+/* little-endian values of binary path data
+ */
+uint64_t fi_le_get_u64(const unsigned char *p);
+void fi_le_put_u64(unsigned char *p, uint64_t v);
+uint32_t fi_le_get_u32(const unsigned char *p);
+void fi_le_put_u32(unsigned char *p, uint32_t v);
+double fi_le_get_f64(const unsigned char *p);
+void fi_le_put_f64(unsigned char *p, double v);
+
+/* binary data at data can be used in place (little-endian host, 64 bits
+ * size_t and aligned data)
+ */
+bool fi_binary_in_place(const void *data);
+
+/* header of the binary data of a packed path (counts and bbox)
  */
-void fi_arc_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_SEG_FLAG flag,
-                     FI_PATH **out);
+void fi_binary_header(FI_PACKED_PATH *in, FI_BINARY_HEADER *hdr);
 
-/* Convert a cubic bezier curve to a series of segments
+/* encode a header at p (FI_BINARY_HEADER_SIZE bytes)
  */
-void fi_cub_bezier_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_PATH **out);
+void fi_binary_put_header(unsigned char *p, FI_BINARY_HEADER *hdr);
 
-/* Convert a quadratic bezier curve to a series of segments
+/* check the segment types and subpaths of binary data against its header
  */
-void fi_qua_bezier_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_PATH **out);
+int fi_binary_check(FI_BINARY_HEADER *hdr, const unsigned char *types,
+                    const unsigned char *subpaths);
+
+/* release the mapping of a file of binary path data
+ */
+void fi_binary_unmap(void *map, size_t size);
+
+/* free one segment of a path (its points may be borrowed from a packed path)
+ */
+void fi_free_seg(FI_META *meta, FI_PATH *seg);
 
 /* Replace the first point of old with the new segment
  */
@@ -114,12 +740,665 @@ void fi_sort_path(FI_PATH **table_path_in, size_t table_len, FI_PATH ***out,
  */
 int fi_validate_path(FI_PATH *path);
 
+/* initialize an arena (block_size 0 -> FI_ARENA_BLOCK_SIZE)
+ */
+void fi_arena_init(FI_ARENA *arena, size_t block_size);
+
+/* allocate zeroed memory from an arena
+ */
+void *fi_arena_alloc(FI_ARENA *arena, size_t size);
+
+/* room for size bytes in the current block of an arena
+ */
+void fi_arena_reserve(FI_ARENA *arena, size_t size);
+
+/* release everything allocated from an arena, but keep a block for reuse
+ */
+void fi_arena_reset(FI_ARENA *arena);
+
+/* free all the blocks of an arena
+ */
+void fi_arena_free(FI_ARENA *arena);
+
+/* move all the blocks of src to dst, src is left empty
+ */
+void fi_arena_merge(FI_ARENA *dst, FI_ARENA *src);
+
+/* compare 2 points, first by x then by y
+ */
+int fi_compare_point(FI_POINT_D p1, FI_POINT_D p2);
+
+/* result of a clipping when p1 or p2 is NULL
+ */
+int fi_clip_empty(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
+
+/* clip with the buffers of sweep, which are kept for the next call
+ */
+int fi_clip_with(FI_SWEEP_STATE *sweep, FI_PATH *p1, FI_PATH *p2, FI_OPS ops,
+                 FI_PATH **out);
+
+/* new event allocated from the arena of a sweep
+ */
+FI_SWEEPEVENT *fi_new_event(FI_SWEEP_STATE *sweep, FI_POINT_D pt, bool left,
+                            FI_SWEEPEVENT *other, FI_POLYGON_TYPE type,
+                            int contour_id);
+
+/* extend a box to a point
+ */
+void fi_bbox_add(FI_POINT_D *bbox, FI_POINT_D pt);
+
+/* extend a box to a segment, ref is the end of the previous one
+ */
+void fi_bbox_add_seg(FI_POINT_D *bbox, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                     FI_POINT_D ref, FI_POINT_D *pt);
+
+/* the 2 closed boxes meet
+ */
+bool fi_bbox_overlap(FI_POINT_D *a, FI_POINT_D *b);
+
+/* edge [s, e] meets the closed box
+ */
+bool fi_edge_hits_box(FI_POINT_D s, FI_POINT_D e, FI_POINT_D *box);
+
+/* an edge of a linear path meets the closed box
+ */
+bool fi_path_hits_box(FI_PATH *path, FI_POINT_D *box);
+
+/* pt is inside a linear path (even-odd rule), pt must not be on an edge
+ */
+bool fi_point_in_path(FI_POINT_D pt, FI_PATH *path);
+
+/* copies of p1 and p2 one after the other in a new path
+ */
+void fi_concat_copy(FI_PATH *p1, FI_PATH *p2, FI_PATH **out);
+
+/* result of a clipping when p1 and p2 have no common point, returns true
+ */
+bool fi_clip_apart(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
+
+/* result of a clipping when the boxes of p1 and p2 are disjoint, false if they
+ * are not (out is then left as is)
+ */
+bool fi_clip_disjoint(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
+
+/* result of a clipping of linear paths when no edge of one of them meets the
+ * box of the other, false otherwise
+ */
+bool fi_clip_contained(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
+
+/* add the next point of a ring to a convexity walk, repeated points are
+ * skipped
+ */
+void fi_convex_step(FI_CONVEX_WALK *walk, FI_POINT_D pt);
+
+/* distinct corners of a convex path, counterclockwise and without collinear
+ * ones, returns their number (pts is allocated)
+ */
+size_t fi_convex_points(FI_PATH *path, FI_POINT_D **pts);
+
+/* the linear path is an axis-aligned rectangle, from rect[0] to rect[1]
+ */
+bool fi_path_rect(FI_PATH *path, FI_POINT_D *rect);
+
+/* convex polygon p contains pt, 1 inside, -1 outside and 0 on its border
+ */
+int fi_convex_contains(FI_POINT_D *p, size_t n, FI_POINT_D pt);
+
+/* append a point to a polygon unless it repeats the last one
+ */
+void fi_convex_push(FI_POINT_D *out, size_t *n_out, FI_POINT_D pt);
+
+/* intersection of convex polygons p and q (counterclockwise) walking along
+ * both boundaries; false if an edge or corner of one touches the other, out
+ * has room for 4 * (n + m) + 2 points
+ */
+bool fi_convex_intersect(FI_POINT_D *p, size_t n, FI_POINT_D *q, size_t m,
+                         FI_POINT_D *out, size_t *n_out);
+
+/* copy of a linear path snapped to the grid of a scale (NULL for NULL),
+ * ERR_FIXED_RANGE if a point is out of it
+ */
+int fi_fixed_path(FI_PATH *in, double scale, FI_PATH **out);
+
+/* points of a path on the grid back to the coordinates of a scale
+ */
+void fi_fixed_unscale(FI_PATH *path, double scale);
+
+/* compare 2 points, for qsort()
+ */
+int fi_compare_point_p(const void *in_1, const void *in_2);
+
+/* centers of the hot pixels of 2 paths on the grid, the vertices and the
+ * rounded crossings of their edges, sorted and unique (out to be freed)
+ */
+size_t fi_fixed_hot_pixels(FI_PATH *p1, FI_PATH *p2, FI_POINT_D **out);
+
+/* centers of the hot pixels (sorted) the edge s -> e goes through, from the
+ * one of s to the one of e, in buf of size s_buf (grown if needed)
+ */
+int fi_fixed_snap_edge(FI_POINT_D s, FI_POINT_D e, FI_POINT_D *pixels,
+                       size_t n_pixel, FI_POINT_D **buf, int *s_buf);
+
+/* copy of a linear path on the grid with every edge replaced by the path
+ * through its hot pixels
+ */
+void fi_fixed_snap(FI_PATH *in, FI_POINT_D *pixels, size_t n_pixel,
+                   FI_PATH **out);
+
+/* a + b rounded, its rounding error in err
+ */
+double fi_two_sum(double a, double b, double *err);
+
+/* rounding error of d = a - b
+ */
+double fi_two_diff_tail(double a, double b, double d);
+
+/* a * b rounded, its rounding error in err
+ */
+double fi_two_product(double a, double b, double *err);
+
+/* a * b - c * d exactly, as an expansion of 4 components (some may be 0)
+ */
+void fi_diff_product(double a, double b, double c, double d, double *x);
+
+/* sum of 2 expansions, h has room for elen + flen components, returns the
+ * length of h (zero components are dropped)
+ */
+int fi_expansion_sum(int elen, const double *e, int flen, const double *f,
+                     double *h);
+
+/* expansion times a double, h has room for 2 * elen components
+ */
+int fi_scale_expansion(int elen, const double *e, double b, double *h);
+
+/* product of 2 expansions of at most FI_EXPANSION_MAX components, h has room
+ * for 2 * elen * flen components
+ */
+int fi_expansion_product(int elen, const double *e, int flen, const double *f,
+                         double *h);
+
+/* approximate value of an expansion
+ */
+double fi_estimate(int elen, const double *e);
+
+/* fi_orient2d() when the error bound of the double computation fails, detsum
+ * is the sum of the magnitudes of its 2 products
+ */
+double fi_orient2d_adapt(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc,
+                         double detsum);
+
+/* one term (bx * cy - cx * by) * (ax^2 + ay^2) of the incircle determinant,
+ * with coordinates given as expansions of n components (n <= 2), returns the
+ * length of out (FI_INCIRCLE_TERM_MAX at most)
+ */
+int fi_lift_term(double *ax, double *ay, double *bx, double *by, double *cx,
+                 double *cy, int n, double *out);
+
+/* incircle determinant exactly, computed from the rounded differences to pd
+ * (n = 1, exact if they are) or from the differences and their rounding
+ * errors (n = 2)
+ */
+double fi_incircle_exact(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc,
+                         FI_POINT_D pd, int n);
+
+/* u[0] * v[1] - u[1] * v[0] exactly, with coordinates given as expansions
+ * of 2 components, returns the length of out (16 at most)
+ */
+int fi_cross_expansion(double u[2][2], double v[2][2], double *out);
+
+/* sign of n / d - (q + h) for expansions n and d (d not 0), |h| below the
+ * precision of q
+ */
+int fi_quotient_side(int nlen, const double *n, int dlen, const double *d,
+                     double q, double h);
+
+/* e as the sum of head (returned) and tail, within 4 * elen^2 * eps^2 of e
+ */
+double fi_estimate_tail(int elen, const double *e, double *tail);
+
+/* crossing of the lines (a1, a2) and (b1, b2), each coordinate rounded to the
+ * nearest double: the same point whatever the pair of lines through it, false
+ * if the lines are parallel
+ */
+bool fi_line_crossing(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                      FI_POINT_D b2, FI_POINT_D *out);
+
+/* grow the arrays of segments to hold at least n segments
+ */
+void fi_segments_reserve(FI_SEGMENTS *segs, size_t n);
+
+/* add the segment [s, e]
+ */
+void fi_segments_add(FI_SEGMENTS *segs, FI_POINT_D s, FI_POINT_D e);
+
+/* edges of a linear path as pairs of points, edges has room for one per line
+ * and end segment, returns their number
+ */
+size_t fi_path_edges(FI_PATH *path, FI_POINT_D *edges);
+
+/* order of 2 edges (pairs of points) by their minimum x
+ */
+int fi_compare_edges_p(const void *in_1, const void *in_2);
+
+/* add the edges of a linear path, sorted by their minimum x
+ */
+void fi_segments_path(FI_PATH *path, FI_SEGMENTS *segs);
+
+/* number of the (sorted) segments whose minimum x is at most x
+ */
+size_t fi_segments_before(FI_SEGMENTS *segs, double x);
+
+/* free the arrays of segments
+ */
+void fi_free_segments(FI_SEGMENTS *segs);
+
+/* filter of fi_segments_hit() for one segment [b1, b2]
+ */
+bool fi_segment_hit(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1, FI_POINT_D b2,
+                    double *t);
+
+/* test [a1, a2] against n <= 64 segments from first: bit i of the mask is set
+ * if segment first + i may meet it (it is set for all those which do), and
+ * t[i] is then the position of the crossing on [a1, a2] (0 at a1, 1 at a2),
+ * meaningful if they cross at a single point
+ */
+uint64_t fi_segments_hit(FI_SEGMENTS *segs, size_t first, size_t n,
+                         FI_POINT_D a1, FI_POINT_D a2, double *t);
+
+/* the closed segments [a1, a2] and [b1, b2] have a common point (exact)
+ */
+bool fi_segments_meet(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                      FI_POINT_D b2);
+
+/* one of the (sorted) segments meets [a1, a2]
+ */
+bool fi_segments_meet_any(FI_SEGMENTS *segs, FI_POINT_D a1, FI_POINT_D a2);
+
+/* an edge of a linear path meets an edge of another one
+ */
+bool fi_boundaries_meet(FI_PATH *p1, FI_PATH *p2);
+
+/* a ring of the operand type, entirely inside or outside of the other
+ * operand, is part of the boundary of the result
+ */
+bool fi_ring_kept(FI_OPS ops, FI_POLYGON_TYPE type, bool inside);
+
+/* result of a clipping of linear paths when their edges have no common point,
+ * false if they have one or if they have too many edges to check it (out is
+ * then left as is)
+ */
+bool fi_clip_separate(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out);
+
+/* AND of linear paths in linear time when one of them is an axis-aligned
+ * rectangle or both are convex, false otherwise (out is then left as is)
+ */
+bool fi_clip_convex(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out,
+                    int *ret);
+
+/* rings of a linear path with their boxes, returns their number
+ */
+size_t fi_path_rings(FI_PATH *path, FI_POLYGON_TYPE type, FI_RING *rings);
+
+/* order of 2 rings (pointers) by the left side of their boxes
+ */
+int fi_compare_rings_p(const void *in_1, const void *in_2);
+
+/* set the isolated and cross fields of rings from their boxes
+ */
+void fi_rings_overlap(FI_RING *rings, size_t n);
+
+/* what a clipping with ops does with a ring
+ */
+FI_RING_ACTION fi_ring_action(FI_RING *ring, FI_OPS ops);
+
+/* sweep the rings of linear paths which can be part of the result, and copy
+ * the isolated ones
+ */
+int fi_clip_rings(FI_SWEEP_STATE *sweep, FI_PATH *subject, FI_PATH *clip,
+                  FI_PATH **out);
+
+/* bucket of the index of a prepared clip path containing x
+ */
+size_t fi_prepared_bucket(FI_PREPARED *prepared, double x);
+
+/* number of bucket entries of the edges of a prepared clip path, added to
+ * count[b + 1] for each bucket b if count is not NULL
+ */
+size_t fi_prepared_count(FI_PREPARED *prepared, size_t *count);
+
+/* build the x bucket index of a prepared clip path
+ */
+void fi_prepared_index(FI_PREPARED *prepared);
+
+/* insert the events of the edges of a prepared clip path overlapping
+ * [xmin, xmax] in x
+ */
+void fi_insert_prepared(FI_SWEEP_STATE *sweep, FI_PREPARED *prepared,
+                        double xmin, double xmax);
+
+void fi_insert_prepared_edge(FI_SWEEP_STATE *sweep, FI_PREPARED_EDGE *edge,
+                             int contour_offset);
+
+/* state of a batch of clippings and its queues of jobs, defined with the
+ * thread types in batch.c
+ */
+typedef struct _FI_BATCH FI_BATCH;
+typedef struct _FI_BATCH_QUEUE FI_BATCH_QUEUE;
+
+/* take the first job of a queue, false if it is empty
+ */
+bool fi_batch_pop(FI_BATCH_QUEUE *queue, size_t *job);
+
+/* move half of the jobs of another thread to the queue of thread id, false if
+ * there are no jobs left
+ */
+bool fi_batch_steal(FI_BATCH *batch, int id);
+
+/* run jobs for one thread until there are none left
+ */
+void fi_batch_run(FI_BATCH *batch, int id);
+
+/* entry point of the threads of a batch (arg is their FI_BATCH_WORKER)
+ */
+void *fi_batch_thread(void *arg);
+
+/* Z-order of a point in a box, 16 bits per axis
+ */
+uint32_t fi_morton(FI_POINT_D pt, FI_POINT_D *box);
+
+/* order of 2 FI_MANY_ITEM by key, then by index
+ */
+int fi_compare_many_p(const void *in_1, const void *in_2);
+
+/* operands of an N-ary clipping sorted along the Z-order of their boxes
+ */
+void fi_many_order(FI_PATH **paths, size_t n, FI_MANY_ITEM *items);
+
+/* free the owned paths of n operands
+ */
+void fi_many_free(FI_MANY_ITEM *items, size_t n);
+
+/* clip the n operands together level by level with fi_clip_batch(), the
+ * owned paths are freed
+ */
+int fi_many_reduce(FI_MANY_ITEM *items, size_t n, FI_OPS ops, int n_thread,
+                   FI_PATH **out);
+
+/* labels with operand op added, or removed if it is already there
+ */
+FI_LABELS *fi_labels_toggle(FI_ARENA *arena, FI_LABELS *labels, size_t op);
+
+/* order of 2 sets of labels, element by element then by size
+ */
+int fi_compare_labels(FI_LABELS *l1, FI_LABELS *l2);
+
+/* order of 2 FI_OVERLAY_EDGE by labels, then by endpoints
+ */
+int fi_compare_overlay_edges_p(const void *in_1, const void *in_2);
+
+/* labels of an edge of an overlay from the edge below it
+ */
+FI_LABELS *fi_overlay_above(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                            FI_SWEEPEVENT *prev);
+
+/* compute the labels of an edge of an overlay from the edge below it, and
+ * update the edges above it starting at the same point
+ */
+void fi_overlay_fields(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                       FI_SWEEPEVENT *prev);
+
+/* add a face to the result of an overlay, its labels without the subject
+ */
+void fi_overlay_add_face(FI_OVERLAY_FACE **faces, size_t *n_face,
+                         FI_LABELS *labels, FI_PATH *path);
+
+/* chain the edges of each face of a finished overlay sweep, the edges
+ * bounding a face twice cancel out
+ */
+int fi_overlay_faces(FI_SWEEP_STATE *sweep, FI_OVERLAY_FACE **faces,
+                     size_t *n_face);
+
+/* overlay of linear paths, the clip paths missing the box of the subject are
+ * left out of the sweep
+ */
+int fi_overlay_sweep(FI_PATH *subject, FI_PATH **clips, size_t n_clip,
+                     FI_OVERLAY_FACE **faces, size_t *n_face);
+
+/* position of a point of the border of a rectangle, counterclockwise from
+ * its minimum corner with one unit per side
+ */
+double fi_rect_border_t(FI_POINT_D *rect, FI_POINT_D p);
+
+/* point of the border of a rectangle at position t (0 <= t < 4)
+ */
+FI_POINT_D fi_rect_border_point(FI_POINT_D *rect, double t);
+
+/* side of a position on the border (0 bottom, 1 right, 2 top, 3 left)
+ */
+int fi_rect_side(double t);
+
+/* corner k (modulo 4) of a rectangle, where side k starts
+ */
+FI_POINT_D fi_rect_corner(FI_POINT_D *rect, int k);
+
+/* outcodes of n points, bit set for each side of the rectangle they are
+ * beyond
+ */
+void fi_rect_codes(FI_POINT_D *pts, size_t n, FI_POINT_D *rect,
+                   unsigned char *codes);
+
+/* part [seg[0], seg[1]] of the edge [a, b] inside the closed rectangle, with
+ * the ends where it crosses the border exactly on it, false if none
+ */
+bool fi_rect_segment(FI_POINT_D a, FI_POINT_D b, FI_POINT_D *rect,
+                     FI_POINT_D *seg);
+
+/* append a point to a growable array
+ */
+void fi_rect_push(FI_POINT_D **pts, size_t *n, size_t *size, FI_POINT_D pt);
+
+/* copy the rings of a linear path to the points of a rectangle clipping
+ */
+void fi_rect_gather(FI_RECT_STATE *st, FI_PATH *path);
+
+/* add a point to the current chain
+ */
+void fi_rect_chain_add(FI_RECT_STATE *st, FI_POINT_D pt);
+
+/* end the current chain and add its crossings, or drop it if it is a point
+ */
+void fi_rect_chain_end(FI_RECT_STATE *st);
+
+/* cut a ring into chains, or keep it whole if it is inside the rectangle
+ */
+void fi_rect_ring(FI_RECT_STATE *st, size_t ring);
+
+/* the subject is on both sides of the border at position t, just outside of
+ * the rectangle
+ */
+bool fi_rect_border_inside(FI_RECT_STATE *st, double t);
+
+/* order of 2 positions along the border
+ */
+int fi_compare_border_t_p(const void *in_1, const void *in_2);
+
+/* position between ta and tb (tb - ta <= 4) to cast a ray from, in the middle
+ * of the longest part of the gap without a corner or a point of the subject
+ */
+double fi_rect_gap_t(FI_RECT_STATE *st, double ta, double tb);
+
+/* a, b and c are on the same side of the rectangle
+ */
+bool fi_rect_on_side(FI_POINT_D *rect, FI_POINT_D a, FI_POINT_D b,
+                     FI_POINT_D c);
+
+/* end the current loop of the result, clean drops its points inside the
+ * sides and the spikes along them; loops of less than 3 points are dropped
+ */
+void fi_rect_loop_end(FI_RECT_STATE *st, bool clean);
+
+/* order of 2 crossings along the border
+ */
+int fi_compare_cross_p(const void *in_1, const void *in_2);
+
+/* add the corners of the border between positions ta and tb
+ */
+void fi_rect_gap(FI_RECT_STATE *st, double ta, double tb, bool forward);
+
+/* join the chains with the inside gaps of the border into loops
+ */
+void fi_rect_stitch(FI_RECT_STATE *st);
+
+/* free the arrays of a rectangle clipping
+ */
+void fi_free_rect_state(FI_RECT_STATE *st);
+
+/* insert the edges of a ring (from its move segment), returns the segment
+ * after its end
+ */
+FI_PATH *fi_insert_ring(FI_SWEEP_STATE *sweep, FI_PATH *ring,
+                        FI_POLYGON_TYPE type);
+
 /* insert a path in the event queue
  */
-void fi_insert_events(FI_PATH *path, FI_SWEEPEVENT **event_queue,
+void fi_insert_events(FI_SWEEP_STATE *sweep, FI_PATH *path,
                       FI_POLYGON_TYPE type);
 
+/* restore the heap order of the whole event queue, in O(n)
+ */
+void fi_sort_events(FI_EVENT_QUEUE *queue);
+
+/* add an event at the end of the queue, fi_sort_events must be called after
+ */
+void fi_queue_append(FI_EVENT_QUEUE *queue, FI_SWEEPEVENT *event);
+
+/* add an event to the queue
+ */
+void fi_queue_push(FI_EVENT_QUEUE *queue, FI_SWEEPEVENT *event);
+
+/* remove and return the first event of the queue (NULL if empty)
+ */
+FI_SWEEPEVENT *fi_queue_pop(FI_EVENT_QUEUE *queue);
+
 /* Create the event queue that will be consumed by the clipping algorithm
  */
-void fi_create_sweepevent_queue(FI_PATH *path_subject, FI_PATH *path_clip,
-                                FI_SWEEPEVENT **event_queue);
+void fi_create_sweepevent_queue(FI_SWEEP_STATE *sweep, FI_PATH *path_subject,
+                                FI_PATH *path_clip);
+
+/* empty a sweep, but keep its buffers for the next one
+ */
+void fi_reset_sweep(FI_SWEEP_STATE *sweep);
+
+/* free all the events and the status of a sweep
+ */
+void fi_free_sweep(FI_SWEEP_STATE *sweep);
+
+/* twice the signed area of the triangle (p0, p1, p2), of the exact sign
+ */
+double fi_signed_area(FI_POINT_D p0, FI_POINT_D p1, FI_POINT_D p2);
+
+/* the edge of an event is vertical
+ */
+bool fi_is_vertical(FI_SWEEPEVENT *e);
+
+/* p1 and p2 are the same point up to the rounding errors of an intersection
+ */
+bool fi_near_point(FI_POINT_D p1, FI_POINT_D p2);
+
+/* order in which the events must be processed
+ */
+int fi_compare_events(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2);
+
+/* the edges of events e1 and e2 are parts of collinear input edges, false
+ * when both have their ends on their input edges: the ends tell it then
+ */
+bool fi_same_line(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2);
+
+/* order of 2 edges (given by their left event) on the sweep line
+ */
+int fi_compare_segments(FI_SWEEPEVENT *le1, FI_SWEEPEVENT *le2);
+
+/* intersection of segments [a1, a2] and [b1, b2], returns the number of
+ * intersection points written in out (2 if the segments overlap)
+ */
+int fi_segment_intersection(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                            FI_POINT_D b2, FI_POINT_D *out);
+
+/* crossing p of the edges of left events se1 and se2 computed again on their
+ * input edges: the ends of split edges are rounded, crossings computed on
+ * them drift from the crossings of the input
+ */
+FI_POINT_D fi_refine_crossing(FI_SWEEPEVENT *se1, FI_SWEEPEVENT *se2,
+                              FI_POINT_D p);
+
+/* p is exactly on the segment [a, b], strictly between its ends
+ */
+bool fi_on_segment(FI_POINT_D a, FI_POINT_D b, FI_POINT_D p);
+
+/* split the edge of left event se at point p
+ */
+void fi_divide_segment(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *se, FI_POINT_D p);
+
+/* the edges of left events se1 and se2 share one endpoint and the other end
+ * of the shorter one is on the longer one, up to rounding errors
+ */
+bool fi_near_overlap(FI_SWEEPEVENT *se1, FI_SWEEPEVENT *se2);
+
+/* the edges of left events e1 and e2 start at the same point and overlap
+ */
+bool fi_is_coincident(FI_SWEEPEVENT *e1, FI_SWEEPEVENT *e2);
+
+/* resolve the group of overlapping edges starting at the point of event: they
+ * are split at the same right endpoint and only one of them contributes, with
+ * the parity of the edges of each operand in the group
+ */
+void fi_coincident_edges(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event);
+
+/* resolve the group of an edge just shortened if it now overlaps the edges
+ * next to it, or was already part of a group
+ */
+void fi_check_coincident(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event);
+
+/* check and handle the intersection of 2 neighbouring edges
+ */
+int fi_possible_intersection(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *se1,
+                             FI_SWEEPEVENT *se2);
+
+/* the edge of a left event is part of the result of ops
+ */
+bool fi_in_result(FI_SWEEPEVENT *event, FI_OPS ops);
+
+/* compute in_out/inside/in_result of an edge from the edge below it
+ */
+void fi_compute_fields(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                       FI_SWEEPEVENT *prev);
+
+/* insert the edge of a left event in the status
+ */
+void fi_status_insert(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event);
+
+/* remove the edge of a left event from the status
+ */
+void fi_status_remove(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event);
+
+/* edge below an edge of the status (NULL if none)
+ */
+FI_SWEEPEVENT *fi_status_prev(FI_SWEEPEVENT *event);
+
+/* edge above an edge of the status (NULL if none)
+ */
+FI_SWEEPEVENT *fi_status_next(FI_SWEEPEVENT *event);
+
+/* run the sweep over the event queue
+ */
+void fi_subdivide(FI_SWEEP_STATE *sweep);
+
+/* chain the edges of the result into a FI_PATH
+ */
+int fi_connect_edges(FI_SWEEP_STATE *sweep, FI_PATH **out);
+
+/* chain the edges of n_events events (both events of each edge) into a
+ * FI_PATH
+ */
+int fi_connect_events(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT **events,
+                      int n_events, FI_PATH **out);
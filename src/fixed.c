@@ -0,0 +1,220 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Fixed-point clipping. The points are snapped to an integer grid (their
+ * coordinates times a scale, rounded) and kept in doubles: within FI_FIXED_MAX
+ * the orientation tests of the sweep are exact. The crossings of the edges are
+ * rounded with snap rounding: a first sweep finds them, the pixels (unit
+ * squares centered on the grid points) of the crossings and of the vertices
+ * are hot, and every edge is replaced by the path through the centers of the
+ * hot pixels it goes through, in the order it enters them. The snapped edges
+ * only meet at grid points or overlap exactly, the sweep of the clipping never
+ * has to round a crossing and no point moves behind its sweep line.
+ */
+
+int fi_fixed_path(FI_PATH *in, double scale, FI_PATH **out) {
+    FI_PATH *path;
+    *out = NULL;
+    if (in == NULL)
+        return 0;
+    fi_copy_path(in, &path);
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        for (int i = 0; i < tmp->section.n_point; i++) {
+            pt[i].x = round(pt[i].x * scale);
+            pt[i].y = round(pt[i].y * scale);
+            if (!(fabs(pt[i].x) <= FI_FIXED_MAX &&
+                  fabs(pt[i].y) <= FI_FIXED_MAX)) {
+                fi_free_path(path);
+                return ERR_FIXED_RANGE;
+            }
+        }
+    }
+    path->meta->bbox_valid = false;
+    path->meta->convex_valid = false;
+    *out = path;
+    return 0;
+}
+
+void fi_fixed_unscale(FI_PATH *path, double scale) {
+    if (path == NULL)
+        return;
+    // the fast paths can leave points between the grid points
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        for (int i = 0; i < tmp->section.n_point; i++) {
+            pt[i].x = round(pt[i].x) / scale;
+            pt[i].y = round(pt[i].y) / scale;
+        }
+    }
+    path->meta->bbox_valid = false;
+    path->meta->convex_valid = false;
+}
+
+int fi_compare_point_p(const void *in_1, const void *in_2) {
+    return fi_compare_point(*(FI_POINT_D *)in_1, *(FI_POINT_D *)in_2);
+}
+
+size_t fi_fixed_hot_pixels(FI_PATH *p1, FI_PATH *p2, FI_POINT_D **out) {
+    // the operands split at all their crossings, vertices included
+    FI_SWEEP_STATE sweep = {0};
+    sweep.ops = FI_AND;
+    fi_create_sweepevent_queue(&sweep, p1, p2);
+    fi_subdivide(&sweep);
+
+    size_t n_event = sweep.n_processed;
+    FI_POINT_D *pixels = malloc((n_event ? n_event : 1) * sizeof(FI_POINT_D));
+    for (size_t i = 0; i < n_event; i++) {
+        FI_POINT_D p = sweep.processed[i]->point;
+        pixels[i] = (FI_POINT_D){round(p.x), round(p.y)};
+    }
+    qsort(pixels, n_event, sizeof(FI_POINT_D), fi_compare_point_p);
+    size_t n = 0;
+    for (size_t i = 0; i < n_event; i++)
+        if (n == 0 || fi_compare_point(pixels[i], pixels[n - 1]) != 0)
+            pixels[n++] = pixels[i];
+    fi_free_sweep(&sweep);
+    *out = pixels;
+    return n;
+}
+
+int fi_fixed_snap_edge(FI_POINT_D s, FI_POINT_D e, FI_POINT_D *pixels,
+                       size_t n_pixel, FI_POINT_D **buf, int *s_buf) {
+    // on the grid, the pixels an edge goes through have their centers in
+    // the bounding box of the edge
+    FI_POINT_D low = {fmin(s.x, e.x), fmin(s.y, e.y)};
+    FI_POINT_D high = {fmax(s.x, e.x), fmax(s.y, e.y)};
+    size_t lo = 0;
+    size_t hi = n_pixel;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pixels[mid].x < low.x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    double sx = s.x <= e.x ? 1 : -1;
+    double sy = s.y <= e.y ? 1 : -1;
+    int n = 0;
+    for (size_t i = lo; i < n_pixel && pixels[i].x <= high.x; i++) {
+        FI_POINT_D c = pixels[i];
+        if (c.y < low.y || c.y > high.y)
+            continue;
+        // the edges of a crossing miss the pixel of its rounding by at most
+        // the rounding error of the crossing, the pixels are a bit larger
+        double half =
+            0.5 + fmax(fmax(fabs(c.x), fabs(c.y)), 1.0) * FI_EPSILON;
+        FI_POINT_D pixel[2] = {{c.x - half, c.y - half},
+                               {c.x + half, c.y + half}};
+        if (!fi_edge_hits_box(s, e, pixel))
+            continue;
+        if (n == *s_buf) {
+            *s_buf = *s_buf ? *s_buf * 2 : 16;
+            *buf = realloc(*buf, *s_buf * sizeof(FI_POINT_D));
+        }
+        // the edge is monotone, it enters its pixels in the order of their
+        // centers along its direction
+        (*buf)[n++] = (FI_POINT_D){sx * c.x, sy * c.y};
+    }
+    qsort(*buf, n, sizeof(FI_POINT_D), fi_compare_point_p);
+    for (int i = 0; i < n; i++)
+        (*buf)[i] = (FI_POINT_D){sx * (*buf)[i].x, sy * (*buf)[i].y};
+    return n;
+}
+
+void fi_fixed_snap(FI_PATH *in, FI_POINT_D *pixels, size_t n_pixel,
+                   FI_PATH **out) {
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    FI_POINT_D *buf = NULL;
+    int s_buf = 0;
+    int n;
+
+    *out = NULL;
+    for (FI_PATH *tmp = in; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            fi_append_new_seg(out, FI_SEG_MOVE);
+            (*out)->meta->last->section.points[0] = pt[0];
+            first = pt[0];
+            last = pt[0];
+            break;
+        case FI_SEG_LINE:
+            // the pixel of the start of the edge comes first, an edge within
+            // a pixel is kept so the ring stays valid
+            n = fi_fixed_snap_edge(last, pt[0], pixels, n_pixel, &buf, &s_buf);
+            if (n > 1)
+                fi_append_lines(buf + 1, n - 1, out);
+            else
+                fi_append_lines(pt, 1, out);
+            last = pt[0];
+            break;
+        case FI_SEG_END:
+            n = fi_fixed_snap_edge(last, first, pixels, n_pixel, &buf, &s_buf);
+            fi_append_lines(buf + 1, n - 2, out);
+            fi_append_new_seg(out, FI_SEG_END);
+            last = first;
+            break;
+        default:
+            break;
+        }
+    }
+    free(buf);
+}
+
+int fi_clip_fixed(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, double scale,
+                  FI_PATH **out) {
+    FI_PATH *in[2] = {p1, p2};
+    FI_PATH *linear[2] = {p1, p2};
+    FI_PATH *grid[2] = {NULL, NULL};
+    int ret = 0;
+
+    *out = NULL;
+    if (!(scale > 0) || isinf(scale))
+        return ERR_FIXED_RANGE;
+    for (int k = 0; k < 2 && !ret; k++) {
+        if (in[k] == NULL)
+            continue;
+        if ((ret = fi_validate_path(in[k])))
+            break;
+        FI_META *meta = in[k]->meta;
+        if (meta->n_arc + meta->n_qbez + meta->n_cbez)
+            fi_linearize_to(in[k], 0, &linear[k]);
+        ret = fi_fixed_path(linear[k], scale, &grid[k]);
+    }
+
+    if (!ret) {
+        FI_POINT_D *pixels;
+        size_t n_pixel = fi_fixed_hot_pixels(grid[0], grid[1], &pixels);
+        for (int k = 0; k < 2; k++) {
+            FI_PATH *snapped;
+            fi_fixed_snap(grid[k], pixels, n_pixel, &snapped);
+            fi_free_path(grid[k]);
+            grid[k] = snapped;
+        }
+        free(pixels);
+        ret = fi_clip(grid[0], grid[1], ops, out);
+        fi_fixed_unscale(*out, scale);
+    }
+    for (int k = 0; k < 2; k++) {
+        if (linear[k] != in[k])
+            fi_free_path(linear[k]);
+        fi_free_path(grid[k]);
+    }
+    return ret;
+}
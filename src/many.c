@@ -0,0 +1,148 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * N-ary clippings as a balanced tree of binary ones: the operands are paired,
+ * each level of the tree being a batch of clippings run on a pool of threads
+ * (see fi_clip_batch()), until one path is left. Each level sweeps each edge
+ * once at most, over about log2(n) levels, instead of sweeping the growing
+ * result once per operand. The operands are first sorted along a Z-order curve
+ * of the centers of their boxes, so that neighbouring paths are merged first
+ * and far apart ones are only copied (see fi_clip_disjoint()) until the last
+ * levels.
+ */
+
+uint32_t fi_morton(FI_POINT_D pt, FI_POINT_D *box) {
+    double w = box[1].x - box[0].x;
+    double h = box[1].y - box[0].y;
+    uint32_t x = w > 0 ? (uint32_t)((pt.x - box[0].x) / w * 65535) : 0;
+    uint32_t y = h > 0 ? (uint32_t)((pt.y - box[0].y) / h * 65535) : 0;
+    uint32_t key = 0;
+    // the bits of x and y interleaved, y first
+    for (int i = 15; i >= 0; i--)
+        key = key << 2 | ((y >> i) & 1) << 1 | ((x >> i) & 1);
+    return key;
+}
+
+int fi_compare_many_p(const void *in_1, const void *in_2) {
+    const FI_MANY_ITEM *i1 = in_1;
+    const FI_MANY_ITEM *i2 = in_2;
+    if (i1->key != i2->key)
+        return i1->key < i2->key ? -1 : 1;
+    // stable order of the operands with the same key
+    return i1->index < i2->index ? -1 : i1->index > i2->index;
+}
+
+void fi_many_order(FI_PATH **paths, size_t n, FI_MANY_ITEM *items) {
+    FI_POINT_D all[2] = {{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
+    FI_POINT_D *centers = malloc((n ? n : 1) * sizeof(FI_POINT_D));
+    for (size_t i = 0; i < n; i++) {
+        FI_POINT_D bbox[2];
+        fi_path_bbox(paths[i], bbox);
+        centers[i] = (FI_POINT_D){0, 0};
+        if (paths[i] != NULL && bbox[0].x <= bbox[1].x) {
+            centers[i].x = (bbox[0].x + bbox[1].x) / 2;
+            centers[i].y = (bbox[0].y + bbox[1].y) / 2;
+            fi_bbox_add(all, centers[i]);
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        items[i].path = paths[i];
+        items[i].owned = false;
+        items[i].index = i;
+        items[i].key = fi_morton(centers[i], all);
+    }
+    free(centers);
+    qsort(items, n, sizeof(FI_MANY_ITEM), fi_compare_many_p);
+}
+
+void fi_many_free(FI_MANY_ITEM *items, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (items[i].owned)
+            fi_free_path(items[i].path);
+}
+
+int fi_many_reduce(FI_MANY_ITEM *items, size_t n, FI_OPS ops, int n_thread,
+                   FI_PATH **out) {
+    int ret = 0;
+    FI_CLIP_JOB *jobs = malloc((n / 2 ? n / 2 : 1) * sizeof(FI_CLIP_JOB));
+
+    *out = NULL;
+    while (n > 1) {
+        size_t n_job = n / 2;
+        for (size_t i = 0; i < n_job; i++)
+            jobs[i] = (FI_CLIP_JOB){items[2 * i].path, items[2 * i + 1].path,
+                                    ops, NULL, 0};
+        ret = fi_clip_batch(jobs, n_job, n_thread);
+        fi_many_free(items, 2 * n_job);
+
+        // the results, and the operand without a pair, are the next level
+        bool empty = false;
+        for (size_t i = 0; i < n_job; i++) {
+            items[i].path = jobs[i].out;
+            items[i].owned = true;
+            empty |= jobs[i].out == NULL;
+        }
+        if (n % 2)
+            items[n_job] = items[n - 1];
+        n = n_job + n % 2;
+
+        // an empty intersection ends the reduction
+        if (ret || (ops == FI_AND && empty)) {
+            fi_many_free(items, n);
+            free(jobs);
+            return ret;
+        }
+    }
+    free(jobs);
+
+    if (n == 1 && items[0].owned)
+        *out = items[0].path;
+    else if (n == 1)
+        fi_copy_path(items[0].path, out);
+    return 0;
+}
+
+int fi_clip_many(FI_PATH **paths, size_t n, FI_OPS ops, int n_thread,
+                 FI_PATH **out) {
+    int ret = 0;
+    *out = NULL;
+    for (size_t i = 0; i < n; i++)
+        if (paths[i] != NULL && (ret = fi_validate_path(paths[i])))
+            return ret;
+    if (n == 0)
+        return 0;
+    if (ops == FI_AND)
+        for (size_t i = 0; i < n; i++)
+            if (paths[i] == NULL)
+                return 0;
+
+    // the difference of the first path and the union of the others
+    size_t first = ops == FI_DIFF ? 1 : 0;
+    FI_OPS reduce = ops == FI_DIFF ? FI_OR : ops;
+    FI_MANY_ITEM *items = malloc(n * sizeof(FI_MANY_ITEM));
+    fi_many_order(paths + first, n - first, items);
+    FI_PATH *result;
+    ret = fi_many_reduce(items, n - first, reduce, n_thread, &result);
+    free(items);
+    if (ret || ops != FI_DIFF) {
+        *out = result;
+        return ret;
+    }
+
+    ret = fi_clip(paths[0], result, FI_DIFF, out);
+    fi_free_path(result);
+    return ret;
+}
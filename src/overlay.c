@@ -0,0 +1,253 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Overlay of a subject and many clip paths in one sweep. Instead of the
+ * in_out/inside fields of a clipping, each edge gets the set of the operands
+ * covering the region just above it: the set of the edge below it with the
+ * operand of the edge added or removed (even-odd rule). The region below the
+ * edge is the same set with the operand toggled back, so each edge inside the
+ * subject bounds 2 faces, and each edge of the subject one. The edges are
+ * then grouped by face and chained as for a clipping.
+ */
+
+FI_LABELS *fi_labels_toggle(FI_ARENA *arena, FI_LABELS *labels, size_t op) {
+    size_t n = labels != NULL ? labels->n : 0;
+    size_t i = 0;
+    while (i < n && labels->op[i] < op)
+        i++;
+    bool found = i < n && labels->op[i] == op;
+    size_t n_out = found ? n - 1 : n + 1;
+    if (n_out == 0)
+        return NULL;
+
+    FI_LABELS *out =
+        fi_arena_alloc(arena, sizeof(FI_LABELS) + n_out * sizeof(size_t));
+    out->n = n_out;
+    for (size_t j = 0; j < i; j++)
+        out->op[j] = labels->op[j];
+    if (found) {
+        for (size_t j = i + 1; j < n; j++)
+            out->op[j - 1] = labels->op[j];
+    } else {
+        out->op[i] = op;
+        for (size_t j = i; j < n; j++)
+            out->op[j + 1] = labels->op[j];
+    }
+    return out;
+}
+
+int fi_compare_labels(FI_LABELS *l1, FI_LABELS *l2) {
+    size_t n1 = l1 != NULL ? l1->n : 0;
+    size_t n2 = l2 != NULL ? l2->n : 0;
+    for (size_t i = 0; i < n1 && i < n2; i++)
+        if (l1->op[i] != l2->op[i])
+            return l1->op[i] < l2->op[i] ? -1 : 1;
+    return n1 < n2 ? -1 : n1 > n2;
+}
+
+int fi_compare_overlay_edges_p(const void *in_1, const void *in_2) {
+    const FI_OVERLAY_EDGE *e1 = in_1;
+    const FI_OVERLAY_EDGE *e2 = in_2;
+    int cmp = fi_compare_labels(e1->labels, e2->labels);
+    if (cmp == 0)
+        cmp = fi_compare_point(e1->left->point, e2->left->point);
+    if (cmp == 0)
+        cmp = fi_compare_point(e1->left->other->point,
+                               e2->left->other->point);
+    return cmp;
+}
+
+FI_LABELS *fi_overlay_above(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                            FI_SWEEPEVENT *prev) {
+    // the region above a vertical edge is the one left of it, an edge
+    // starting on it is in the region right of it (the one below)
+    FI_LABELS *below = prev != NULL ? prev->labels : NULL;
+    if (prev != NULL && fi_is_vertical(prev) && !fi_is_vertical(event))
+        below = fi_labels_toggle(&sweep->events, below,
+                                 sweep->operand[prev->contour_id]);
+    return fi_labels_toggle(&sweep->events, below,
+                            sweep->operand[event->contour_id]);
+}
+
+void fi_overlay_fields(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event,
+                       FI_SWEEPEVENT *prev) {
+    event->labels = fi_overlay_above(sweep, event, prev);
+    if (!event->node.linked)
+        return;
+
+    // the edges starting at the same point (up to rounding errors) are not
+    // always processed from the lowest one, the ones above already inserted
+    // now have one more edge below them
+    for (FI_SWEEPEVENT *next = fi_status_next(event);
+         next != NULL && fi_near_point(next->point, event->point);
+         next = fi_status_next(next))
+        next->labels = fi_overlay_above(sweep, next, fi_status_prev(next));
+}
+
+void fi_overlay_add_face(FI_OVERLAY_FACE **faces, size_t *n_face,
+                         FI_LABELS *labels, FI_PATH *path) {
+    // the storage doubles each time the count reaches a power of 2
+    if ((*n_face & (*n_face - 1)) == 0)
+        *faces = realloc(*faces, (*n_face ? *n_face * 2 : 1) *
+                                     sizeof(FI_OVERLAY_FACE));
+
+    // the first label is the subject
+    FI_OVERLAY_FACE *face = &(*faces)[*n_face];
+    face->n_label = labels->n - 1;
+    face->labels = NULL;
+    if (face->n_label > 0) {
+        face->labels = malloc(face->n_label * sizeof(size_t));
+        for (size_t i = 0; i < face->n_label; i++)
+            face->labels[i] = labels->op[i + 1] - 1;
+    }
+    face->path = path;
+    (*n_face)++;
+}
+
+int fi_overlay_faces(FI_SWEEP_STATE *sweep, FI_OVERLAY_FACE **faces,
+                     size_t *n_face) {
+    int ret = 0;
+    size_t n_edge = 0;
+    FI_OVERLAY_EDGE *edges = fi_arena_alloc(
+        &sweep->events, 2 * sweep->n_processed * sizeof(FI_OVERLAY_EDGE));
+
+    // the sides of the edges which are in the subject
+    for (size_t i = 0; i < sweep->n_processed; i++) {
+        FI_SWEEPEVENT *event = sweep->processed[i];
+        if (!event->is_left_event)
+            continue;
+        FI_LABELS *above = event->labels;
+        FI_LABELS *below = fi_labels_toggle(&sweep->events, above,
+                                            sweep->operand[event->contour_id]);
+        if (above != NULL && above->op[0] == 0)
+            edges[n_edge++] = (FI_OVERLAY_EDGE){above, event};
+        if (below != NULL && below->op[0] == 0)
+            edges[n_edge++] = (FI_OVERLAY_EDGE){below, event};
+    }
+    qsort(edges, n_edge, sizeof(FI_OVERLAY_EDGE), fi_compare_overlay_edges_p);
+
+    FI_SWEEPEVENT **events =
+        fi_arena_alloc(&sweep->events, 2 * n_edge * sizeof(FI_SWEEPEVENT *));
+    size_t i = 0;
+    while (i < n_edge && !ret) {
+        int n_events = 0;
+        size_t first = i;
+        while (i < n_edge &&
+               fi_compare_labels(edges[i].labels, edges[first].labels) == 0) {
+            // overlapping edges bounding the same face are a face of no area
+            // between them, they cancel out by pairs
+            size_t same = i;
+            while (i < n_edge &&
+                   fi_compare_overlay_edges_p(&edges[i], &edges[same]) == 0)
+                i++;
+            if ((i - same) % 2) {
+                events[n_events++] = edges[same].left;
+                events[n_events++] = edges[same].left->other;
+            }
+        }
+
+        FI_PATH *path;
+        ret = fi_connect_events(sweep, events, n_events, &path);
+        if (!ret && path != NULL)
+            fi_overlay_add_face(faces, n_face, edges[first].labels, path);
+    }
+    return ret;
+}
+
+int fi_overlay_sweep(FI_PATH *subject, FI_PATH **clips, size_t n_clip,
+                     FI_OVERLAY_FACE **faces, size_t *n_face) {
+    int ret = 0;
+    size_t n_ring = subject->meta->n_move;
+    for (size_t i = 0; i < n_clip; i++)
+        if (clips[i] != NULL)
+            n_ring += clips[i]->meta->n_move;
+    FI_RING *rings = malloc(n_ring * sizeof(FI_RING));
+    size_t *operand = malloc(n_ring * sizeof(size_t));
+    FI_SWEEP_STATE sweep = {0};
+    fi_arena_init(&sweep.events, 0);
+    sweep.operand = operand;
+
+    FI_POINT_D bbox[2];
+    fi_path_bbox(subject, bbox);
+    for (size_t i = 0; i <= n_clip; i++) {
+        FI_PATH *path = i == 0 ? subject : clips[i - 1];
+        if (path == NULL)
+            continue;
+        size_t n = fi_path_rings(path, i == 0 ? FI_SUBJECT : FI_CLIPPED, rings);
+        for (size_t j = 0; j < n; j++) {
+            // a ring without area or out of the subject bounds no face
+            if (!(rings[j].bbox[0].x < rings[j].bbox[1].x) ||
+                !(rings[j].bbox[0].y < rings[j].bbox[1].y) ||
+                (i > 0 && !fi_bbox_overlap(rings[j].bbox, bbox)))
+                continue;
+            operand[sweep.n_contour] = i;
+            fi_insert_ring(&sweep, rings[j].first, rings[j].type);
+        }
+    }
+
+    fi_sort_events(&sweep.queue);
+    fi_subdivide(&sweep);
+    ret = fi_overlay_faces(&sweep, faces, n_face);
+    fi_free_sweep(&sweep);
+    free(operand);
+    free(rings);
+    return ret;
+}
+
+int fi_overlay(FI_PATH *subject, FI_PATH **clips, size_t n_clip,
+               FI_OVERLAY_FACE **faces, size_t *n_face) {
+    int ret = 0;
+    *faces = NULL;
+    *n_face = 0;
+    if (subject != NULL && (ret = fi_validate_path(subject)))
+        return ret;
+    for (size_t i = 0; i < n_clip; i++)
+        if (clips[i] != NULL && (ret = fi_validate_path(clips[i])))
+            return ret;
+    if (subject == NULL)
+        return 0;
+
+    // the sweep only handles straight edges, work on linearized copies
+    FI_PATH **linear = malloc((n_clip + 1) * sizeof(FI_PATH *));
+    for (size_t i = 0; i <= n_clip; i++) {
+        FI_PATH *path = i == 0 ? subject : clips[i - 1];
+        linear[i] = path;
+        if (path != NULL &&
+            path->meta->n_arc + path->meta->n_qbez + path->meta->n_cbez)
+            fi_linearize_to(path, 0, &linear[i]);
+    }
+
+    ret = fi_overlay_sweep(linear[0], linear + 1, n_clip, faces, n_face);
+    if (ret) {
+        fi_free_overlay(*faces, *n_face);
+        *faces = NULL;
+        *n_face = 0;
+    }
+
+    for (size_t i = 0; i <= n_clip; i++)
+        if (linear[i] != (i == 0 ? subject : clips[i - 1]))
+            fi_free_path(linear[i]);
+    free(linear);
+    return ret;
+}
+
+void fi_free_overlay(FI_OVERLAY_FACE *faces, size_t n_face) {
+    for (size_t i = 0; i < n_face; i++) {
+        fi_free_path(faces[i].path);
+        free(faces[i].labels);
+    }
+    free(faces);
+}
@@ -0,0 +1,286 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+#define PACKED_TYPE(t) ((FI_SEG_TYPE)((t)&0x0f))
+#define PACKED_FLAG(t) ((FI_SEG_FLAG)((t) >> 4))
+
+void *fi_packed_grow(void *array, size_t *size, size_t n, size_t elem) {
+    if (n <= *size)
+        return array;
+    size_t new_size = *size ? *size : 64;
+    while (new_size < n)
+        new_size *= 2;
+    *size = new_size;
+    return realloc(array, new_size * elem);
+}
+
+FI_PACKED_PATH *fi_new_packed(size_t n_seg, size_t n_point,
+                              size_t n_subpath) {
+    FI_PACKED_PATH *path = calloc(1, sizeof(FI_PACKED_PATH));
+    path->types = malloc(n_seg ? n_seg : 1);
+    path->points = malloc((n_point ? n_point : 1) * sizeof(FI_POINT_D));
+    path->subpaths = malloc((n_subpath ? n_subpath : 1) * sizeof(size_t));
+    path->s_seg = n_seg;
+    path->s_point = n_point;
+    path->s_subpath = n_subpath;
+    return path;
+}
+
+void fi_packed_own(FI_PACKED_PATH *path) {
+    if (!path->borrowed)
+        return;
+    unsigned char *types = path->types;
+    FI_POINT_D *points = path->points;
+    size_t *subpaths = path->subpaths;
+    path->types = malloc(path->n_seg ? path->n_seg : 1);
+    path->points = malloc((path->n_point ? path->n_point : 1) *
+                          sizeof(FI_POINT_D));
+    path->subpaths =
+        malloc((path->n_subpath ? path->n_subpath : 1) * sizeof(size_t));
+    memcpy(path->types, types, path->n_seg);
+    memcpy(path->points, points, path->n_point * sizeof(FI_POINT_D));
+    memcpy(path->subpaths, subpaths, path->n_subpath * sizeof(size_t));
+    path->s_seg = path->n_seg;
+    path->s_point = path->n_point;
+    path->s_subpath = path->n_subpath;
+    path->borrowed = false;
+    if (path->map != NULL)
+        fi_binary_unmap(path->map, path->s_map);
+    path->map = NULL;
+    path->s_map = 0;
+}
+
+int fi_append_packed_seg(FI_PACKED_PATH **path, FI_SEG_TYPE type,
+                         FI_SEG_FLAG flag) {
+    if (*path == NULL)
+        *path = calloc(1, sizeof(FI_PACKED_PATH));
+    FI_PACKED_PATH *p = *path;
+    size_t n_point = fi_seg_n_point(type);
+    fi_packed_own(p);
+
+    p->types = fi_packed_grow(p->types, &p->s_seg, p->n_seg + 1, 1);
+    p->points = fi_packed_grow(p->points, &p->s_point, p->n_point + n_point,
+                               sizeof(FI_POINT_D));
+    if (type == FI_SEG_MOVE) {
+        p->subpaths = fi_packed_grow(p->subpaths, &p->s_subpath,
+                                     p->n_subpath + 1, sizeof(size_t));
+        p->subpaths[p->n_subpath++] = p->n_seg;
+    }
+    p->types[p->n_seg++] = type | (flag << 4);
+    memset(&p->points[p->n_point], 0, n_point * sizeof(FI_POINT_D));
+    p->n_point += n_point;
+    return 0;
+}
+
+int fi_pack_path(FI_PATH *in, FI_PACKED_PATH **out) {
+    *out = NULL;
+    if (in == NULL)
+        return 0;
+
+    FI_META *meta = in->meta;
+    size_t n_point = meta->n_move + meta->n_line + 2 * meta->n_qbez +
+                     3 * (meta->n_arc + meta->n_cbez);
+    FI_PACKED_PATH *path = fi_new_packed(meta->n_total, n_point, meta->n_move);
+
+    for (FI_PATH *tmp = in; tmp != NULL; tmp = tmp->next) {
+        FI_SEG_TYPE type = tmp->section.type;
+        int n = fi_seg_n_point(type);
+        if (type == FI_SEG_MOVE)
+            path->subpaths[path->n_subpath++] = path->n_seg;
+        path->types[path->n_seg++] = type | (tmp->section.flag << 4);
+        if (n > 0)
+            memcpy(&path->points[path->n_point], tmp->section.points,
+                   n * sizeof(FI_POINT_D));
+        path->n_point += n;
+    }
+    *out = path;
+    return 0;
+}
+
+int fi_unpack_path(FI_PACKED_PATH *in, FI_PATH **out) {
+    *out = NULL;
+    if (in == NULL || in->n_seg == 0)
+        return 0;
+
+    // all the segments in one block, pointing to the packed points
+    FI_META *meta = calloc(1, sizeof(FI_META));
+    FI_PATH *nodes = calloc(in->n_seg, sizeof(FI_PATH));
+    FI_POINT_D *pt = in->points;
+    meta->packed = in;
+    meta->nodes = nodes;
+    meta->n_max = DEFAULT_MAX_PATH_LENGTH;
+
+    for (size_t i = 0; i < in->n_seg; i++) {
+        FI_SEG_TYPE type = PACKED_TYPE(in->types[i]);
+        int n = fi_seg_n_point(type);
+        nodes[i].section.type = type;
+        nodes[i].section.flag = PACKED_FLAG(in->types[i]);
+        nodes[i].section.n_point = n;
+        nodes[i].section.points = n ? pt : NULL;
+        nodes[i].meta = meta;
+        nodes[i].prev = i > 0 ? &nodes[i - 1] : NULL;
+        nodes[i].next = i + 1 < in->n_seg ? &nodes[i + 1] : NULL;
+        pt += n;
+
+        meta->n_total++;
+        switch (type) {
+        case FI_SEG_END:
+            meta->n_end++;
+            break;
+        case FI_SEG_MOVE:
+            meta->n_move++;
+            break;
+        case FI_SEG_LINE:
+            meta->n_line++;
+            break;
+        case FI_SEG_ARC:
+            meta->n_arc++;
+            break;
+        case FI_SEG_QUA_BEZIER:
+            meta->n_qbez++;
+            break;
+        case FI_SEG_CUB_BEZIER:
+            meta->n_cbez++;
+            break;
+        }
+    }
+    meta->first = &nodes[0];
+    meta->last = &nodes[in->n_seg - 1];
+    *out = meta->first;
+    return 0;
+}
+
+void fi_free_packed(FI_PACKED_PATH *path) {
+    if (path == NULL)
+        return;
+    if (!path->borrowed) {
+        free(path->types);
+        free(path->points);
+        free(path->subpaths);
+    }
+    if (path->map != NULL)
+        fi_binary_unmap(path->map, path->s_map);
+    free(path);
+}
+
+void fi_copy_packed(FI_PACKED_PATH *in, FI_PACKED_PATH **out) {
+    *out = NULL;
+    if (in == NULL)
+        return;
+    FI_PACKED_PATH *path = fi_new_packed(in->n_seg, in->n_point, in->n_subpath);
+    memcpy(path->types, in->types, in->n_seg);
+    memcpy(path->points, in->points, in->n_point * sizeof(FI_POINT_D));
+    memcpy(path->subpaths, in->subpaths, in->n_subpath * sizeof(size_t));
+    path->n_seg = in->n_seg;
+    path->n_point = in->n_point;
+    path->n_subpath = in->n_subpath;
+    *out = path;
+}
+
+void fi_offset_packed(FI_PACKED_PATH *in, FI_POINT_D pt) {
+    if (in == NULL)
+        return;
+    FI_POINT_D *points = in->points;
+    for (size_t i = 0; i < in->n_seg; i++) {
+        FI_SEG_TYPE type = PACKED_TYPE(in->types[i]);
+        fi_offset_seg(type, points, pt);
+        points += fi_seg_n_point(type);
+    }
+}
+
+/* append the points of a flattened curve as line segments */
+void fi_append_packed_lines(FI_PACKED_PATH **out, FI_POINT_D *pts, int n) {
+    for (int i = 0; i < n; i++) {
+        fi_append_packed_seg(out, FI_SEG_LINE, 0);
+        (*out)->points[(*out)->n_point - 1] = pts[i];
+    }
+}
+
+void fi_linearize_packed(FI_PACKED_PATH **in) {
+    fi_linearize_packed_tolerance(in, 0);
+}
+
+void fi_linearize_packed_tolerance(FI_PACKED_PATH **in, double tolerance) {
+    FI_PACKED_PATH *path = *in;
+    FI_PACKED_PATH *out = NULL;
+    FI_POINT_D *buf = NULL;
+    int s_buf = 0;
+    int n_line;
+    FI_POINT_D last_ref_point = {0};
+    FI_POINT_D *pt;
+
+    if (path == NULL)
+        return;
+
+    pt = path->points;
+    for (size_t i = 0; i < path->n_seg; i++) {
+        FI_SEG_TYPE type = PACKED_TYPE(path->types[i]);
+        FI_SEG_FLAG flag = PACKED_FLAG(path->types[i]);
+        int n = fi_seg_n_point(type);
+        switch (type) {
+        case FI_SEG_END:
+        case FI_SEG_MOVE:
+        case FI_SEG_LINE:
+            fi_append_packed_seg(&out, type, flag);
+            memcpy(&out->points[out->n_point - n], pt, n * sizeof(FI_POINT_D));
+            break;
+        case FI_SEG_ARC:
+            n_line = fi_arc_flatten(last_ref_point, pt, flag, tolerance, &buf,
+                                    &s_buf);
+            fi_append_packed_lines(&out, buf, n_line);
+            break;
+        case FI_SEG_QUA_BEZIER:
+            n_line = fi_bezier_flatten(last_ref_point, pt, 2, tolerance, &buf,
+                                       &s_buf);
+            fi_append_packed_lines(&out, buf, n_line);
+            break;
+        case FI_SEG_CUB_BEZIER:
+            n_line = fi_bezier_flatten(last_ref_point, pt, 3, tolerance, &buf,
+                                       &s_buf);
+            fi_append_packed_lines(&out, buf, n_line);
+            break;
+        }
+        // the end point of a segment is always its last point
+        if (n > 0)
+            last_ref_point = pt[n - 1];
+        else
+            last_ref_point = (FI_POINT_D){0};
+        pt += n;
+    }
+    free(buf);
+    fi_free_packed(path);
+    *in = out;
+}
+
+int fi_write_packed(FI_WRITER *w, FI_PACKED_PATH *in) {
+    if (in == NULL)
+        return w->err;
+    FI_POINT_D *points = in->points;
+    for (size_t i = 0; i < in->n_seg && w->err == 0; i++) {
+        FI_SEG_TYPE type = PACKED_TYPE(in->types[i]);
+        fi_write_seg(w, type, PACKED_FLAG(in->types[i]), points);
+        points += fi_seg_n_point(type);
+    }
+    return w->err;
+}
+
+void fi_draw_packed(FI_PACKED_PATH *in, FILE *out) {
+    FI_WRITER w;
+    char buf[FI_DRAW_BUFFER_SIZE];
+    fi_writer_init(&w, buf, sizeof(buf));
+    w.out = out;
+    fi_write_packed(&w, in);
+    fi_writer_flush(&w);
+}
@@ -0,0 +1,461 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * SVG path data parser (https://www.w3.org/TR/SVG/paths.html#PathDataBNF).
+ * Numbers are converted directly from the input: exactly with one
+ * multiplication or division when the significand and the power of ten are
+ * exact doubles (Clinger's fast path), by strtod() on a normalized copy on
+ * the stack otherwise. Relative, H/V and S/T commands are converted to the
+ * absolute M, L, Q, C and A segments of a FI_PATH.
+ */
+
+// powers of ten exactly representable as doubles
+const double fi_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                           1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                           1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+int fi_cmd_arity(char c) {
+    switch (c) {
+    case 'Z':
+    case 'z':
+        return 0;
+    case 'H':
+    case 'h':
+    case 'V':
+    case 'v':
+        return 1;
+    case 'M':
+    case 'm':
+    case 'L':
+    case 'l':
+    case 'T':
+    case 't':
+        return 2;
+    case 'Q':
+    case 'q':
+    case 'S':
+    case 's':
+        return 4;
+    case 'C':
+    case 'c':
+        return 6;
+    case 'A':
+    case 'a':
+        return 7;
+    default:
+        return -1;
+    }
+}
+
+FI_SEG_TYPE fi_cmd_type(char c) {
+    switch (c | 0x20) {
+    case 'm':
+        return FI_SEG_MOVE;
+    case 'l':
+    case 'h':
+    case 'v':
+        return FI_SEG_LINE;
+    case 'a':
+        return FI_SEG_ARC;
+    case 'q':
+    case 't':
+        return FI_SEG_QUA_BEZIER;
+    case 'c':
+    case 's':
+        return FI_SEG_CUB_BEZIER;
+    default:
+        return FI_SEG_END;
+    }
+}
+
+/* exponent of a number, clamped (the result is 0 or inf long before) */
+int fi_parse_exponent(const char *in, size_t s_in, size_t *pos) {
+    size_t i = *pos;
+    int exp = 0;
+    bool neg = false;
+    if (i < s_in && (in[i] == '+' || in[i] == '-'))
+        neg = in[i++] == '-';
+    for (; i < s_in && in[i] >= '0' && in[i] <= '9'; i++)
+        if (exp < 100000)
+            exp = exp * 10 + (in[i] - '0');
+    *pos = i;
+    return neg ? -exp : exp;
+}
+
+double fi_parse_number_slow(const char *in, size_t s_in, size_t start) {
+    // significant digits, a sticky digit for the dropped ones and exponent
+    char buf[FI_NUMBER_MAX_DIGITS + 32];
+    int n = 0;
+    int n_dig = 0;
+    long exp = 0;
+    bool point = false;
+    bool sticky = false;
+    size_t i = start;
+
+    if (in[i] == '+' || in[i] == '-')
+        if (in[i++] == '-')
+            buf[n++] = '-';
+    for (; i < s_in; i++) {
+        if (in[i] == '.' && !point) {
+            point = true;
+            continue;
+        }
+        if (in[i] < '0' || in[i] > '9')
+            break;
+        if (n_dig == 0 && in[i] == '0') {
+            exp -= point;
+        } else if (n_dig < FI_NUMBER_MAX_DIGITS) {
+            buf[n++] = in[i];
+            n_dig++;
+            exp -= point;
+        } else {
+            sticky |= in[i] != '0';
+            exp += !point;
+        }
+    }
+    if (n_dig == 0)
+        return n ? -0.0 : 0.0;
+    if (sticky) {
+        buf[n++] = '1';
+        exp--;
+    }
+    if (i < s_in && (in[i] == 'e' || in[i] == 'E')) {
+        i++;
+        exp += fi_parse_exponent(in, s_in, &i);
+    }
+    snprintf(buf + n, sizeof(buf) - n, "e%ld", exp);
+    return strtod(buf, NULL);
+}
+
+int fi_parse_number(const char *in, size_t s_in, size_t *pos, double *out) {
+    size_t i = *pos;
+    uint64_t m = 0;
+    int n_dig = 0;
+    int exp = 0;
+    bool neg = false;
+    bool digits = false;
+    bool point = false;
+    bool truncated = false;
+
+    if (i < s_in && (in[i] == '+' || in[i] == '-'))
+        neg = in[i++] == '-';
+    for (; i < s_in; i++) {
+        // a second point starts the next number (".5.5")
+        if (in[i] == '.' && !point) {
+            point = true;
+            continue;
+        }
+        if (in[i] < '0' || in[i] > '9')
+            break;
+        digits = true;
+        int d = in[i] - '0';
+        if (m == 0 && d == 0) {
+            exp -= point;
+        } else if (n_dig < 19) {
+            m = m * 10 + d;
+            n_dig++;
+            exp -= point;
+        } else {
+            truncated |= d != 0;
+            exp += !point;
+        }
+    }
+    if (!digits)
+        return ERR_PARSING_FAIL;
+    // an exponent needs digits, else the e is not part of the number
+    if (i + 1 < s_in && (in[i] == 'e' || in[i] == 'E')) {
+        size_t j = i + 1;
+        if (j + 1 < s_in && (in[j] == '+' || in[j] == '-'))
+            j++;
+        if (in[j] >= '0' && in[j] <= '9') {
+            i++;
+            exp += fi_parse_exponent(in, s_in, &i);
+        }
+    }
+
+    if (m == 0) {
+        *out = neg ? -0.0 : 0.0;
+    } else if (!truncated && m <= (1ULL << 53) && exp >= -22 && exp <= 22) {
+        // both are exact, the result is correctly rounded
+        double v = (double)m;
+        v = exp < 0 ? v / fi_pow10[-exp] : v * fi_pow10[exp];
+        *out = neg ? -v : v;
+    } else {
+        *out = fi_parse_number_slow(in, s_in, *pos);
+    }
+    *pos = i;
+    return 0;
+}
+
+void fi_parse_init(FI_PARSE_STATE *st) {
+    memset(st, 0, sizeof(FI_PARSE_STATE));
+}
+
+int fi_parse_emit(FI_PARSE_STATE *st, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                  FI_POINT_D *pt) {
+    if (st->cb != NULL)
+        return st->cb(type, flag, pt, st->data);
+    bool first = st->path == NULL;
+    int ret = fi_append_new_seg(&st->path, type);
+    if (ret)
+        return ret;
+    if (first && st->reserve > 0 && st->path->meta->arena != NULL)
+        fi_reserve_path(&st->path, st->reserve);
+    FI_PATH *seg = st->path->meta->last;
+    seg->section.flag = flag;
+    if (seg->section.n_point)
+        memcpy(seg->section.points, pt,
+               seg->section.n_point * sizeof(FI_POINT_D));
+    return 0;
+}
+
+int fi_parse_flush(FI_PARSE_STATE *st) {
+    int ret = 0;
+    // missing arguments are 0
+    while (st->n_arg && ret == 0)
+        ret = fi_parse_argument(st, 0);
+    // a command without arguments still gives a segment
+    if (st->pending && ret == 0) {
+        FI_POINT_D pt[3] = {{0}};
+        ret = fi_parse_emit(st, fi_cmd_type(st->cmd), 0, pt);
+    }
+    st->pending = false;
+    return ret;
+}
+
+int fi_parse_command(FI_PARSE_STATE *st, char c) {
+    int ret = fi_parse_flush(st);
+    if (ret)
+        return ret;
+    st->cmd = c;
+    st->pending = true;
+    if (fi_cmd_arity(c) == 0) {
+        st->pending = false;
+        st->cur = st->start;
+        st->prev = 'Z';
+        return fi_parse_emit(st, FI_SEG_END, 0, NULL);
+    }
+    return 0;
+}
+
+/* reflection of the last control point if the previous segment is of the
+ * same kind
+ */
+FI_POINT_D fi_parse_reflect(FI_PARSE_STATE *st, const char *kinds) {
+    FI_POINT_D p = st->cur;
+    if (st->prev != 0 && strchr(kinds, st->prev) != NULL) {
+        p.x = 2 * st->cur.x - st->ctrl.x;
+        p.y = 2 * st->cur.y - st->ctrl.y;
+    }
+    return p;
+}
+
+int fi_parse_argument(FI_PARSE_STATE *st, double v) {
+    int arity = fi_cmd_arity(st->cmd);
+    // a number needs a command (Z takes none)
+    if (arity <= 0)
+        return ERR_PARSING_FAIL;
+    st->arg[st->n_arg++] = v;
+    if (st->n_arg < arity)
+        return 0;
+    // repeated arguments are implicit repetitions of the command
+    st->n_arg = 0;
+    st->pending = false;
+
+    FI_POINT_D pt[3] = {{0}};
+    FI_SEG_FLAG flag = 0;
+    double *a = st->arg;
+    char cmd = st->cmd;
+    FI_SEG_TYPE type = fi_cmd_type(cmd);
+    FI_POINT_D base = {0, 0};
+    if (cmd >= 'a')
+        base = st->cur;
+
+    switch (cmd | 0x20) {
+    case 'm':
+        pt[0] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        st->start = pt[0];
+        // the next pairs are lines
+        st->cmd = cmd == 'M' ? 'L' : 'l';
+        break;
+    case 'l':
+        pt[0] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        break;
+    case 'h':
+        pt[0] = (FI_POINT_D){base.x + a[0], st->cur.y};
+        break;
+    case 'v':
+        pt[0] = (FI_POINT_D){st->cur.x, base.y + a[0]};
+        break;
+    case 'c':
+        pt[0] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        pt[1] = (FI_POINT_D){base.x + a[2], base.y + a[3]};
+        pt[2] = (FI_POINT_D){base.x + a[4], base.y + a[5]};
+        st->ctrl = pt[1];
+        break;
+    case 's':
+        pt[0] = fi_parse_reflect(st, "CS");
+        pt[1] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        pt[2] = (FI_POINT_D){base.x + a[2], base.y + a[3]};
+        st->ctrl = pt[1];
+        break;
+    case 'q':
+        pt[0] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        pt[1] = (FI_POINT_D){base.x + a[2], base.y + a[3]};
+        st->ctrl = pt[0];
+        break;
+    case 't':
+        pt[0] = fi_parse_reflect(st, "QT");
+        pt[1] = (FI_POINT_D){base.x + a[0], base.y + a[1]};
+        st->ctrl = pt[0];
+        break;
+    case 'a':
+        pt[0] = (FI_POINT_D){a[0], a[1]};
+        pt[1] = (FI_POINT_D){a[2], 0};
+        pt[2] = (FI_POINT_D){base.x + a[5], base.y + a[6]};
+        flag = (a[3] != 0 ? FI_LARGE_ARC : 0) | (a[4] != 0 ? FI_SWEEP : 0);
+        break;
+    }
+    st->cur = pt[fi_seg_n_point(type) - 1];
+    st->prev = cmd & ~0x20;
+    return fi_parse_emit(st, type, flag, pt);
+}
+
+bool fi_parse_is_separator(char c) {
+    return c == ' ' || c == ',' || c == '\n' || c == '\r' || c == '\t' ||
+           c == '\f';
+}
+
+bool fi_parse_is_number(char c) {
+    return (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '+' ||
+           c == 'e' || c == 'E';
+}
+
+int fi_parse_chunk(FI_PARSE_STATE *st, const char *in, size_t s_in) {
+    int ret = 0;
+    size_t i = 0;
+
+    while (ret == 0) {
+        while (i < s_in && fi_parse_is_separator(in[i]))
+            i++;
+        if (i >= s_in)
+            break;
+        if (fi_cmd_arity(in[i]) >= 0) {
+            ret = fi_parse_command(st, in[i++]);
+            continue;
+        }
+        double v;
+        // the flags of an arc are single digits ("1120,20")
+        if ((st->cmd | 0x20) == 'a' && (st->n_arg == 3 || st->n_arg == 4)) {
+            if (in[i] != '0' && in[i] != '1')
+                return ERR_PARSING_FAIL;
+            v = in[i++] - '0';
+        } else {
+            ret = fi_parse_number(in, s_in, &i, &v);
+            if (ret)
+                break;
+        }
+        ret = fi_parse_argument(st, v);
+    }
+    return ret;
+}
+
+int fi_parse_path(const char *in, int s_in, FI_PATH **out) {
+    FI_PARSE_STATE st;
+
+    *out = NULL;
+    fi_parse_init(&st);
+    st.reserve = s_in / FI_PARSE_CHARS_PER_SEG;
+    int ret = fi_parse_chunk(&st, in, s_in);
+    if (ret == 0)
+        ret = fi_parse_flush(&st);
+    if (ret) {
+        fi_free_path(st.path);
+        return ret;
+    }
+    *out = st.path;
+    return 0;
+}
+
+FI_PARSER *fi_parser_new(FI_PARSER_CB cb, void *data) {
+    FI_PARSER *parser = calloc(1, sizeof(FI_PARSER));
+    fi_parse_init(&parser->st);
+    parser->st.cb = cb;
+    parser->st.data = data;
+    return parser;
+}
+
+/* keep the characters of a number which may continue in the next chunk */
+void fi_parser_stash(FI_PARSER *parser, const char *in, size_t n) {
+    if (n == 0)
+        return;
+    if (parser->n_tok + n > parser->s_tok) {
+        parser->s_tok = (parser->n_tok + n) * 2;
+        parser->tok = realloc(parser->tok, parser->s_tok);
+    }
+    memcpy(parser->tok + parser->n_tok, in, n);
+    parser->n_tok += n;
+}
+
+int fi_parser_feed(FI_PARSER *parser, const char *in, size_t s_in) {
+    size_t i = 0;
+    if (parser->err)
+        return parser->err;
+
+    // end of a number started in a previous chunk
+    if (parser->n_tok) {
+        while (i < s_in && fi_parse_is_number(in[i]))
+            i++;
+        fi_parser_stash(parser, in, i);
+        if (i == s_in)
+            return 0;
+        parser->err = fi_parse_chunk(&parser->st, parser->tok, parser->n_tok);
+        parser->n_tok = 0;
+        if (parser->err)
+            return parser->err;
+    }
+
+    // the trailing number characters may continue in the next chunk
+    size_t end = s_in;
+    while (end > i && fi_parse_is_number(in[end - 1]))
+        end--;
+    parser->err = fi_parse_chunk(&parser->st, in + i, end - i);
+    if (parser->err == 0)
+        fi_parser_stash(parser, in + end, s_in - end);
+    return parser->err;
+}
+
+int fi_parser_finish(FI_PARSER *parser, FI_PATH **out) {
+    *out = NULL;
+    if (parser->err == 0 && parser->n_tok)
+        parser->err = fi_parse_chunk(&parser->st, parser->tok, parser->n_tok);
+    parser->n_tok = 0;
+    if (parser->err == 0)
+        parser->err = fi_parse_flush(&parser->st);
+    if (parser->err == 0) {
+        *out = parser->st.path;
+        parser->st.path = NULL;
+    }
+    return parser->err;
+}
+
+void fi_parser_free(FI_PARSER *parser) {
+    if (parser == NULL)
+        return;
+    fi_free_path(parser->st.path);
+    free(parser->tok);
+    free(parser);
+}
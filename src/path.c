@@ -13,172 +13,96 @@
 #include "ficlip.h"
 #include "ficlip-private.h"
 
+void fi_free_seg(FI_META *meta, FI_PATH *seg) {
+    // segments of an arena are released with the whole path
+    if (meta != NULL && meta->arena != NULL)
+        return;
+    FI_PACKED_PATH *packed = meta != NULL ? meta->packed : NULL;
+    // points and nodes of a view belong to its packed path and node block
+    if (seg->section.points != NULL &&
+        (packed == NULL || seg->section.points < packed->points ||
+         seg->section.points >= packed->points + packed->n_point))
+        free(seg->section.points);
+    if (packed == NULL || seg < meta->nodes ||
+        seg >= meta->nodes + packed->n_seg)
+        free(seg);
+}
+
 void fi_free_path(FI_PATH *path) {
     FI_PATH *tmp = NULL;
     FI_META *meta = NULL;
     if (path != NULL) {
         meta = path->meta;
     }
+    if (meta != NULL && meta->arena != NULL) {
+        // no need to walk the segments
+        fi_arena_free(meta->arena);
+        free(meta->arena);
+        path = NULL;
+    }
     while (path != NULL) {
         tmp = path;
         path = path->next;
-        if (tmp->section.points != NULL)
-            free(tmp->section.points);
-        free(tmp);
+        fi_free_seg(meta, tmp);
     }
-    if (meta != NULL)
+    if (meta != NULL) {
+        free(meta->nodes);
         free(meta);
-}
-
-double fi_angle_vect(FI_POINT_D a, FI_POINT_D b) {
-    double ret;
-    double sign = 1;
-    ret = acos((a.x * b.x + a.y * b.y) / (sqrt(pow(a.x, 2) + pow(a.y, 2)) *
-                                          sqrt(pow(b.x, 2) + pow(b.y, 2))));
-    if ((a.x * b.y - a.y * b.x) < 0)
-        sign = -1;
-    return sign * ret;
-}
-
-// converts endpoints definition of arc to center defition for elliptic arc
-FI_PARAM_ARC fi_arc_endpoint_to_center(FI_POINT_D s, FI_POINT_D e, FI_POINT_D r,
-                                       double phi, FI_SEG_FLAG flag) {
-    // https://www.w3.org/TR/SVG/implnote.html#ArcConversionEndpointToCenter
-    int fa = 0;
-    phi *= D2R;
-    if (flag & FI_LARGE_ARC)
-        fa = 1;
-    int fs = 0;
-    if (flag & FI_SWEEP)
-        fs = 1;
-
-    FI_PARAM_ARC ret = {0};
-
-    FI_POINT_D p1;
-    p1.x = cos(phi) * (s.x - e.x) / 2 + sin(phi) * (s.y - e.y) / 2;
-    p1.y = -1.0 * sin(phi) * (s.x - e.x) / 2 + cos(phi) * (s.y - e.y) / 2;
-    double delta = pow(p1.x, 2) / pow(r.x, 2) + pow(p1.y, 2) / pow(r.y, 2);
-    if (delta > 1) {
-        r.x = sqrt(delta) * r.x;
-        r.y = sqrt(delta) * r.y;
     }
-
-    double coef =
-        sqrt((pow(r.x, 2) * pow(r.y, 2) - pow(r.x, 2) * pow(p1.y, 2) -
-              pow(r.y, 2) * pow(p1.x, 2)) /
-             (pow(r.x, 2) * pow(p1.y, 2) + pow(r.y, 2) * pow(p1.x, 2)));
-    FI_POINT_D cp;
-    double sign = 1;
-    if (fa == fs)
-        sign = -1;
-    cp.x = sign * coef * r.x * p1.y / r.y;
-    cp.y = sign * coef * r.y * p1.x / r.x * -1;
-
-    ret.center.x = cos(phi) * cp.x - sin(phi) * cp.y + (s.x + e.x) / 2;
-    ret.center.y = sin(phi) * cp.x + cos(phi) * cp.y + (s.y + e.y) / 2;
-
-    FI_POINT_D t1;
-    FI_POINT_D t2;
-
-    t1.x = 1;
-    t1.y = 0;
-    t2.x = (p1.x - cp.x) / r.x;
-    t2.y = (p1.y - cp.y) / r.y;
-    ret.angle_s = fi_angle_vect(t1, t2);
-
-    t1.x = (p1.x - cp.x) / r.x;
-    t1.y = (p1.y - cp.y) / r.y;
-    t2.x = (-p1.x - cp.x) / r.x;
-    t2.y = (-p1.y - cp.y) / r.y;
-    ret.angle_d = fi_angle_vect(t1, t2);
-    if (fs == 0) {
-        if (ret.angle_d > 0) {
-            ret.angle_d -= 2 * M_PI;
-        }
-    } else {
-        if (ret.angle_d < 0) {
-            ret.angle_d += 2 * M_PI;
-        }
-    }
-
-    ret.angle_s *= R2D;
-    ret.angle_d *= R2D;
-    ret.phi = phi * R2D;
-    ret.radius.x = r.x;
-    ret.radius.y = r.y;
-    return ret;
 }
 
-// converts one arc to segments
-void fi_arc_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_SEG_FLAG flag,
-                     FI_PATH **out) {
-    FI_POINT_D s = ref;
-    FI_POINT_D r = in[0];
-    FI_POINT_D e = in[2];
-    double phi = in[1].x;
-    if (r.x == 0 || r.y == 0) {
-        fi_append_new_seg(out, FI_SEG_LINE);
-        (*out)->section.points[0].x = e.x;
-        (*out)->section.points[0].y = e.y;
-        return;
-    }
-    FI_PARAM_ARC param = fi_arc_endpoint_to_center(s, e, r, phi, flag);
-    double angle = 0;
-    double cos_phi = cos(param.phi * D2R);
-    double sin_phi = sin(param.phi * D2R);
-    for (int i = 0; i <= ARC_RES; i++) {
-        fi_append_new_seg(out, FI_SEG_LINE);
-        angle = param.angle_s * D2R +
-                (double)i / (double)ARC_RES * param.angle_d * D2R;
-        FI_POINT_D t1;
-        t1.x = cos(angle) * param.radius.x;
-        t1.y = sin(angle) * param.radius.y;
-        (*out)->meta->last->section.points[0].x =
-            t1.x * cos_phi - t1.y * sin_phi + param.center.x;
-        (*out)->meta->last->section.points[0].y =
-            t1.x * sin_phi + t1.y * cos_phi + param.center.y;
-    }
-    return;
+// Wang's formula: n segments keep the chords of a bezier curve of degree d
+// within tol of the curve if
+// n >= sqrt(d * (d - 1) / (8 * tol) * max |P(i) - 2 * P(i+1) + P(i+2)|)
+int fi_bezier_n_seg(FI_POINT_D *p, int degree, double tolerance) {
+    if (tolerance <= 0)
+        return BEZIER_RES;
+    double m = 0;
+    for (int i = 0; i + 2 <= degree; i++)
+        m = fmax(m, hypot(p[i].x - 2 * p[i + 1].x + p[i + 2].x,
+                          p[i].y - 2 * p[i + 1].y + p[i + 2].y));
+    double n = ceil(sqrt(degree * (degree - 1) * m / (8 * tolerance)));
+    if (!(n >= 1))
+        return 1;
+    if (n > BEZIER_MAX_SEG)
+        return BEZIER_MAX_SEG;
+    return (int)n;
 }
 
-// converts one cubic bezier curve to segments
-void fi_cub_bezier_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_PATH **out) {
-    FI_POINT_D P0 = ref;
-    FI_POINT_D P1 = in[0];
-    FI_POINT_D P2 = in[1];
-    FI_POINT_D P3 = in[2];
-
-    for (int i = 0; i <= BEZIER_RES; i++) {
-        fi_append_new_seg(out, FI_SEG_LINE);
-        double t = (double)i / BEZIER_RES;
-        (*out)->meta->last->section.points[0].x =
-            CUB_BEZIER_POINT(P0, P1, P2, P3, x, t);
-        (*out)->meta->last->section.points[0].y =
-            CUB_BEZIER_POINT(P0, P1, P2, P3, y, t);
+int fi_bezier_flatten(FI_POINT_D ref, FI_POINT_D *in, int degree,
+                      double tolerance, FI_POINT_D **buf, int *s_buf) {
+    FI_POINT_D p[4] = {ref, in[0], in[1], degree == 3 ? in[2] : in[1]};
+    int n = fi_bezier_n_seg(p, degree, tolerance);
+    if (n + 1 > *s_buf) {
+        *s_buf = n + 1 > BEZIER_RES + 1 ? n + 1 : BEZIER_RES + 1;
+        *buf = realloc(*buf, *s_buf * sizeof(FI_POINT_D));
     }
-    // fi_draw_path(*out, stdout);
-    return;
+    // the fixed resolution mode also emits the start point
+    int first = tolerance <= 0 ? 0 : 1;
+    if (degree == 3)
+        fi_cub_bezier_points(ref, in, n, first, *buf);
+    else
+        fi_qua_bezier_points(ref, in, n, first, *buf);
+    return n + 1 - first;
 }
 
-void fi_qua_bezier_to_lines(FI_POINT_D ref, FI_POINT_D *in, FI_PATH **out) {
-    FI_POINT_D P0 = ref;
-    FI_POINT_D P1 = in[0];
-    FI_POINT_D P2 = in[1];
-
-    for (int i = 0; i <= BEZIER_RES; i++) {
+// appends a series of line segments
+void fi_append_lines(FI_POINT_D *pts, int n, FI_PATH **out) {
+    for (int i = 0; i < n; i++) {
         fi_append_new_seg(out, FI_SEG_LINE);
-        double t = (double)i / BEZIER_RES;
-        (*out)->meta->last->section.points[0].x =
-            QUA_BEZIER_POINT(P0, P1, P2, x, t);
-        (*out)->meta->last->section.points[0].y =
-            QUA_BEZIER_POINT(P0, P1, P2, y, t);
+        (*out)->meta->last->section.points[0] = pts[i];
     }
-    // fi_draw_path(*out, stdout);
-    return;
 }
 
 void fi_linearize(FI_PATH **in) {
+    fi_linearize_tolerance(in, 0);
+}
+
+void fi_linearize_tolerance(FI_PATH **in, double tolerance) {
     FI_PATH *tmp = *in;
+    FI_POINT_D *buf = NULL;
+    int s_buf = 0;
+    int n;
     FI_POINT_D last_ref_point;
     last_ref_point.x = 0;
     last_ref_point.y = 0;
@@ -206,19 +130,25 @@ void fi_linearize(FI_PATH **in) {
             last_ref_point.y = pt[0].y;
             break;
         case FI_SEG_ARC:
-            fi_arc_to_lines(last_ref_point, pt, flag, &new_seg);
-            last_ref_point.x = pt[1].x;
-            last_ref_point.y = pt[1].y;
+            n = fi_arc_flatten(last_ref_point, pt, flag, tolerance, &buf,
+                               &s_buf);
+            fi_append_lines(buf, n, &new_seg);
+            last_ref_point.x = pt[2].x;
+            last_ref_point.y = pt[2].y;
             fi_replace_path(&tmp, new_seg);
             break;
         case FI_SEG_QUA_BEZIER:
-            fi_qua_bezier_to_lines(last_ref_point, pt, &new_seg);
+            n = fi_bezier_flatten(last_ref_point, pt, 2, tolerance, &buf,
+                                  &s_buf);
+            fi_append_lines(buf, n, &new_seg);
             last_ref_point.x = pt[1].x;
             last_ref_point.y = pt[1].y;
             fi_replace_path(&tmp, new_seg);
             break;
         case FI_SEG_CUB_BEZIER:
-            fi_cub_bezier_to_lines(last_ref_point, pt, &new_seg);
+            n = fi_bezier_flatten(last_ref_point, pt, 3, tolerance, &buf,
+                                  &s_buf);
+            fi_append_lines(buf, n, &new_seg);
             last_ref_point.x = pt[2].x;
             last_ref_point.y = pt[2].y;
             fi_replace_path(&tmp, new_seg);
@@ -228,6 +158,73 @@ void fi_linearize(FI_PATH **in) {
             *in = tmp;
         tmp = next;
     }
+    free(buf);
+}
+
+// number of segments of the linearized path, exact for the fixed resolution
+size_t fi_linearize_n_seg(FI_META *meta, double tolerance) {
+    size_t n_bez = meta->n_qbez + meta->n_cbez;
+    size_t n = meta->n_end + meta->n_move + meta->n_line;
+    if (tolerance <= 0)
+        return n + n_bez * (BEZIER_RES + 1) + meta->n_arc * (ARC_RES + 1);
+    return n + (n_bez + meta->n_arc) * LINEARIZE_EST_SEG;
+}
+
+int fi_linearize_to(FI_PATH *in, double tolerance, FI_PATH **out) {
+    FI_POINT_D *buf = NULL;
+    int s_buf = 0;
+    int n = 0;
+    FI_POINT_D last_ref_point = {0};
+
+    *out = NULL;
+    if (in == NULL)
+        return 0;
+
+    // all the segments in one arena, sized for the whole output
+    FI_META *meta = calloc(1, sizeof(FI_META));
+    meta->arena = malloc(sizeof(FI_ARENA));
+    fi_arena_init(meta->arena, fi_linearize_n_seg(in->meta, tolerance) *
+                                   FI_SEG_SIZE(1));
+
+    for (FI_PATH *tmp = in; tmp != NULL; tmp = tmp->next) {
+        FI_SEG_TYPE type = tmp->section.type;
+        FI_SEG_FLAG flag = tmp->section.flag;
+        FI_POINT_D *pt = tmp->section.points;
+        switch (type) {
+        case FI_SEG_END:
+        case FI_SEG_MOVE:
+        case FI_SEG_LINE:
+            fi_push_seg(meta, type, flag, pt);
+            n = 0;
+            break;
+        case FI_SEG_ARC:
+            n = fi_arc_flatten(last_ref_point, pt, flag, tolerance, &buf,
+                               &s_buf);
+            break;
+        case FI_SEG_QUA_BEZIER:
+            n = fi_bezier_flatten(last_ref_point, pt, 2, tolerance, &buf,
+                                  &s_buf);
+            break;
+        case FI_SEG_CUB_BEZIER:
+            n = fi_bezier_flatten(last_ref_point, pt, 3, tolerance, &buf,
+                                  &s_buf);
+            break;
+        }
+        for (int i = 0; i < n; i++)
+            fi_push_seg(meta, FI_SEG_LINE, 0, &buf[i]);
+        // the end point of a segment is always its last point
+        if (tmp->section.n_point > 0)
+            last_ref_point = pt[tmp->section.n_point - 1];
+        else
+            last_ref_point = (FI_POINT_D){0};
+    }
+    free(buf);
+
+    meta->n_max = in->meta->n_max;
+    if (meta->n_max > 0 && meta->n_max < meta->n_total)
+        meta->n_max = meta->n_total;
+    *out = meta->first;
+    return 0;
 }
 
 void fi_replace_path(FI_PATH **old, FI_PATH *new) {
@@ -259,160 +256,325 @@ void fi_replace_path(FI_PATH **old, FI_PATH *new) {
     }
     tmp->meta = old_tmp->meta;
 
-    // isolate the old point
-    old_tmp->next = NULL;
-    old_tmp->meta = NULL;
+    // remove the old point from the counters
+    FI_META *meta = new->meta;
+    meta->n_total--;
+    meta->bbox_valid = false;
+    meta->convex_valid = false;
+    switch (old_tmp->section.type) {
+    case FI_SEG_END:
+        meta->n_end--;
+        break;
+    case FI_SEG_MOVE:
+        meta->n_move--;
+        break;
+    case FI_SEG_LINE:
+        meta->n_line--;
+        break;
+    case FI_SEG_ARC:
+        meta->n_arc--;
+        break;
+    case FI_SEG_QUA_BEZIER:
+        meta->n_qbez--;
+        break;
+    case FI_SEG_CUB_BEZIER:
+        meta->n_cbez--;
+        break;
+    }
 
     // free the old point
-    fi_free_path(old_tmp);
-
-    new->meta->n_total += tmp_meta->n_total - 1;
-    new->meta->n_end += tmp_meta->n_end - 1;
-    new->meta->n_move += tmp_meta->n_move - 1;
-    new->meta->n_line += tmp_meta->n_line - 1;
-    new->meta->n_arc += tmp_meta->n_arc - 1;
-    new->meta->n_qbez += tmp_meta->n_qbez - 1;
-    new->meta->n_cbez += tmp_meta->n_cbez - 1;
+    fi_free_seg(old_tmp->meta, old_tmp);
+
+    // the inserted segments now belong to the host path
+    if (tmp_meta->arena != NULL) {
+        if (meta->arena == NULL) {
+            meta->arena = tmp_meta->arena;
+        } else {
+            fi_arena_merge(meta->arena, tmp_meta->arena);
+            free(tmp_meta->arena);
+        }
+    }
+
+    meta->n_total += tmp_meta->n_total;
+    meta->n_end += tmp_meta->n_end;
+    meta->n_move += tmp_meta->n_move;
+    meta->n_line += tmp_meta->n_line;
+    meta->n_arc += tmp_meta->n_arc;
+    meta->n_qbez += tmp_meta->n_qbez;
+    meta->n_cbez += tmp_meta->n_cbez;
     // free the new path meta (it's using the old one now)
     free(tmp_meta);
 
     return;
 }
 
-void fi_copy_path(FI_PATH *in, FI_PATH **out) {
-    FI_PATH *tmp = in;
-    FI_PATH *out_current = NULL;
-    while (tmp != NULL) {
+void fi_append_copy(FI_PATH *in, FI_PATH *end, FI_PATH **out) {
+    bool whole = *out == NULL && end == NULL;
+    for (FI_PATH *tmp = in; tmp != end; tmp = tmp->next) {
         FI_SEG_TYPE type = tmp->section.type;
-        FI_SEG_FLAG flag = tmp->section.flag;
-        FI_POINT_D *pt = tmp->section.points;
-        fi_append_new_seg(&out_current, type);
-        switch (type) {
-        case FI_SEG_END:
-            break;
-        case FI_SEG_MOVE:
-            out_current->meta->last->section.points[0] = pt[0];
-            break;
-        case FI_SEG_LINE:
-            out_current->meta->last->section.points[0] = pt[0];
-            break;
-        case FI_SEG_ARC:
-            out_current->meta->last->section.points[0] = pt[0];
-            out_current->meta->last->section.points[1] = pt[1];
-            out_current->meta->last->section.points[2] = pt[2];
-            out_current->meta->last->section.flag = flag;
-            break;
-        case FI_SEG_QUA_BEZIER:
-            out_current->meta->last->section.points[0] = pt[0];
-            out_current->meta->last->section.points[1] = pt[1];
-            break;
-        case FI_SEG_CUB_BEZIER:
-            out_current->meta->last->section.points[0] = pt[0];
-            out_current->meta->last->section.points[1] = pt[1];
-            out_current->meta->last->section.points[2] = pt[2];
-            break;
+        fi_append_new_seg(out, type);
+        // storage for the whole copy
+        if (tmp == in && whole && (*out)->meta->arena != NULL)
+            fi_meta_reserve((*out)->meta, fi_meta_size(in->meta));
+        FI_PATH *last = (*out)->meta->last;
+        last->section.flag = tmp->section.flag;
+        if (last->section.n_point)
+            memcpy(last->section.points, tmp->section.points,
+                   last->section.n_point * sizeof(FI_POINT_D));
+    }
+}
+
+int fi_points_path(FI_POINT_D *pts, size_t *rings, size_t n_ring,
+                   FI_PATH **out) {
+    FI_PATH *path = NULL;
+    int ret = 0;
+    for (size_t r = 0; r < n_ring && !ret; r++) {
+        for (size_t i = rings[r]; i < rings[r + 1] && !ret; i++) {
+            bool first = path == NULL;
+            FI_SEG_TYPE type = i == rings[r] ? FI_SEG_MOVE : FI_SEG_LINE;
+            ret = fi_append_new_seg(&path, type);
+            // one segment per point and per ring
+            if (first && !ret && path->meta->arena != NULL)
+                fi_reserve_path(&path, rings[n_ring] + n_ring);
+            if (!ret)
+                path->meta->last->section.points[0] = pts[i];
         }
-        tmp = tmp->next;
+        if (!ret)
+            ret = fi_append_new_seg(&path, FI_SEG_END);
+    }
+    if (ret) {
+        fi_free_path(path);
+        return ret;
+    }
+    *out = path;
+    return 0;
+}
+
+void fi_copy_path(FI_PATH *in, FI_PATH **out) {
+    FI_PATH *out_current = NULL;
+    fi_append_copy(in, NULL, &out_current);
+    // same points, same box and convexity
+    if (out_current != NULL && in == in->meta->first) {
+        FI_META *meta = out_current->meta;
+        memcpy(meta->bbox, in->meta->bbox, sizeof(in->meta->bbox));
+        meta->bbox_valid = in->meta->bbox_valid;
+        meta->convex = in->meta->convex;
+        meta->convex_valid = in->meta->convex_valid;
     }
     (*out) = out_current;
 }
 
+void fi_offset_seg(FI_SEG_TYPE type, FI_POINT_D *points, FI_POINT_D pt) {
+    switch (type) {
+    case FI_SEG_END:
+        break;
+    case FI_SEG_MOVE:
+        points[0].x += pt.x;
+        points[0].y += pt.y;
+        break;
+    case FI_SEG_LINE:
+        points[0].x += pt.x;
+        points[0].y += pt.y;
+        break;
+    case FI_SEG_ARC:
+        points[2].x += pt.x;
+        points[2].y += pt.y;
+        break;
+    case FI_SEG_QUA_BEZIER:
+        points[0].x += pt.x;
+        points[0].y += pt.y;
+        points[1].x += pt.x;
+        points[1].y += pt.y;
+        break;
+    case FI_SEG_CUB_BEZIER:
+        points[0].x += pt.x;
+        points[0].y += pt.y;
+        points[1].x += pt.x;
+        points[1].y += pt.y;
+        points[2].x += pt.x;
+        points[2].y += pt.y;
+        break;
+    }
+}
+
 void fi_offset_path(FI_PATH *in, FI_POINT_D pt) {
     FI_PATH *tmp = in;
+    if (in == NULL)
+        return;
+    // the box of a whole path moves with it, its shape does not change
+    FI_META *meta = in->meta;
+    if (in == meta->first && meta->bbox_valid) {
+        fi_offset_seg(FI_SEG_MOVE, &meta->bbox[0], pt);
+        fi_offset_seg(FI_SEG_MOVE, &meta->bbox[1], pt);
+    } else {
+        meta->bbox_valid = false;
+    }
+    if (in != meta->first)
+        meta->convex_valid = false;
     while (tmp != NULL) {
-        FI_SEG_TYPE type = tmp->section.type;
-        switch (type) {
-        case FI_SEG_END:
-            break;
-        case FI_SEG_MOVE:
-            tmp->section.points[0].x += pt.x;
-            tmp->section.points[0].y += pt.y;
-            break;
-        case FI_SEG_LINE:
-            tmp->section.points[0].x += pt.x;
-            tmp->section.points[0].y += pt.y;
-            break;
-        case FI_SEG_ARC:
-            tmp->section.points[2].x += pt.x;
-            tmp->section.points[2].y += pt.y;
-            break;
-        case FI_SEG_QUA_BEZIER:
-            tmp->section.points[0].x += pt.x;
-            tmp->section.points[0].y += pt.y;
-            tmp->section.points[1].x += pt.x;
-            tmp->section.points[1].y += pt.y;
-            break;
-        case FI_SEG_CUB_BEZIER:
-            tmp->section.points[0].x += pt.x;
-            tmp->section.points[0].y += pt.y;
-            tmp->section.points[1].x += pt.x;
-            tmp->section.points[1].y += pt.y;
-            tmp->section.points[2].x += pt.x;
-            tmp->section.points[2].y += pt.y;
-            break;
-        }
+        fi_offset_seg(tmp->section.type, tmp->section.points, pt);
         tmp = tmp->next;
     }
 }
 
-int fi_append_new_seg(FI_PATH **path, FI_SEG_TYPE type) {
-    FI_PATH *new_path = calloc(1, sizeof(FI_PATH));
-    FI_POINT_D *new_seg;
-    int n_point = 0;
-    if (*path == NULL || (*path)->meta == NULL) {
-        *path = new_path;
-        (*path)->meta = calloc(sizeof(FI_META), 1);
-        new_path->meta->last = new_path;
-        new_path->meta->first = new_path;
-        new_path->meta->n_max = DEFAULT_MAX_PATH_LENGTH;
+int fi_seg_n_point(FI_SEG_TYPE type) {
+    switch (type) {
+    case FI_SEG_END:
+        return 0;
+    case FI_SEG_MOVE:
+    case FI_SEG_LINE:
+        return 1;
+    case FI_SEG_QUA_BEZIER:
+        return 2;
+    case FI_SEG_ARC:
+    case FI_SEG_CUB_BEZIER:
+        return 3;
+    }
+    return 0;
+}
+
+/* allocate a segment and its points */
+FI_PATH *fi_new_seg(FI_META *meta, int n_point) {
+    FI_PATH *seg;
+#ifdef FI_PATH_ARENA
+    if (meta->arena == NULL) {
+        meta->arena = malloc(sizeof(FI_ARENA));
+        fi_arena_init(meta->arena, FI_PATH_ARENA_BLOCK_SIZE);
+    }
+#endif
+    if (meta->arena != NULL) {
+        // the points directly follow their segment
+        seg = fi_arena_alloc(meta->arena, FI_SEG_SIZE(n_point));
+        if (n_point)
+            seg->section.points = (FI_POINT_D *)(seg + 1);
     } else {
-        if ((*path)->meta->n_total >= (*path)->meta->n_max) {
-            free(new_path);
-            return ERR_PATH_TOO_LONG;
-        }
-        (*path)->meta->last->next = new_path;
-        new_path->prev = (*path)->meta->last;
-        (*path)->meta->last = new_path;
-        new_path->meta = (*path)->meta;
+        seg = calloc(1, sizeof(FI_PATH));
+        if (n_point)
+            seg->section.points = calloc(n_point, sizeof(FI_POINT_D));
     }
-    new_path->meta->n_total += 1;
+    seg->meta = meta;
+    return seg;
+}
+
+void fi_meta_count(FI_META *meta, FI_SEG_TYPE type) {
+    meta->n_total += 1;
+    meta->bbox_valid = false;
+    meta->convex_valid = false;
     switch (type) {
     case FI_SEG_END:
-        new_seg = NULL;
-        new_path->meta->n_end += 1;
-        n_point = 0;
+        meta->n_end += 1;
         break;
     case FI_SEG_MOVE:
-        new_seg = calloc(1, sizeof(FI_POINT_D));
-        new_path->meta->n_move += 1;
-        n_point = 1;
+        meta->n_move += 1;
         break;
     case FI_SEG_LINE:
-        new_seg = calloc(1, sizeof(FI_POINT_D));
-        new_path->meta->n_line += 1;
-        n_point = 1;
+        meta->n_line += 1;
         break;
     case FI_SEG_ARC:
-        new_seg = calloc(3, sizeof(FI_POINT_D));
-        new_path->meta->n_arc += 1;
-        n_point = 3;
+        meta->n_arc += 1;
         break;
     case FI_SEG_QUA_BEZIER:
-        new_seg = calloc(2, sizeof(FI_POINT_D));
-        new_path->meta->n_qbez += 1;
-        n_point = 2;
+        meta->n_qbez += 1;
         break;
     case FI_SEG_CUB_BEZIER:
-        new_seg = calloc(3, sizeof(FI_POINT_D));
-        new_path->meta->n_cbez += 1;
-        n_point = 3;
-        break;
-    default:
-        new_seg = NULL;
+        meta->n_cbez += 1;
         break;
     }
-    new_path->section.points = new_seg;
+}
+
+FI_PATH *fi_push_seg(FI_META *meta, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                     FI_POINT_D *pt) {
+    int n_point = fi_seg_n_point(type);
+    FI_PATH *seg = fi_new_seg(meta, n_point);
+    seg->section.type = type;
+    seg->section.flag = flag;
+    seg->section.n_point = n_point;
+    if (n_point)
+        memcpy(seg->section.points, pt, n_point * sizeof(FI_POINT_D));
+    if (meta->last == NULL) {
+        meta->first = seg;
+    } else {
+        meta->last->next = seg;
+        seg->prev = meta->last;
+    }
+    meta->last = seg;
+    fi_meta_count(meta, type);
+    return seg;
+}
+
+int fi_append_new_seg(FI_PATH **path, FI_SEG_TYPE type) {
+    FI_PATH *new_path;
+    FI_META *meta;
+    int n_point = fi_seg_n_point(type);
+    if (*path == NULL || (*path)->meta == NULL) {
+        meta = calloc(sizeof(FI_META), 1);
+        meta->n_max = DEFAULT_MAX_PATH_LENGTH;
+        new_path = fi_new_seg(meta, n_point);
+        *path = new_path;
+        meta->last = new_path;
+        meta->first = new_path;
+    } else {
+        meta = (*path)->meta;
+        if (meta->n_max > 0 && meta->n_total >= meta->n_max)
+            return ERR_PATH_TOO_LONG;
+        new_path = fi_new_seg(meta, n_point);
+        meta->last->next = new_path;
+        new_path->prev = meta->last;
+        meta->last = new_path;
+    }
+    fi_meta_count(meta, type);
     new_path->section.type = type;
     new_path->section.n_point = n_point;
     return 0;
 }
+
+size_t fi_meta_size(FI_META *meta) {
+    return meta->n_end * FI_SEG_SIZE(0) +
+           (meta->n_move + meta->n_line) * FI_SEG_SIZE(1) +
+           meta->n_qbez * FI_SEG_SIZE(2) +
+           (meta->n_arc + meta->n_cbez) * FI_SEG_SIZE(3);
+}
+
+void fi_meta_reserve(FI_META *meta, size_t size) {
+    if (meta->arena != NULL) {
+        fi_arena_reserve(meta->arena, size);
+        return;
+    }
+    // the arena owns all the segments of a path, except the nodes of a view
+    FI_ARENA *arena = malloc(sizeof(FI_ARENA));
+    fi_arena_init(arena, FI_PATH_ARENA_BLOCK_SIZE);
+    fi_arena_reserve(arena, fi_meta_size(meta) + size);
+    FI_PACKED_PATH *packed = meta->packed;
+    for (FI_PATH *seg = meta->first; seg != NULL; seg = seg->next) {
+        if (packed != NULL && seg >= meta->nodes &&
+            seg < meta->nodes + packed->n_seg)
+            continue;
+        int n = seg->section.n_point;
+        FI_PATH *copy = fi_arena_alloc(arena, FI_SEG_SIZE(n));
+        *copy = *seg;
+        if (n) {
+            copy->section.points = (FI_POINT_D *)(copy + 1);
+            memcpy(copy->section.points, seg->section.points,
+                   n * sizeof(FI_POINT_D));
+        }
+        if (seg->prev != NULL)
+            seg->prev->next = copy;
+        else
+            meta->first = copy;
+        if (seg->next != NULL)
+            seg->next->prev = copy;
+        else
+            meta->last = copy;
+        fi_free_seg(meta, seg);
+        seg = copy;
+    }
+    meta->arena = arena;
+}
+
+void fi_reserve_path(FI_PATH **path, size_t n_seg) {
+    if (*path == NULL || (*path)->meta == NULL)
+        return;
+    FI_META *meta = (*path)->meta;
+    fi_meta_reserve(meta, n_seg * FI_SEG_SIZE(1));
+    *path = meta->first;
+}
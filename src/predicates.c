@@ -0,0 +1,432 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Orientation and incircle predicates with the sign of the exact result
+ * (J. R. Shewchuk, Adaptive Precision Floating-Point Arithmetic and Fast
+ * Robust Geometric Predicates, 1997). The determinant is first computed with
+ * doubles and returned when it is larger than a bound of its rounding error,
+ * which is almost always the case. Otherwise, it is computed again with
+ * expansions: sums of doubles of increasing magnitude which do not overlap,
+ * and represent a number exactly. An expansion is only as long as needed, and
+ * the orientation is refined in stages, each one stopping when its estimate is
+ * accurate enough. The filter of fi_orient2d() is next to fi_signed_area(), in
+ * clip.c, where the sweep can inline it.
+ */
+
+double fi_two_sum(double a, double b, double *err) {
+    double s = a + b;
+    double bv = s - a;
+    double av = s - bv;
+    *err = (a - av) + (b - bv);
+    return s;
+}
+
+double fi_two_diff_tail(double a, double b, double d) {
+    double bv = a - d;
+    double av = d + bv;
+    return (a - av) + (bv - b);
+}
+
+double fi_two_product(double a, double b, double *err) {
+    double p = a * b;
+    *err = fma(a, b, -p);
+    return p;
+}
+
+void fi_diff_product(double a, double b, double c, double d, double *x) {
+    double s0;
+    double t0;
+    double s1 = fi_two_product(a, b, &s0);
+    double t1 = fi_two_product(c, d, &t0);
+    // (s1 + s0) - (t1 + t0), one component of t after the other
+    double i = s0 - t0;
+    x[0] = fi_two_diff_tail(s0, t0, i);
+    double j = fi_two_sum(s1, i, &s0);
+    i = s0 - t1;
+    x[1] = fi_two_diff_tail(s0, t1, i);
+    x[3] = fi_two_sum(j, i, &x[2]);
+}
+
+int fi_expansion_sum(int elen, const double *e, int flen, const double *f,
+                     double *h) {
+    int ei = 0;
+    int fi = 0;
+    int hi = 0;
+    double q;
+    double qnew;
+    double hh;
+    double enow = e[0];
+    double fnow = f[0];
+
+    // merge the components by magnitude, carrying the sum in q
+    if ((fnow > enow) == (fnow > -enow)) {
+        q = enow;
+        enow = ++ei < elen ? e[ei] : 0;
+    } else {
+        q = fnow;
+        fnow = ++fi < flen ? f[fi] : 0;
+    }
+    if (ei < elen && fi < flen) {
+        if ((fnow > enow) == (fnow > -enow)) {
+            // fast two sum, |enow| <= |q|
+            qnew = enow + q;
+            hh = q - (qnew - enow);
+            enow = ++ei < elen ? e[ei] : 0;
+        } else {
+            qnew = fnow + q;
+            hh = q - (qnew - fnow);
+            fnow = ++fi < flen ? f[fi] : 0;
+        }
+        q = qnew;
+        if (hh != 0)
+            h[hi++] = hh;
+        while (ei < elen && fi < flen) {
+            if ((fnow > enow) == (fnow > -enow)) {
+                q = fi_two_sum(q, enow, &hh);
+                enow = ++ei < elen ? e[ei] : 0;
+            } else {
+                q = fi_two_sum(q, fnow, &hh);
+                fnow = ++fi < flen ? f[fi] : 0;
+            }
+            if (hh != 0)
+                h[hi++] = hh;
+        }
+    }
+    for (; ei < elen; enow = ++ei < elen ? e[ei] : 0) {
+        q = fi_two_sum(q, enow, &hh);
+        if (hh != 0)
+            h[hi++] = hh;
+    }
+    for (; fi < flen; fnow = ++fi < flen ? f[fi] : 0) {
+        q = fi_two_sum(q, fnow, &hh);
+        if (hh != 0)
+            h[hi++] = hh;
+    }
+    if (q != 0 || hi == 0)
+        h[hi++] = q;
+    return hi;
+}
+
+int fi_scale_expansion(int elen, const double *e, double b, double *h) {
+    int hi = 0;
+    double hh;
+    double q = fi_two_product(e[0], b, &hh);
+    if (hh != 0)
+        h[hi++] = hh;
+    for (int i = 1; i < elen; i++) {
+        double p0;
+        double p1 = fi_two_product(e[i], b, &p0);
+        double sum = fi_two_sum(q, p0, &hh);
+        if (hh != 0)
+            h[hi++] = hh;
+        // fast two sum, |sum| <= |p1|
+        q = p1 + sum;
+        hh = sum - (q - p1);
+        if (hh != 0)
+            h[hi++] = hh;
+    }
+    if (q != 0 || hi == 0)
+        h[hi++] = q;
+    return hi;
+}
+
+int fi_expansion_product(int elen, const double *e, int flen, const double *f,
+                         double *h) {
+    double t[2 * FI_EXPANSION_MAX];
+    double acc[2 * FI_EXPANSION_MAX * FI_EXPANSION_MAX];
+    int hlen = 0;
+    for (int i = 0; i < flen; i++) {
+        int tlen = fi_scale_expansion(elen, e, f[i], t);
+        if (hlen == 0) {
+            memcpy(h, t, tlen * sizeof(double));
+            hlen = tlen;
+            continue;
+        }
+        hlen = fi_expansion_sum(hlen, h, tlen, t, acc);
+        memcpy(h, acc, hlen * sizeof(double));
+    }
+    return hlen;
+}
+
+double fi_estimate(int elen, const double *e) {
+    double q = e[0];
+    for (int i = 1; i < elen; i++)
+        q += e[i];
+    return q;
+}
+
+double fi_orient2d_adapt(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc,
+                         double detsum) {
+    double acx = pa.x - pc.x;
+    double bcx = pb.x - pc.x;
+    double acy = pa.y - pc.y;
+    double bcy = pb.y - pc.y;
+
+    // the products of the rounded differences, exactly
+    double b[4];
+    fi_diff_product(acx, bcy, acy, bcx, b);
+    double det = fi_estimate(4, b);
+    double errbound = FI_CCW_ERRBOUND_B * detsum;
+    if (det >= errbound || -det >= errbound)
+        return det;
+
+    double acxtail = fi_two_diff_tail(pa.x, pc.x, acx);
+    double bcxtail = fi_two_diff_tail(pb.x, pc.x, bcx);
+    double acytail = fi_two_diff_tail(pa.y, pc.y, acy);
+    double bcytail = fi_two_diff_tail(pb.y, pc.y, bcy);
+    if (acxtail == 0 && acytail == 0 && bcxtail == 0 && bcytail == 0)
+        return det;
+
+    // first order terms of the rounding errors of the differences
+    errbound = FI_CCW_ERRBOUND_C * detsum + FI_RESULT_ERRBOUND * fabs(det);
+    det += (acx * bcytail + bcy * acxtail) - (acy * bcxtail + bcx * acytail);
+    if (det >= errbound || -det >= errbound)
+        return det;
+
+    // all the terms, exactly
+    double u[4];
+    double c1[8];
+    double c2[12];
+    double d[16];
+    fi_diff_product(acxtail, bcy, acytail, bcx, u);
+    int c1len = fi_expansion_sum(4, b, 4, u, c1);
+    fi_diff_product(acx, bcytail, acy, bcxtail, u);
+    int c2len = fi_expansion_sum(c1len, c1, 4, u, c2);
+    fi_diff_product(acxtail, bcytail, acytail, bcxtail, u);
+    int dlen = fi_expansion_sum(c2len, c2, 4, u, d);
+    return d[dlen - 1];
+}
+
+int fi_lift_term(double *ax, double *ay, double *bx, double *by, double *cx,
+                 double *cy, int n, double *out) {
+    double bc[4 * FI_EXPANSION_MAX];
+    double t1[4 * FI_EXPANSION_MAX];
+    double t2[4 * FI_EXPANSION_MAX];
+    double lift[4 * FI_EXPANSION_MAX];
+
+    // (bx * cy - cx * by) * (ax^2 + ay^2), with coordinates of n components
+    int l1 = fi_expansion_product(n, bx, n, cy, t1);
+    int l2 = fi_expansion_product(n, cx, n, by, t2);
+    for (int i = 0; i < l2; i++)
+        t2[i] = -t2[i];
+    int bclen = fi_expansion_sum(l1, t1, l2, t2, bc);
+    l1 = fi_expansion_product(n, ax, n, ax, t1);
+    l2 = fi_expansion_product(n, ay, n, ay, t2);
+    int liftlen = fi_expansion_sum(l1, t1, l2, t2, lift);
+    return fi_expansion_product(liftlen, lift, bclen, bc, out);
+}
+
+double fi_incircle_exact(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc,
+                         FI_POINT_D pd, int n) {
+    // the differences as expansions of n components (n = 1 when exact)
+    double d[6][2];
+    FI_POINT_D p[3] = {pa, pb, pc};
+    for (int i = 0; i < 3; i++) {
+        double x = p[i].x - pd.x;
+        double y = p[i].y - pd.y;
+        d[2 * i][0] = n == 1 ? x : fi_two_diff_tail(p[i].x, pd.x, x);
+        d[2 * i][1] = x;
+        d[2 * i + 1][0] = n == 1 ? y : fi_two_diff_tail(p[i].y, pd.y, y);
+        d[2 * i + 1][1] = y;
+    }
+    double *dx[3] = {&d[0][2 - n], &d[2][2 - n], &d[4][2 - n]};
+    double *dy[3] = {&d[1][2 - n], &d[3][2 - n], &d[5][2 - n]};
+
+    double adet[FI_INCIRCLE_TERM_MAX];
+    double bdet[FI_INCIRCLE_TERM_MAX];
+    double cdet[FI_INCIRCLE_TERM_MAX];
+    double abdet[2 * FI_INCIRCLE_TERM_MAX];
+    double fin[3 * FI_INCIRCLE_TERM_MAX];
+    int alen = fi_lift_term(dx[0], dy[0], dx[1], dy[1], dx[2], dy[2], n, adet);
+    int blen = fi_lift_term(dx[1], dy[1], dx[2], dy[2], dx[0], dy[0], n, bdet);
+    int clen = fi_lift_term(dx[2], dy[2], dx[0], dy[0], dx[1], dy[1], n, cdet);
+    int ablen = fi_expansion_sum(alen, adet, blen, bdet, abdet);
+    int finlen = fi_expansion_sum(ablen, abdet, clen, cdet, fin);
+    return fin[finlen - 1];
+}
+
+double fi_incircle(FI_POINT_D pa, FI_POINT_D pb, FI_POINT_D pc,
+                   FI_POINT_D pd) {
+    double adx = pa.x - pd.x;
+    double bdx = pb.x - pd.x;
+    double cdx = pc.x - pd.x;
+    double ady = pa.y - pd.y;
+    double bdy = pb.y - pd.y;
+    double cdy = pc.y - pd.y;
+
+    double bdxcdy = bdx * cdy;
+    double cdxbdy = cdx * bdy;
+    double alift = adx * adx + ady * ady;
+    double cdxady = cdx * ady;
+    double adxcdy = adx * cdy;
+    double blift = bdx * bdx + bdy * bdy;
+    double adxbdy = adx * bdy;
+    double bdxady = bdx * ady;
+    double clift = cdx * cdx + cdy * cdy;
+
+    double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) +
+                 clift * (adxbdy - bdxady);
+    double permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift +
+                       (fabs(cdxady) + fabs(adxcdy)) * blift +
+                       (fabs(adxbdy) + fabs(bdxady)) * clift;
+    double errbound = FI_ICC_ERRBOUND_A * permanent;
+    if (det > errbound || -det > errbound)
+        return det;
+
+    // the rounded differences, exactly
+    det = fi_incircle_exact(pa, pb, pc, pd, 1);
+    errbound = FI_ICC_ERRBOUND_B * permanent;
+    if (det >= errbound || -det >= errbound)
+        return det;
+    if (fi_two_diff_tail(pa.x, pd.x, adx) == 0 &&
+        fi_two_diff_tail(pa.y, pd.y, ady) == 0 &&
+        fi_two_diff_tail(pb.x, pd.x, bdx) == 0 &&
+        fi_two_diff_tail(pb.y, pd.y, bdy) == 0 &&
+        fi_two_diff_tail(pc.x, pd.x, cdx) == 0 &&
+        fi_two_diff_tail(pc.y, pd.y, cdy) == 0)
+        return det;
+
+    // the differences are not exact, all their terms
+    return fi_incircle_exact(pa, pb, pc, pd, 2);
+}
+
+int fi_cross_expansion(double u[2][2], double v[2][2], double *out) {
+    double p1[8];
+    double p2[8];
+    // a difference without tail is a single component
+    int l1 = fi_expansion_product(2 - (u[0][0] == 0), u[0] + (u[0][0] == 0),
+                                  2 - (v[1][0] == 0), v[1] + (v[1][0] == 0),
+                                  p1);
+    int l2 = fi_expansion_product(2 - (u[1][0] == 0), u[1] + (u[1][0] == 0),
+                                  2 - (v[0][0] == 0), v[0] + (v[0][0] == 0),
+                                  p2);
+    for (int i = 0; i < l2; i++)
+        p2[i] = -p2[i];
+    return fi_expansion_sum(l1, p1, l2, p2, out);
+}
+
+int fi_quotient_side(int nlen, const double *n, int dlen, const double *d,
+                     double q, double h) {
+    // n - (q + h) * d, with q + h as an expansion
+    double m[2] = {h, q};
+    double md[4 * FI_EXPANSION_MAX];
+    double r[6 * FI_EXPANSION_MAX + 4 * FI_EXPANSION_MAX];
+    int mdlen = h == 0 ? fi_scale_expansion(dlen, d, q, md)
+                       : fi_expansion_product(q == 0 ? 1 : 2, m, dlen, d, md);
+    for (int i = 0; i < mdlen; i++)
+        md[i] = -md[i];
+    int rlen = fi_expansion_sum(nlen, n, mdlen, md, r);
+    double side = r[rlen - 1] * d[dlen - 1];
+    return (side > 0) - (side < 0);
+}
+
+double fi_estimate_tail(int elen, const double *e, double *tail) {
+    double q = e[0];
+    double t = 0;
+    for (int i = 1; i < elen; i++) {
+        double err;
+        q = fi_two_sum(q, e[i], &err);
+        t += err;
+    }
+    *tail = t;
+    return q;
+}
+
+bool fi_line_crossing(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                      FI_POINT_D b2, FI_POINT_D *out) {
+    // the differences exactly, as expansions of 2 components
+    double from[3][2] = {{a1.x, a1.y}, {b1.x, b1.y}, {a1.x, a1.y}};
+    double to[3][2] = {{a2.x, a2.y}, {b2.x, b2.y}, {b1.x, b1.y}};
+    double diff[3][2][2];
+    for (int i = 0; i < 3; i++) {
+        for (int c = 0; c < 2; c++) {
+            diff[i][c][1] = to[i][c] - from[i][c];
+            diff[i][c][0] = fi_two_diff_tail(to[i][c], from[i][c],
+                                             diff[i][c][1]);
+        }
+    }
+
+    // the crossing is a1 + va * n / d, with d = va x vb and n = e x vb
+    double d[16];
+    double n[16];
+    int dlen = fi_cross_expansion(diff[0], diff[1], d);
+    if (d[dlen - 1] == 0)
+        return false;
+    int nlen = fi_cross_expansion(diff[2], diff[1], n);
+
+    // n / d as a double-double, n and d are exact so that it is within a few
+    // thousand eps^2 of the quotient, whatever the cancellation
+    double dl;
+    double nl;
+    double pl;
+    double dh = fi_estimate_tail(dlen, d, &dl);
+    double nh = fi_estimate_tail(nlen, n, &nl);
+    double th = nh / dh;
+    double ph = fi_two_product(th, dh, &pl);
+    double tl = ((nh - ph) - pl + nl - th * dl) / dh;
+
+    double coord[2];
+    for (int c = 0; c < 2; c++) {
+        // a1 + va * t as a double-double, its head is the rounded crossing
+        // unless a midpoint is within the bound of the error
+        double vh = diff[0][c][1];
+        double vl = diff[0][c][0];
+        double sl;
+        double xl;
+        ph = fi_two_product(vh, th, &pl);
+        pl += vh * tl + vl * th;
+        double sh = fi_two_sum(from[0][c], ph, &sl);
+        double q = fi_two_sum(sh, sl + pl, &xl);
+        double bound = 0x1p-93 * (fabs(ph) + fabs(q));
+        double gap = fmin(nextafter(q, INFINITY) - q,
+                          q - nextafter(q, -INFINITY));
+        if (fabs(xl) + bound < gap / 2) {
+            coord[c] = q;
+            continue;
+        }
+
+        double s1[32];
+        double s2[64];
+        double num[96];
+        bool single = vl == 0;
+        int l1 = fi_scale_expansion(dlen, d, from[0][c], s1);
+        int l2 = fi_expansion_product(2 - single, diff[0][c] + single, nlen,
+                                      n, s2);
+        int numlen = fi_expansion_sum(l1, s1, l2, s2, num);
+
+        // too close to a midpoint (or on one), exactly: q moves toward the
+        // quotient while past a midpoint, ties to even so that every pair of
+        // lines agrees
+        int side = fi_quotient_side(numlen, num, dlen, d, q, 0);
+        for (int i = 0; i < 8 && side != 0; i++) {
+            double next = nextafter(q, side > 0 ? INFINITY : -INFINITY);
+            int mid = fi_quotient_side(numlen, num, dlen, d, q, (next - q) / 2);
+            uint64_t bits;
+            memcpy(&bits, &q, sizeof(bits));
+            if (mid == 0 && (bits & 1) != 0)
+                q = next;
+            if (mid != side)
+                break;
+            q = next;
+            side = fi_quotient_side(numlen, num, dlen, d, q, 0);
+        }
+        coord[c] = q;
+    }
+    out->x = coord[0];
+    out->y = coord[1];
+    return true;
+}
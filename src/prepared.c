@@ -0,0 +1,219 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * A prepared clip path is swept once on its own: its self intersections are
+ * split and the in_out field of each edge (parity of the edges of the clip path
+ * below it) is known. Clipping a subject then only needs events for the edges
+ * of the clip path, found with an index of x buckets, whose in_out is kept
+ * instead of being derived from the edges below them on the sweep line. For
+ * AND and DIFF, the clip edges out of the x range of the subject are skipped:
+ * they are never inside the subject and never on the sweep line together with
+ * an edge of the subject.
+ */
+
+size_t fi_prepared_bucket(FI_PREPARED *prepared, double x) {
+    double b = floor((x - prepared->x0) / prepared->w);
+    if (!(b > 0))
+        return 0;
+    if (b >= prepared->n_bucket)
+        return prepared->n_bucket - 1;
+    return (size_t)b;
+}
+
+size_t fi_prepared_count(FI_PREPARED *prepared, size_t *count) {
+    size_t total = 0;
+    for (size_t i = 0; i < prepared->n_edge; i++) {
+        FI_PREPARED_EDGE *edge = &prepared->edges[i];
+        size_t b0 = fi_prepared_bucket(prepared, edge->s.x);
+        size_t b1 = fi_prepared_bucket(prepared, edge->e.x);
+        total += b1 - b0 + 1;
+        if (count != NULL)
+            for (size_t b = b0; b <= b1; b++)
+                count[b + 1]++;
+    }
+    return total;
+}
+
+void fi_prepared_index(FI_PREPARED *prepared) {
+    double width = prepared->bbox[1].x - prepared->bbox[0].x;
+    prepared->x0 = prepared->bbox[0].x;
+    prepared->n_bucket = prepared->n_edge / FI_PREPARED_BUCKET_EDGES;
+    if (prepared->n_bucket == 0 || !(width > 0))
+        prepared->n_bucket = 1;
+
+    // fewer buckets if long edges make the index too large
+    while (true) {
+        prepared->w = width > 0 ? width / prepared->n_bucket : 1;
+        if (prepared->n_bucket == 1 ||
+            fi_prepared_count(prepared, NULL) <=
+                FI_PREPARED_MAX_ENTRIES * prepared->n_edge)
+            break;
+        prepared->n_bucket /= 2;
+    }
+
+    size_t *start = calloc(prepared->n_bucket + 1, sizeof(size_t));
+    size_t total = fi_prepared_count(prepared, start);
+    for (size_t b = 0; b < prepared->n_bucket; b++)
+        start[b + 1] += start[b];
+    prepared->bucket = start;
+    prepared->index = malloc((total ? total : 1) * sizeof(size_t));
+
+    // edges are added in order, each bucket stays sorted
+    size_t *fill = malloc(prepared->n_bucket * sizeof(size_t));
+    memcpy(fill, start, prepared->n_bucket * sizeof(size_t));
+    for (size_t i = 0; i < prepared->n_edge; i++) {
+        FI_PREPARED_EDGE *edge = &prepared->edges[i];
+        size_t b0 = fi_prepared_bucket(prepared, edge->s.x);
+        size_t b1 = fi_prepared_bucket(prepared, edge->e.x);
+        for (size_t b = b0; b <= b1; b++)
+            prepared->index[fill[b]++] = i;
+    }
+    free(fill);
+}
+
+int fi_prepare_clip(FI_PATH *clip, FI_PREPARED **out) {
+    int ret = 0;
+    *out = NULL;
+    if (clip != NULL && (ret = fi_validate_path(clip)))
+        return ret;
+
+    FI_PREPARED *prepared = calloc(1, sizeof(FI_PREPARED));
+    *out = prepared;
+    if (clip == NULL)
+        return 0;
+    if (clip->meta->n_arc + clip->meta->n_qbez + clip->meta->n_cbez)
+        fi_linearize_to(clip, 0, &prepared->path);
+    else
+        fi_copy_path(clip, &prepared->path);
+    fi_path_bbox(prepared->path, prepared->bbox);
+
+    // the clip path alone, split at its self intersections
+    FI_SWEEP_STATE sweep = {0};
+    sweep.ops = FI_AND;
+    fi_create_sweepevent_queue(&sweep, NULL, prepared->path);
+    fi_subdivide(&sweep);
+    prepared->n_contour = sweep.n_contour;
+
+    // the left events were processed in order, the edges are sorted
+    prepared->edges = malloc((sweep.n_processed ? sweep.n_processed : 1) *
+                             sizeof(FI_PREPARED_EDGE));
+    for (size_t i = 0; i < sweep.n_processed; i++) {
+        FI_SWEEPEVENT *event = sweep.processed[i];
+        // overlapping edges of the polygon cancel out
+        if (!event->is_left_event || event->type == FI_NON_CONTRIBUTIN)
+            continue;
+        FI_PREPARED_EDGE *edge = &prepared->edges[prepared->n_edge++];
+        edge->s = event->point;
+        edge->e = event->other->point;
+        edge->contour_id = event->contour_id;
+        edge->in_out = event->in_out;
+    }
+    fi_free_sweep(&sweep);
+
+    fi_prepared_index(prepared);
+    return 0;
+}
+
+void fi_insert_prepared_edge(FI_SWEEP_STATE *sweep, FI_PREPARED_EDGE *edge,
+                             int contour_offset) {
+    int contour_id = edge->contour_id + contour_offset;
+    FI_SWEEPEVENT *l =
+        fi_new_event(sweep, edge->s, true, NULL, FI_CLIPPED, contour_id);
+    FI_SWEEPEVENT *r =
+        fi_new_event(sweep, edge->e, false, l, FI_CLIPPED, contour_id);
+    l->other = r;
+    l->seg[0] = r->seg[0] = edge->s;
+    l->seg[1] = r->seg[1] = edge->e;
+    l->in_out = edge->in_out;
+    fi_queue_append(&sweep->queue, l);
+    fi_queue_append(&sweep->queue, r);
+}
+
+void fi_insert_prepared(FI_SWEEP_STATE *sweep, FI_PREPARED *prepared,
+                        double xmin, double xmax) {
+    int offset = sweep->n_contour;
+    sweep->n_contour += prepared->n_contour;
+    if (prepared->n_edge == 0 || xmax < prepared->bbox[0].x ||
+        xmin > prepared->bbox[1].x)
+        return;
+
+    size_t b0 = fi_prepared_bucket(prepared, xmin);
+    size_t b1 = fi_prepared_bucket(prepared, xmax);
+    for (size_t b = b0; b <= b1; b++) {
+        for (size_t k = prepared->bucket[b]; k < prepared->bucket[b + 1];
+             k++) {
+            FI_PREPARED_EDGE *edge = &prepared->edges[prepared->index[k]];
+            if (edge->e.x < xmin || edge->s.x > xmax)
+                continue;
+            // an edge in several buckets is inserted from the first one
+            size_t first = fi_prepared_bucket(prepared, edge->s.x);
+            if ((first > b0 ? first : b0) != b)
+                continue;
+            fi_insert_prepared_edge(sweep, edge, offset);
+        }
+    }
+}
+
+int fi_clip_prepared(FI_PREPARED *prepared, FI_PATH *p1, FI_OPS ops,
+                     FI_PATH **out) {
+    FI_SWEEP_STATE sweep = {0};
+    FI_POINT_D bbox[2];
+    int ret = 0;
+
+    *out = NULL;
+    if (p1 != NULL && (ret = fi_validate_path(p1)))
+        return ret;
+    if (p1 == NULL || prepared->path == NULL)
+        return fi_clip_empty(p1, prepared->path, ops, out);
+    if (fi_clip_disjoint(p1, prepared->path, ops, out))
+        return 0;
+
+    FI_PATH *subject = p1;
+    if (p1->meta->n_arc + p1->meta->n_qbez + p1->meta->n_cbez)
+        fi_linearize_to(p1, 0, &subject);
+    fi_path_bbox(subject, bbox);
+
+    // only AND and DIFF ignore the clip edges far from the subject
+    double xmin = -INFINITY;
+    double xmax = INFINITY;
+    if (ops == FI_AND || ops == FI_DIFF) {
+        xmin = bbox[0].x;
+        xmax = bbox[1].x;
+    }
+    sweep.ops = ops;
+    sweep.fixed_clip = true;
+    fi_arena_init(&sweep.events, 0);
+    fi_insert_events(&sweep, subject, FI_SUBJECT);
+    fi_insert_prepared(&sweep, prepared, xmin, xmax);
+    fi_sort_events(&sweep.queue);
+    fi_subdivide(&sweep);
+    ret = fi_connect_edges(&sweep, out);
+    fi_free_sweep(&sweep);
+
+    if (subject != p1)
+        fi_free_path(subject);
+    return ret;
+}
+
+void fi_free_prepared(FI_PREPARED *prepared) {
+    if (prepared == NULL)
+        return;
+    fi_free_path(prepared->path);
+    free(prepared->edges);
+    free(prepared->bucket);
+    free(prepared->index);
+    free(prepared);
+}
@@ -0,0 +1,518 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * Clipping to a rectangle in linear time. Each ring is cut by the border of
+ * the rectangle (closed) into chains, parts of the ring inside the rectangle
+ * from one point of the border to another. The border between the ends of the
+ * chains is alternately inside and outside of the subject, just outside of the
+ * rectangle: one ray cast gives the side of one of these gaps, and the result
+ * is made of loops alternating chains and inside gaps. Rings inside the
+ * rectangle are kept as they are, and the rectangle itself is a loop when no
+ * ring crosses its border but it is inside the subject.
+ */
+
+/* position of a point of the border, counterclockwise from the minimum corner,
+ * a unit per side
+ */
+double fi_rect_border_t(FI_POINT_D *rect, FI_POINT_D p) {
+    double w = rect[1].x - rect[0].x;
+    double h = rect[1].y - rect[0].y;
+    if (p.y == rect[0].y && p.x < rect[1].x)
+        return (p.x - rect[0].x) / w;
+    if (p.x == rect[1].x && p.y < rect[1].y)
+        return 1 + (p.y - rect[0].y) / h;
+    if (p.y == rect[1].y && p.x > rect[0].x)
+        return 2 + (rect[1].x - p.x) / w;
+    return 3 + (rect[1].y - p.y) / h;
+}
+
+FI_POINT_D fi_rect_border_point(FI_POINT_D *rect, double t) {
+    double w = rect[1].x - rect[0].x;
+    double h = rect[1].y - rect[0].y;
+    switch (fi_rect_side(t)) {
+    case 0:
+        return (FI_POINT_D){rect[0].x + t * w, rect[0].y};
+    case 1:
+        return (FI_POINT_D){rect[1].x, rect[0].y + (t - 1) * h};
+    case 2:
+        return (FI_POINT_D){rect[1].x - (t - 2) * w, rect[1].y};
+    }
+    return (FI_POINT_D){rect[0].x, rect[1].y - (t - 3) * h};
+}
+
+int fi_rect_side(double t) {
+    int side = (int)floor(t) % 4;
+    return side < 0 ? side + 4 : side;
+}
+
+FI_POINT_D fi_rect_corner(FI_POINT_D *rect, int k) {
+    switch (fi_rect_side(k)) {
+    case 0:
+        return rect[0];
+    case 1:
+        return (FI_POINT_D){rect[1].x, rect[0].y};
+    case 2:
+        return rect[1];
+    }
+    return (FI_POINT_D){rect[0].x, rect[1].y};
+}
+
+void fi_rect_codes(FI_POINT_D *pts, size_t n, FI_POINT_D *rect,
+                   unsigned char *codes) {
+    double x0 = rect[0].x;
+    double y0 = rect[0].y;
+    double x1 = rect[1].x;
+    double y1 = rect[1].y;
+    // branchless, over a contiguous array: vectorized by the compiler
+    for (size_t i = 0; i < n; i++) {
+        double x = pts[i].x;
+        double y = pts[i].y;
+        codes[i] = (x < x0) | (x > x1) << 1 | (y < y0) << 2 | (y > y1) << 3;
+    }
+}
+
+bool fi_rect_segment(FI_POINT_D a, FI_POINT_D b, FI_POINT_D *rect,
+                     FI_POINT_D *seg) {
+    double p[2] = {a.x, a.y};
+    double d[2] = {b.x - a.x, b.y - a.y};
+    double lo[2] = {rect[0].x, rect[0].y};
+    double hi[2] = {rect[1].x, rect[1].y};
+    double t0 = 0;
+    double t1 = 1;
+    int in_axis = -1;
+    int out_axis = -1;
+    double in_val = 0;
+    double out_val = 0;
+
+    // Liang-Barsky, remembering the sides where the edge enters and leaves
+    for (int axis = 0; axis < 2; axis++) {
+        if (d[axis] == 0) {
+            if (p[axis] < lo[axis] || p[axis] > hi[axis])
+                return false;
+            continue;
+        }
+        double enter = d[axis] > 0 ? lo[axis] : hi[axis];
+        double leave = d[axis] > 0 ? hi[axis] : lo[axis];
+        double t_enter = (enter - p[axis]) / d[axis];
+        double t_leave = (leave - p[axis]) / d[axis];
+        if (t_enter > t0) {
+            t0 = t_enter;
+            in_axis = axis;
+            in_val = enter;
+        }
+        if (t_leave < t1) {
+            t1 = t_leave;
+            out_axis = axis;
+            out_val = leave;
+        }
+    }
+    if (t0 > t1)
+        return false;
+
+    // the ends on the border are put exactly on it
+    double t[2] = {t0, t1};
+    int axis[2] = {in_axis, out_axis};
+    double val[2] = {in_val, out_val};
+    for (int i = 0; i < 2; i++) {
+        double q[2] = {a.x + t[i] * d[0], a.y + t[i] * d[1]};
+        if (axis[i] >= 0)
+            q[axis[i]] = val[i];
+        seg[i].x = fmin(fmax(q[0], lo[0]), hi[0]);
+        seg[i].y = fmin(fmax(q[1], lo[1]), hi[1]);
+    }
+    if (t0 == 0)
+        seg[0] = a;
+    if (t1 == 1)
+        seg[1] = b;
+    return true;
+}
+
+void fi_rect_push(FI_POINT_D **pts, size_t *n, size_t *size, FI_POINT_D pt) {
+    *pts = fi_packed_grow(*pts, size, *n + 1, sizeof(FI_POINT_D));
+    (*pts)[(*n)++] = pt;
+}
+
+void fi_rect_gather(FI_RECT_STATE *st, FI_PATH *path) {
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            st->rings = fi_packed_grow(st->rings, &st->s_rings, st->n_ring + 2,
+                                       sizeof(size_t));
+            st->rings[st->n_ring] = st->n_pts;
+            fi_rect_push(&st->pts, &st->n_pts, &st->s_pts,
+                         tmp->section.points[0]);
+            break;
+        case FI_SEG_END:
+            // an explicit closing point is implied by Z
+            if (st->n_pts - st->rings[st->n_ring] > 1 &&
+                fi_compare_point(st->pts[st->n_pts - 1],
+                                 st->pts[st->rings[st->n_ring]]) == 0)
+                st->n_pts--;
+            st->rings[++st->n_ring] = st->n_pts;
+            break;
+        default:
+            fi_rect_push(&st->pts, &st->n_pts, &st->s_pts,
+                         tmp->section.points[0]);
+            break;
+        }
+    }
+}
+
+void fi_rect_chain_add(FI_RECT_STATE *st, FI_POINT_D pt) {
+    if (st->n_chain_pts > st->chain_first &&
+        fi_compare_point(st->chain_pts[st->n_chain_pts - 1], pt) == 0)
+        return;
+    fi_rect_push(&st->chain_pts, &st->n_chain_pts, &st->s_chain_pts, pt);
+}
+
+void fi_rect_chain_end(FI_RECT_STATE *st) {
+    size_t first = st->chain_first;
+    // a ring touching the border from outside gives a single point
+    if (st->n_chain_pts - first < 2) {
+        st->n_chain_pts = first;
+        return;
+    }
+    st->chains = fi_packed_grow(st->chains, &st->s_chains, st->n_chain + 1,
+                                sizeof(FI_RECT_CHAIN));
+    st->cross = fi_packed_grow(st->cross, &st->s_cross, st->n_cross + 2,
+                               sizeof(FI_RECT_CROSS));
+    FI_RECT_CHAIN *chain = &st->chains[st->n_chain];
+    chain->first = first;
+    chain->n = st->n_chain_pts - first;
+    for (int i = 0; i < 2; i++) {
+        FI_RECT_CROSS *cross = &st->cross[st->n_cross++];
+        FI_POINT_D pt = st->chain_pts[i ? st->n_chain_pts - 1 : first];
+        cross->t = fi_rect_border_t(st->rect, pt);
+        cross->chain = st->n_chain;
+        cross->last = i;
+    }
+    st->n_chain++;
+}
+
+void fi_rect_ring(FI_RECT_STATE *st, size_t ring) {
+    FI_POINT_D *pts = &st->pts[st->rings[ring]];
+    unsigned char *codes = &st->codes[st->rings[ring]];
+    size_t n = st->rings[ring + 1] - st->rings[ring];
+    unsigned char any = 0;
+    unsigned char all = 0x0f;
+    for (size_t i = 0; i < n; i++) {
+        any |= codes[i];
+        all &= codes[i];
+    }
+
+    // inside, or entirely beyond one side
+    if (n < 3 || all != 0)
+        return;
+    if (any == 0) {
+        for (size_t i = 0; i < n; i++)
+            fi_rect_push(&st->out, &st->n_out, &st->s_out, pts[i]);
+        fi_rect_loop_end(st, false);
+        return;
+    }
+
+    // start outside, every chain is then complete
+    size_t s = 0;
+    while (codes[s] == 0)
+        s++;
+    for (size_t k = 0; k < n; k++) {
+        size_t i = (s + k) % n;
+        size_t j = (i + 1) % n;
+        FI_POINT_D seg[2];
+        if ((codes[i] | codes[j]) == 0) {
+            fi_rect_chain_add(st, pts[j]);
+            continue;
+        }
+        if ((codes[i] & codes[j]) != 0 ||
+            !fi_rect_segment(pts[i], pts[j], st->rect, seg))
+            continue;
+        if (codes[i] != 0) {
+            st->chain_first = st->n_chain_pts;
+            fi_rect_chain_add(st, seg[0]);
+        }
+        fi_rect_chain_add(st, seg[1]);
+        if (codes[j] != 0)
+            fi_rect_chain_end(st);
+    }
+}
+
+bool fi_rect_border_inside(FI_RECT_STATE *st, double t) {
+    int side = fi_rect_side(t);
+    FI_POINT_D m = fi_rect_border_point(st->rect, t);
+    // ray from m going out of the rectangle, across its side; edges along the
+    // side are not crossed
+    int u = side % 2 == 0 ? 0 : 1;
+    int v = 1 - u;
+    double sign = side == 0 || side == 3 ? -1 : 1;
+    double mc[2] = {m.x, m.y};
+    bool inside = false;
+    for (size_t r = 0; r < st->n_ring; r++) {
+        size_t first = st->rings[r];
+        size_t n = st->rings[r + 1] - first;
+        for (size_t i = 0; i < n; i++) {
+            FI_POINT_D pa = st->pts[first + i];
+            FI_POINT_D pb = st->pts[first + (i + 1) % n];
+            double a[2] = {pa.x, pa.y};
+            double b[2] = {pb.x, pb.y};
+            if ((a[u] > mc[u]) == (b[u] > mc[u]))
+                continue;
+            double c = a[v] + (mc[u] - a[u]) * (b[v] - a[v]) / (b[u] - a[u]);
+            double out = sign * (c - mc[v]);
+            // an edge through m (touching the border there): m is moved a bit
+            // along the side, as by the test of the ends above
+            if (out == 0)
+                out = sign * (b[v] - a[v]) * (b[u] - a[u]);
+            if (out > 0)
+                inside = !inside;
+        }
+    }
+    return inside;
+}
+
+int fi_compare_border_t_p(const void *in_1, const void *in_2) {
+    const double *t1 = in_1;
+    const double *t2 = in_2;
+    if (*t1 < *t2)
+        return -1;
+    return *t1 > *t2;
+}
+
+double fi_rect_gap_t(FI_RECT_STATE *st, double ta, double tb) {
+    // a ray cast from a corner or from a point where the subject touches the
+    // border only meets edges through its origin, and no side can be told
+    double *ts = NULL;
+    size_t n = 0;
+    size_t size = 0;
+    for (double k = floor(ta) + 1; k < tb; k++) {
+        ts = fi_packed_grow(ts, &size, n + 1, sizeof(double));
+        ts[n++] = k;
+    }
+    for (size_t i = 0; i < st->n_pts; i++) {
+        FI_POINT_D p = st->pts[i];
+        if (st->codes[i] != 0 ||
+            (p.x != st->rect[0].x && p.x != st->rect[1].x &&
+             p.y != st->rect[0].y && p.y != st->rect[1].y))
+            continue;
+        double t = fi_rect_border_t(st->rect, p);
+        if (t < ta)
+            t += 4;
+        if (t <= ta || t >= tb)
+            continue;
+        ts = fi_packed_grow(ts, &size, n + 1, sizeof(double));
+        ts[n++] = t;
+    }
+    if (n > 1)
+        qsort(ts, n, sizeof(double), fi_compare_border_t_p);
+
+    double start = ta;
+    double length = -1;
+    double prev = ta;
+    for (size_t i = 0; i <= n; i++) {
+        double next = i < n ? ts[i] : tb;
+        if (next - prev > length) {
+            length = next - prev;
+            start = prev;
+        }
+        prev = next;
+    }
+    free(ts);
+    double t = start + length / 2;
+    return t >= 4 ? t - 4 : t;
+}
+
+bool fi_rect_on_side(FI_POINT_D *rect, FI_POINT_D a, FI_POINT_D b,
+                     FI_POINT_D c) {
+    if (a.x == b.x && b.x == c.x && (a.x == rect[0].x || a.x == rect[1].x))
+        return true;
+    return a.y == b.y && b.y == c.y && (a.y == rect[0].y || a.y == rect[1].y);
+}
+
+void fi_rect_loop_end(FI_RECT_STATE *st, bool clean) {
+    size_t first = st->out_first;
+    if (clean) {
+        // drop the points in the middle of a side, spikes along the border
+        // included
+        FI_POINT_D *pts = st->out;
+        size_t w = first;
+        for (size_t i = first; i < st->n_out; i++) {
+            FI_POINT_D p = pts[i];
+            while (w - first >= 2 &&
+                   fi_rect_on_side(st->rect, pts[w - 2], pts[w - 1], p))
+                w--;
+            if (w > first && fi_compare_point(pts[w - 1], p) == 0)
+                continue;
+            pts[w++] = p;
+        }
+        bool changed = true;
+        while (changed && w - first >= 3) {
+            changed = false;
+            if (fi_compare_point(pts[w - 1], pts[first]) == 0 ||
+                fi_rect_on_side(st->rect, pts[w - 2], pts[w - 1],
+                                pts[first])) {
+                w--;
+                changed = true;
+            } else if (fi_rect_on_side(st->rect, pts[w - 1], pts[first],
+                                       pts[first + 1])) {
+                memmove(&pts[first], &pts[first + 1],
+                        (w - first - 1) * sizeof(FI_POINT_D));
+                w--;
+                changed = true;
+            }
+        }
+        st->n_out = w;
+    }
+    if (st->n_out - first < 3) {
+        st->n_out = first;
+        return;
+    }
+    st->out_rings = fi_packed_grow(st->out_rings, &st->s_out_rings,
+                                   st->n_out_ring + 2, sizeof(size_t));
+    st->out_rings[st->n_out_ring] = first;
+    st->out_rings[++st->n_out_ring] = st->n_out;
+    st->out_first = st->n_out;
+}
+
+int fi_compare_cross_p(const void *in_1, const void *in_2) {
+    const FI_RECT_CROSS *c1 = in_1;
+    const FI_RECT_CROSS *c2 = in_2;
+    if (c1->t < c2->t)
+        return -1;
+    return c1->t > c2->t;
+}
+
+void fi_rect_gap(FI_RECT_STATE *st, double ta, double tb, bool forward) {
+    if (forward) {
+        for (double k = floor(ta) + 1; k < tb; k++)
+            fi_rect_push(&st->out, &st->n_out, &st->s_out,
+                         fi_rect_corner(st->rect, (int)k));
+    } else {
+        for (double k = ceil(ta) - 1; k > tb; k--)
+            fi_rect_push(&st->out, &st->n_out, &st->s_out,
+                         fi_rect_corner(st->rect, (int)k));
+    }
+}
+
+void fi_rect_stitch(FI_RECT_STATE *st) {
+    size_t n = st->n_cross;
+    FI_RECT_CROSS *cross = st->cross;
+    qsort(cross, n, sizeof(FI_RECT_CROSS), fi_compare_cross_p);
+    for (size_t i = 0; i < n; i++)
+        st->chains[cross[i].chain].cross[cross[i].last] = i;
+
+    // the side of the largest gap, the others alternate
+    size_t largest = 0;
+    double length = -1;
+    for (size_t i = 0; i < n; i++) {
+        double next = i + 1 < n ? cross[i + 1].t : cross[0].t + 4;
+        if (next - cross[i].t > length) {
+            length = next - cross[i].t;
+            largest = i;
+        }
+    }
+    double t = fi_rect_gap_t(st, cross[largest].t, cross[largest].t + length);
+    bool inside = fi_rect_border_inside(st, t);
+
+    bool *done = calloc(n, sizeof(bool));
+    for (size_t c = 0; c < n; c++) {
+        size_t cur = c;
+        while (!done[cur]) {
+            // the chain from cur to its other end
+            FI_RECT_CHAIN *chain = &st->chains[cross[cur].chain];
+            FI_POINT_D *pts = &st->chain_pts[chain->first];
+            bool reverse = cross[cur].last;
+            for (size_t i = 0; i < chain->n; i++)
+                fi_rect_push(&st->out, &st->n_out, &st->s_out,
+                             pts[reverse ? chain->n - 1 - i : i]);
+            size_t k = chain->cross[!reverse];
+            done[cur] = true;
+            done[k] = true;
+
+            // then the inside gap to the next chain
+            bool after = inside == ((k + n - largest) % 2 == 0);
+            size_t next = after ? (k + 1) % n : (k + n - 1) % n;
+            double tb = cross[next].t;
+            if (after && next == 0)
+                tb += 4;
+            if (!after && k == 0)
+                tb -= 4;
+            fi_rect_gap(st, cross[k].t, tb, after);
+            cur = next;
+        }
+        if (st->n_out > st->out_first)
+            fi_rect_loop_end(st, true);
+    }
+    free(done);
+}
+
+void fi_free_rect_state(FI_RECT_STATE *st) {
+    free(st->pts);
+    free(st->rings);
+    free(st->codes);
+    free(st->chain_pts);
+    free(st->chains);
+    free(st->cross);
+    free(st->out);
+    free(st->out_rings);
+}
+
+int fi_clip_rect(FI_PATH *p1, FI_POINT_D *rect, FI_PATH **out) {
+    FI_POINT_D bbox[2];
+    int ret = 0;
+
+    *out = NULL;
+    if (p1 != NULL && (ret = fi_validate_path(p1)))
+        return ret;
+    if (p1 == NULL || !(rect[0].x < rect[1].x && rect[0].y < rect[1].y))
+        return 0;
+
+    // entirely inside or outside
+    fi_path_bbox(p1, bbox);
+    if (bbox[0].x >= rect[0].x && bbox[1].x <= rect[1].x &&
+        bbox[0].y >= rect[0].y && bbox[1].y <= rect[1].y) {
+        fi_copy_path(p1, out);
+        return 0;
+    }
+    if (!fi_bbox_overlap(bbox, rect))
+        return 0;
+
+    FI_PATH *subject = p1;
+    if (p1->meta->n_arc + p1->meta->n_qbez + p1->meta->n_cbez)
+        fi_linearize_to(p1, 0, &subject);
+
+    FI_RECT_STATE st = {0};
+    st.rect[0] = rect[0];
+    st.rect[1] = rect[1];
+    fi_rect_gather(&st, subject);
+    st.codes = malloc(st.n_pts ? st.n_pts : 1);
+    fi_rect_codes(st.pts, st.n_pts, st.rect, st.codes);
+    for (size_t r = 0; r < st.n_ring; r++)
+        fi_rect_ring(&st, r);
+
+    if (st.n_cross > 0) {
+        fi_rect_stitch(&st);
+    } else if (fi_rect_border_inside(&st, fi_rect_gap_t(&st, 0, 4))) {
+        // the border is inside the subject, the rectangle is a loop
+        for (int k = 0; k < 4; k++)
+            fi_rect_push(&st.out, &st.n_out, &st.s_out,
+                         fi_rect_corner(st.rect, k));
+        fi_rect_loop_end(&st, false);
+    }
+    ret = fi_points_path(st.out, st.out_rings, st.n_out_ring, out);
+
+    fi_free_rect_state(&st);
+    if (subject != p1)
+        fi_free_path(subject);
+    return ret;
+}
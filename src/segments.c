@@ -0,0 +1,416 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+ * One segment tested against many, stored in SoA layout (an array per
+ * coordinate) so that 4 of them (AVX) or 2 of them (SSE2) are tested at once.
+ * A segment is a hit when its box meets the box of the tested segment and the
+ * orientations do not show that the endpoints of one are strictly on the same
+ * side of the other. The orientations are computed with doubles and only
+ * trusted beyond the error bound of fi_orient2d(), so a hit may be a near
+ * miss, which fi_segments_meet() decides exactly, but a segment which meets
+ * the tested one is always a hit.
+ */
+
+void fi_segments_reserve(FI_SEGMENTS *segs, size_t n) {
+    if (n <= segs->size)
+        return;
+    segs->x1 = realloc(segs->x1, n * sizeof(double));
+    segs->y1 = realloc(segs->y1, n * sizeof(double));
+    segs->x2 = realloc(segs->x2, n * sizeof(double));
+    segs->y2 = realloc(segs->y2, n * sizeof(double));
+    segs->size = n;
+}
+
+void fi_segments_add(FI_SEGMENTS *segs, FI_POINT_D s, FI_POINT_D e) {
+    if (segs->n == segs->size)
+        fi_segments_reserve(segs, segs->size ? 2 * segs->size : 64);
+    segs->x1[segs->n] = s.x;
+    segs->y1[segs->n] = s.y;
+    segs->x2[segs->n] = e.x;
+    segs->y2[segs->n] = e.y;
+    segs->n++;
+}
+
+size_t fi_path_edges(FI_PATH *path, FI_POINT_D *edges) {
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    size_t n = 0;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
+            continue;
+        case FI_SEG_END:
+            edges[2 * n] = last;
+            edges[2 * n + 1] = first;
+            last = first;
+            break;
+        default:
+            edges[2 * n] = last;
+            edges[2 * n + 1] = pt[0];
+            last = pt[0];
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+int fi_compare_edges_p(const void *in_1, const void *in_2) {
+    const FI_POINT_D *e1 = in_1;
+    const FI_POINT_D *e2 = in_2;
+    double x1 = fmin(e1[0].x, e1[1].x);
+    double x2 = fmin(e2[0].x, e2[1].x);
+    if (x1 < x2)
+        return -1;
+    return x1 > x2;
+}
+
+void fi_segments_path(FI_PATH *path, FI_SEGMENTS *segs) {
+    size_t n_edge = path->meta->n_line + path->meta->n_end;
+    FI_POINT_D *edges = malloc((n_edge ? 2 * n_edge : 1) * sizeof(FI_POINT_D));
+    n_edge = fi_path_edges(path, edges);
+    qsort(edges, n_edge, 2 * sizeof(FI_POINT_D), fi_compare_edges_p);
+    fi_segments_reserve(segs, segs->n + n_edge);
+    for (size_t i = 0; i < n_edge; i++)
+        fi_segments_add(segs, edges[2 * i], edges[2 * i + 1]);
+    free(edges);
+}
+
+size_t fi_segments_before(FI_SEGMENTS *segs, double x) {
+    size_t lo = 0;
+    size_t hi = segs->n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (fmin(segs->x1[mid], segs->x2[mid]) <= x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+void fi_free_segments(FI_SEGMENTS *segs) {
+    free(segs->x1);
+    free(segs->y1);
+    free(segs->x2);
+    free(segs->y2);
+    memset(segs, 0, sizeof(FI_SEGMENTS));
+}
+
+bool fi_segment_hit(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1, FI_POINT_D b2,
+                    double *t) {
+    if (fmax(b1.x, b2.x) < fmin(a1.x, a2.x) ||
+        fmin(b1.x, b2.x) > fmax(a1.x, a2.x) ||
+        fmax(b1.y, b2.y) < fmin(a1.y, a2.y) ||
+        fmin(b1.y, b2.y) > fmax(a1.y, a2.y))
+        return false;
+
+    // b1, b2 against a and a1, a2 against b
+    FI_POINT_D p[4] = {b1, b2, a1, a2};
+    FI_POINT_D l1[4] = {a1, a1, b1, b1};
+    FI_POINT_D l2[4] = {a2, a2, b2, b2};
+    double det[4];
+    bool pos[4];
+    bool neg[4];
+    for (int k = 0; k < 4; k++) {
+        double left = (l1[k].x - p[k].x) * (l2[k].y - p[k].y);
+        double right = (l1[k].y - p[k].y) * (l2[k].x - p[k].x);
+        double bound = FI_CCW_ERRBOUND_A * (fabs(left) + fabs(right));
+        det[k] = left - right;
+        pos[k] = det[k] > bound;
+        neg[k] = -det[k] > bound;
+    }
+    *t = det[2] / (det[2] - det[3]);
+    return !(pos[0] && pos[1]) && !(neg[0] && neg[1]) && !(pos[2] && pos[3]) &&
+           !(neg[2] && neg[3]);
+}
+
+uint64_t fi_segments_hit(FI_SEGMENTS *segs, size_t first, size_t n,
+                         FI_POINT_D a1, FI_POINT_D a2, double *t) {
+    const double *x1 = segs->x1 + first;
+    const double *y1 = segs->y1 + first;
+    const double *x2 = segs->x2 + first;
+    const double *y2 = segs->y2 + first;
+    uint64_t mask = 0;
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256d ax1 = _mm256_set1_pd(a1.x);
+    __m256d ay1 = _mm256_set1_pd(a1.y);
+    __m256d ax2 = _mm256_set1_pd(a2.x);
+    __m256d ay2 = _mm256_set1_pd(a2.y);
+    __m256d axmin = _mm256_set1_pd(fmin(a1.x, a2.x));
+    __m256d axmax = _mm256_set1_pd(fmax(a1.x, a2.x));
+    __m256d aymin = _mm256_set1_pd(fmin(a1.y, a2.y));
+    __m256d aymax = _mm256_set1_pd(fmax(a1.y, a2.y));
+    __m256d sign = _mm256_set1_pd(-0.0);
+    __m256d eps = _mm256_set1_pd(FI_CCW_ERRBOUND_A);
+    for (; i + 4 <= n; i += 4) {
+        __m256d bx1 = _mm256_loadu_pd(x1 + i);
+        __m256d by1 = _mm256_loadu_pd(y1 + i);
+        __m256d bx2 = _mm256_loadu_pd(x2 + i);
+        __m256d by2 = _mm256_loadu_pd(y2 + i);
+        __m256d hit = _mm256_and_pd(
+            _mm256_and_pd(
+                _mm256_cmp_pd(_mm256_max_pd(bx1, bx2), axmin, _CMP_GE_OQ),
+                _mm256_cmp_pd(_mm256_min_pd(bx1, bx2), axmax, _CMP_LE_OQ)),
+            _mm256_and_pd(
+                _mm256_cmp_pd(_mm256_max_pd(by1, by2), aymin, _CMP_GE_OQ),
+                _mm256_cmp_pd(_mm256_min_pd(by1, by2), aymax, _CMP_LE_OQ)));
+        if (_mm256_movemask_pd(hit) == 0)
+            continue;
+
+        __m256d px[4] = {bx1, bx2, ax1, ax2};
+        __m256d py[4] = {by1, by2, ay1, ay2};
+        __m256d lx1[4] = {ax1, ax1, bx1, bx1};
+        __m256d ly1[4] = {ay1, ay1, by1, by1};
+        __m256d lx2[4] = {ax2, ax2, bx2, bx2};
+        __m256d ly2[4] = {ay2, ay2, by2, by2};
+        __m256d det[4];
+        __m256d pos[4];
+        __m256d neg[4];
+        for (int k = 0; k < 4; k++) {
+            __m256d left = _mm256_mul_pd(_mm256_sub_pd(lx1[k], px[k]),
+                                         _mm256_sub_pd(ly2[k], py[k]));
+            __m256d right = _mm256_mul_pd(_mm256_sub_pd(ly1[k], py[k]),
+                                          _mm256_sub_pd(lx2[k], px[k]));
+            __m256d bound = _mm256_mul_pd(
+                eps, _mm256_add_pd(_mm256_andnot_pd(sign, left),
+                                   _mm256_andnot_pd(sign, right)));
+            det[k] = _mm256_sub_pd(left, right);
+            pos[k] = _mm256_cmp_pd(det[k], bound, _CMP_GT_OQ);
+            neg[k] = _mm256_cmp_pd(_mm256_xor_pd(det[k], sign), bound,
+                                   _CMP_GT_OQ);
+        }
+        __m256d apart = _mm256_or_pd(
+            _mm256_or_pd(_mm256_and_pd(pos[0], pos[1]),
+                         _mm256_and_pd(neg[0], neg[1])),
+            _mm256_or_pd(_mm256_and_pd(pos[2], pos[3]),
+                         _mm256_and_pd(neg[2], neg[3])));
+        hit = _mm256_andnot_pd(apart, hit);
+        _mm256_storeu_pd(t + i,
+                         _mm256_div_pd(det[2], _mm256_sub_pd(det[2], det[3])));
+        mask |= (uint64_t)_mm256_movemask_pd(hit) << i;
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+    __m128d sx1 = _mm_set1_pd(a1.x);
+    __m128d sy1 = _mm_set1_pd(a1.y);
+    __m128d sx2 = _mm_set1_pd(a2.x);
+    __m128d sy2 = _mm_set1_pd(a2.y);
+    __m128d sxmin = _mm_set1_pd(fmin(a1.x, a2.x));
+    __m128d sxmax = _mm_set1_pd(fmax(a1.x, a2.x));
+    __m128d symin = _mm_set1_pd(fmin(a1.y, a2.y));
+    __m128d symax = _mm_set1_pd(fmax(a1.y, a2.y));
+    __m128d sign2 = _mm_set1_pd(-0.0);
+    __m128d eps2 = _mm_set1_pd(FI_CCW_ERRBOUND_A);
+    for (; i + 2 <= n; i += 2) {
+        __m128d bx1 = _mm_loadu_pd(x1 + i);
+        __m128d by1 = _mm_loadu_pd(y1 + i);
+        __m128d bx2 = _mm_loadu_pd(x2 + i);
+        __m128d by2 = _mm_loadu_pd(y2 + i);
+        __m128d hit =
+            _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(_mm_max_pd(bx1, bx2), sxmin),
+                                  _mm_cmple_pd(_mm_min_pd(bx1, bx2), sxmax)),
+                       _mm_and_pd(_mm_cmpge_pd(_mm_max_pd(by1, by2), symin),
+                                  _mm_cmple_pd(_mm_min_pd(by1, by2), symax)));
+        if (_mm_movemask_pd(hit) == 0)
+            continue;
+
+        __m128d px[4] = {bx1, bx2, sx1, sx2};
+        __m128d py[4] = {by1, by2, sy1, sy2};
+        __m128d lx1[4] = {sx1, sx1, bx1, bx1};
+        __m128d ly1[4] = {sy1, sy1, by1, by1};
+        __m128d lx2[4] = {sx2, sx2, bx2, bx2};
+        __m128d ly2[4] = {sy2, sy2, by2, by2};
+        __m128d det[4];
+        __m128d pos[4];
+        __m128d neg[4];
+        for (int k = 0; k < 4; k++) {
+            __m128d left = _mm_mul_pd(_mm_sub_pd(lx1[k], px[k]),
+                                      _mm_sub_pd(ly2[k], py[k]));
+            __m128d right = _mm_mul_pd(_mm_sub_pd(ly1[k], py[k]),
+                                       _mm_sub_pd(lx2[k], px[k]));
+            __m128d bound =
+                _mm_mul_pd(eps2, _mm_add_pd(_mm_andnot_pd(sign2, left),
+                                            _mm_andnot_pd(sign2, right)));
+            det[k] = _mm_sub_pd(left, right);
+            pos[k] = _mm_cmpgt_pd(det[k], bound);
+            neg[k] = _mm_cmpgt_pd(_mm_xor_pd(det[k], sign2), bound);
+        }
+        __m128d apart =
+            _mm_or_pd(_mm_or_pd(_mm_and_pd(pos[0], pos[1]),
+                                _mm_and_pd(neg[0], neg[1])),
+                      _mm_or_pd(_mm_and_pd(pos[2], pos[3]),
+                                _mm_and_pd(neg[2], neg[3])));
+        hit = _mm_andnot_pd(apart, hit);
+        _mm_storeu_pd(t + i, _mm_div_pd(det[2], _mm_sub_pd(det[2], det[3])));
+        mask |= (uint64_t)_mm_movemask_pd(hit) << i;
+    }
+#endif
+    for (; i < n; i++) {
+        FI_POINT_D b1 = {x1[i], y1[i]};
+        FI_POINT_D b2 = {x2[i], y2[i]};
+        if (fi_segment_hit(a1, a2, b1, b2, &t[i]))
+            mask |= (uint64_t)1 << i;
+    }
+    return mask;
+}
+
+bool fi_segments_meet(FI_POINT_D a1, FI_POINT_D a2, FI_POINT_D b1,
+                      FI_POINT_D b2) {
+    double ob1 = fi_orient2d(a1, a2, b1);
+    double ob2 = fi_orient2d(a1, a2, b2);
+    double oa1 = fi_orient2d(b1, b2, a1);
+    double oa2 = fi_orient2d(b1, b2, a2);
+    if ((ob1 > 0 && ob2 > 0) || (ob1 < 0 && ob2 < 0) || (oa1 > 0 && oa2 > 0) ||
+        (oa1 < 0 && oa2 < 0))
+        return false;
+    if (ob1 != 0 || ob2 != 0 || oa1 != 0 || oa2 != 0)
+        return true;
+    // on the same line, their boxes must meet
+    return fmax(a1.x, a2.x) >= fmin(b1.x, b2.x) &&
+           fmax(b1.x, b2.x) >= fmin(a1.x, a2.x) &&
+           fmax(a1.y, a2.y) >= fmin(b1.y, b2.y) &&
+           fmax(b1.y, b2.y) >= fmin(a1.y, a2.y);
+}
+
+bool fi_segments_meet_any(FI_SEGMENTS *segs, FI_POINT_D a1, FI_POINT_D a2) {
+    double t[64];
+    // the segments are sorted by their minimum x, the others start after a
+    size_t n = fi_segments_before(segs, fmax(a1.x, a2.x));
+    for (size_t first = 0; first < n; first += 64) {
+        size_t count = n - first < 64 ? n - first : 64;
+        uint64_t mask = fi_segments_hit(segs, first, count, a1, a2, t);
+        for (size_t i = 0; mask != 0; i++, mask >>= 1) {
+            size_t k = first + i;
+            FI_POINT_D b1 = {segs->x1[k], segs->y1[k]};
+            FI_POINT_D b2 = {segs->x2[k], segs->y2[k]};
+            if ((mask & 1) && fi_segments_meet(a1, a2, b1, b2))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool fi_boundaries_meet(FI_PATH *p1, FI_PATH *p2) {
+    FI_SEGMENTS segs = {0};
+    fi_segments_path(p2, &segs);
+
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    bool meet = false;
+    for (FI_PATH *tmp = p1; tmp != NULL && !meet; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
+            break;
+        case FI_SEG_END:
+            meet = fi_segments_meet_any(&segs, last, first);
+            last = first;
+            break;
+        default:
+            meet = fi_segments_meet_any(&segs, last, pt[0]);
+            last = pt[0];
+            break;
+        }
+    }
+    fi_free_segments(&segs);
+    return meet;
+}
+
+int fi_intersects(FI_PATH *p1, FI_PATH *p2, bool *out) {
+    FI_POINT_D b1[2];
+    FI_POINT_D b2[2];
+    int ret = 0;
+
+    *out = false;
+    if (p1 == NULL || p2 == NULL)
+        return 0;
+    if ((ret = fi_validate_path(p1)) || (ret = fi_validate_path(p2)))
+        return ret;
+    fi_path_bbox(p1, b1);
+    fi_path_bbox(p2, b2);
+    if (!fi_bbox_overlap(b1, b2))
+        return 0;
+
+    FI_PATH *l1 = p1;
+    if (p1->meta->n_arc + p1->meta->n_qbez + p1->meta->n_cbez)
+        fi_linearize_to(p1, 0, &l1);
+    FI_PATH *l2 = p2;
+    if (p2->meta->n_arc + p2->meta->n_qbez + p2->meta->n_cbez)
+        fi_linearize_to(p2, 0, &l2);
+
+    // boundaries apart, one path may still be inside the other
+    *out = fi_boundaries_meet(l1, l2) ||
+           fi_point_in_path(l1->section.points[0], l2) ||
+           fi_point_in_path(l2->section.points[0], l1);
+
+    if (l1 != p1)
+        fi_free_path(l1);
+    if (l2 != p2)
+        fi_free_path(l2);
+    return 0;
+}
+
+bool fi_ring_kept(FI_OPS ops, FI_POLYGON_TYPE type, bool inside) {
+    switch (ops) {
+    case FI_AND:
+        return inside;
+    case FI_OR:
+        return !inside;
+    case FI_XOR:
+        return true;
+    case FI_DIFF:
+        return type == FI_SUBJECT ? !inside : inside;
+    }
+    return false;
+}
+
+bool fi_clip_separate(FI_PATH *p1, FI_PATH *p2, FI_OPS ops, FI_PATH **out) {
+    size_t n1 = p1->meta->n_line + p1->meta->n_end;
+    size_t n2 = p2->meta->n_line + p2->meta->n_end;
+    if (n1 * n2 > FI_SEPARATE_MAX_PAIRS || fi_boundaries_meet(p1, p2))
+        return false;
+
+    // each ring is entirely inside or outside of the other path, the
+    // boundary of the result is made of whole rings
+    size_t n_ring = p1->meta->n_move + p2->meta->n_move;
+    FI_RING *rings = malloc((n_ring ? n_ring : 1) * sizeof(FI_RING));
+    n_ring = fi_path_rings(p1, FI_SUBJECT, rings);
+    n_ring += fi_path_rings(p2, FI_CLIPPED, &rings[n_ring]);
+    *out = NULL;
+    for (size_t i = 0; i < n_ring; i++) {
+        FI_PATH *other = rings[i].type == FI_SUBJECT ? p2 : p1;
+        FI_POINT_D pt = rings[i].first->section.points[0];
+        bool inside = fi_point_in_path(pt, other);
+        if (fi_ring_kept(ops, rings[i].type, inside))
+            fi_append_copy(rings[i].first, rings[i].end, out);
+    }
+    free(rings);
+    return true;
+}
@@ -0,0 +1,186 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * The sweep line status is a red-black tree, its nodes are embedded in the
+ * left events (no allocation), ordered by fi_compare_segments().
+ */
+
+#define LEFT(e) ((e)->node.child[0])
+#define RIGHT(e) ((e)->node.child[1])
+#define PARENT(e) ((e)->node.parent)
+#define IS_RED(e) ((e) != NULL && (e)->node.red)
+
+/* put new in place of old in the parent of old */
+void fi_status_replace(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *old,
+                       FI_SWEEPEVENT *new) {
+    FI_SWEEPEVENT *parent = PARENT(old);
+    if (parent == NULL)
+        sweep->status = new;
+    else if (LEFT(parent) == old)
+        LEFT(parent) = new;
+    else
+        RIGHT(parent) = new;
+}
+
+/* rotate around e, e becomes the dir child of its !dir child */
+void fi_status_rotate(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *e, int dir) {
+    FI_SWEEPEVENT *y = e->node.child[!dir];
+    e->node.child[!dir] = y->node.child[dir];
+    if (y->node.child[dir] != NULL)
+        PARENT(y->node.child[dir]) = e;
+    PARENT(y) = PARENT(e);
+    fi_status_replace(sweep, e, y);
+    y->node.child[dir] = e;
+    PARENT(e) = y;
+}
+
+void fi_status_insert(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event) {
+    FI_SWEEPEVENT *parent = NULL;
+    FI_SWEEPEVENT *cur = sweep->status;
+    int dir = 0;
+
+    while (cur != NULL) {
+        parent = cur;
+        dir = fi_compare_segments(cur, event) < 0 ? 1 : 0;
+        cur = cur->node.child[dir];
+    }
+    memset(&event->node, 0, sizeof(FI_STATUS_NODE));
+    event->node.red = true;
+    event->node.linked = true;
+    PARENT(event) = parent;
+    if (parent == NULL)
+        sweep->status = event;
+    else
+        parent->node.child[dir] = event;
+    sweep->n_status++;
+
+    // restore the red-black properties
+    FI_SWEEPEVENT *e = event;
+    while (IS_RED(PARENT(e))) {
+        FI_SWEEPEVENT *p = PARENT(e);
+        FI_SWEEPEVENT *g = PARENT(p);
+        dir = p == LEFT(g) ? 0 : 1;
+        FI_SWEEPEVENT *uncle = g->node.child[!dir];
+        if (IS_RED(uncle)) {
+            p->node.red = false;
+            uncle->node.red = false;
+            g->node.red = true;
+            e = g;
+            continue;
+        }
+        if (e == p->node.child[!dir]) {
+            fi_status_rotate(sweep, p, dir);
+            e = p;
+            p = PARENT(e);
+        }
+        p->node.red = false;
+        g->node.red = true;
+        fi_status_rotate(sweep, g, !dir);
+    }
+    sweep->status->node.red = false;
+}
+
+void fi_status_remove_fixup(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *e,
+                            FI_SWEEPEVENT *parent) {
+    while (e != sweep->status && !IS_RED(e)) {
+        int dir = e == LEFT(parent) ? 0 : 1;
+        FI_SWEEPEVENT *w = parent->node.child[!dir];
+        if (IS_RED(w)) {
+            w->node.red = false;
+            parent->node.red = true;
+            fi_status_rotate(sweep, parent, dir);
+            w = parent->node.child[!dir];
+        }
+        if (!IS_RED(LEFT(w)) && !IS_RED(RIGHT(w))) {
+            w->node.red = true;
+            e = parent;
+            parent = PARENT(e);
+            continue;
+        }
+        if (!IS_RED(w->node.child[!dir])) {
+            w->node.child[dir]->node.red = false;
+            w->node.red = true;
+            fi_status_rotate(sweep, w, !dir);
+            w = parent->node.child[!dir];
+        }
+        w->node.red = parent->node.red;
+        parent->node.red = false;
+        w->node.child[!dir]->node.red = false;
+        fi_status_rotate(sweep, parent, dir);
+        e = sweep->status;
+    }
+    if (e != NULL)
+        e->node.red = false;
+}
+
+void fi_status_remove(FI_SWEEP_STATE *sweep, FI_SWEEPEVENT *event) {
+    FI_SWEEPEVENT *child;
+    FI_SWEEPEVENT *parent;
+    bool red;
+
+    if (LEFT(event) == NULL || RIGHT(event) == NULL) {
+        child = LEFT(event) != NULL ? LEFT(event) : RIGHT(event);
+        parent = PARENT(event);
+        red = event->node.red;
+        if (child != NULL)
+            PARENT(child) = parent;
+        fi_status_replace(sweep, event, child);
+    } else {
+        // the successor takes the place of the removed event
+        FI_SWEEPEVENT *next = RIGHT(event);
+        while (LEFT(next) != NULL)
+            next = LEFT(next);
+        child = RIGHT(next);
+        parent = PARENT(next);
+        red = next->node.red;
+        if (child != NULL)
+            PARENT(child) = parent;
+        fi_status_replace(sweep, next, child);
+        if (parent == event)
+            parent = next;
+        next->node = event->node;
+        fi_status_replace(sweep, event, next);
+        PARENT(LEFT(next)) = next;
+        if (RIGHT(next) != NULL)
+            PARENT(RIGHT(next)) = next;
+    }
+
+    if (!red)
+        fi_status_remove_fixup(sweep, child, parent);
+    memset(&event->node, 0, sizeof(FI_STATUS_NODE));
+    sweep->n_status--;
+}
+
+/* neighbour of an event in the status, dir 0 -> below, 1 -> above */
+FI_SWEEPEVENT *fi_status_neighbour(FI_SWEEPEVENT *event, int dir) {
+    FI_SWEEPEVENT *e = event->node.child[dir];
+    if (e != NULL) {
+        while (e->node.child[!dir] != NULL)
+            e = e->node.child[!dir];
+        return e;
+    }
+    e = event;
+    while (PARENT(e) != NULL && e == PARENT(e)->node.child[dir])
+        e = PARENT(e);
+    return PARENT(e);
+}
+
+FI_SWEEPEVENT *fi_status_prev(FI_SWEEPEVENT *event) {
+    return fi_status_neighbour(event, 0);
+}
+
+FI_SWEEPEVENT *fi_status_next(FI_SWEEPEVENT *event) {
+    return fi_status_neighbour(event, 1);
+}
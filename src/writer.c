@@ -0,0 +1,471 @@
+/* This file is part of the ficlip clipping library
+ *
+ * ficlip is licensed under MIT.
+ *
+ * Copyright 2017, Pierre-Francois Carpentier
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include "ficlip.h"
+#include "ficlip-private.h"
+
+/*
+ * SVG path data writer. Numbers are formatted in a local buffer then appended
+ * to the output buffer, which is grown, flushed to a stream or reported full.
+ * With a fixed precision, the rounding is done on integers and gives the same
+ * text as printf("%.*f") (printf is only used close to a tie). The shortest
+ * digits are generated with Grisu3 (Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers", 2010): the double and the bounds of
+ * its rounding interval are scaled by a cached power of ten into 64-bit
+ * integers, and the digits are generated until the interval is left. Grisu3
+ * detects the few doubles it cannot prove shortest, these fall back to the
+ * first of %.15g, %.16g and %.17g which reads back to the same double.
+ */
+
+// normalized 64-bit significands of 10^-348 to 10^340, every 8th power
+const FI_CACHED_POWER fi_cached_powers[] = {
+    {0xfa8fd5a0081c0288ULL, -1220, -348},
+    {0xbaaee17fa23ebf76ULL, -1193, -340},
+    {0x8b16fb203055ac76ULL, -1166, -332},
+    {0xcf42894a5dce35eaULL, -1140, -324},
+    {0x9a6bb0aa55653b2dULL, -1113, -316},
+    {0xe61acf033d1a45dfULL, -1087, -308},
+    {0xab70fe17c79ac6caULL, -1060, -300},
+    {0xff77b1fcbebcdc4fULL, -1034, -292},
+    {0xbe5691ef416bd60cULL, -1007, -284},
+    {0x8dd01fad907ffc3cULL, -980, -276},
+    {0xd3515c2831559a83ULL, -954, -268},
+    {0x9d71ac8fada6c9b5ULL, -927, -260},
+    {0xea9c227723ee8bcbULL, -901, -252},
+    {0xaecc49914078536dULL, -874, -244},
+    {0x823c12795db6ce57ULL, -847, -236},
+    {0xc21094364dfb5637ULL, -821, -228},
+    {0x9096ea6f3848984fULL, -794, -220},
+    {0xd77485cb25823ac7ULL, -768, -212},
+    {0xa086cfcd97bf97f4ULL, -741, -204},
+    {0xef340a98172aace5ULL, -715, -196},
+    {0xb23867fb2a35b28eULL, -688, -188},
+    {0x84c8d4dfd2c63f3bULL, -661, -180},
+    {0xc5dd44271ad3cdbaULL, -635, -172},
+    {0x936b9fcebb25c996ULL, -608, -164},
+    {0xdbac6c247d62a584ULL, -582, -156},
+    {0xa3ab66580d5fdaf6ULL, -555, -148},
+    {0xf3e2f893dec3f126ULL, -529, -140},
+    {0xb5b5ada8aaff80b8ULL, -502, -132},
+    {0x87625f056c7c4a8bULL, -475, -124},
+    {0xc9bcff6034c13053ULL, -449, -116},
+    {0x964e858c91ba2655ULL, -422, -108},
+    {0xdff9772470297ebdULL, -396, -100},
+    {0xa6dfbd9fb8e5b88fULL, -369, -92},
+    {0xf8a95fcf88747d94ULL, -343, -84},
+    {0xb94470938fa89bcfULL, -316, -76},
+    {0x8a08f0f8bf0f156bULL, -289, -68},
+    {0xcdb02555653131b6ULL, -263, -60},
+    {0x993fe2c6d07b7facULL, -236, -52},
+    {0xe45c10c42a2b3b06ULL, -210, -44},
+    {0xaa242499697392d3ULL, -183, -36},
+    {0xfd87b5f28300ca0eULL, -157, -28},
+    {0xbce5086492111aebULL, -130, -20},
+    {0x8cbccc096f5088ccULL, -103, -12},
+    {0xd1b71758e219652cULL, -77, -4},
+    {0x9c40000000000000ULL, -50, 4},
+    {0xe8d4a51000000000ULL, -24, 12},
+    {0xad78ebc5ac620000ULL, 3, 20},
+    {0x813f3978f8940984ULL, 30, 28},
+    {0xc097ce7bc90715b3ULL, 56, 36},
+    {0x8f7e32ce7bea5c70ULL, 83, 44},
+    {0xd5d238a4abe98068ULL, 109, 52},
+    {0x9f4f2726179a2245ULL, 136, 60},
+    {0xed63a231d4c4fb27ULL, 162, 68},
+    {0xb0de65388cc8ada8ULL, 189, 76},
+    {0x83c7088e1aab65dbULL, 216, 84},
+    {0xc45d1df942711d9aULL, 242, 92},
+    {0x924d692ca61be758ULL, 269, 100},
+    {0xda01ee641a708deaULL, 295, 108},
+    {0xa26da3999aef774aULL, 322, 116},
+    {0xf209787bb47d6b85ULL, 348, 124},
+    {0xb454e4a179dd1877ULL, 375, 132},
+    {0x865b86925b9bc5c2ULL, 402, 140},
+    {0xc83553c5c8965d3dULL, 428, 148},
+    {0x952ab45cfa97a0b3ULL, 455, 156},
+    {0xde469fbd99a05fe3ULL, 481, 164},
+    {0xa59bc234db398c25ULL, 508, 172},
+    {0xf6c69a72a3989f5cULL, 534, 180},
+    {0xb7dcbf5354e9beceULL, 561, 188},
+    {0x88fcf317f22241e2ULL, 588, 196},
+    {0xcc20ce9bd35c78a5ULL, 614, 204},
+    {0x98165af37b2153dfULL, 641, 212},
+    {0xe2a0b5dc971f303aULL, 667, 220},
+    {0xa8d9d1535ce3b396ULL, 694, 228},
+    {0xfb9b7cd9a4a7443cULL, 720, 236},
+    {0xbb764c4ca7a44410ULL, 747, 244},
+    {0x8bab8eefb6409c1aULL, 774, 252},
+    {0xd01fef10a657842cULL, 800, 260},
+    {0x9b10a4e5e9913129ULL, 827, 268},
+    {0xe7109bfba19c0c9dULL, 853, 276},
+    {0xac2820d9623bf429ULL, 880, 284},
+    {0x80444b5e7aa7cf85ULL, 907, 292},
+    {0xbf21e44003acdd2dULL, 933, 300},
+    {0x8e679c2f5e44ff8fULL, 960, 308},
+    {0xd433179d9c8cb841ULL, 986, 316},
+    {0x9e19db92b4e31ba9ULL, 1013, 324},
+    {0xeb96bf6ebadf77d9ULL, 1039, 332},
+    {0xaf87023b9bf0ee6bULL, 1066, 340},
+};
+
+int fi_format_fixed(double v, int precision, char *out) {
+    double scaled = fabs(v) * fi_pow10[precision];
+    // the rounding is only unsure close to a tie, the error of the product
+    // being less than an ulp
+    if (!(scaled < 4503599627370496.0)) // 2^52, also NaN
+        return snprintf(out, FI_NUMBER_MAX_CHARS, "%.*f", precision, v);
+    double r = floor(scaled);
+    double f = scaled - r;
+    if (fabs(f - 0.5) <= scaled * 4e-16)
+        return snprintf(out, FI_NUMBER_MAX_CHARS, "%.*f", precision, v);
+    uint64_t n = (uint64_t)r + (f > 0.5);
+
+    // digits from the end
+    char tmp[64];
+    int len = 0;
+    for (int i = 0; n > 0 || i <= precision; i++) {
+        if (i == precision && precision > 0)
+            tmp[len++] = '.';
+        tmp[len++] = '0' + n % 10;
+        n /= 10;
+    }
+    int k = 0;
+    if (signbit(v))
+        out[k++] = '-';
+    while (len > 0)
+        out[k++] = tmp[--len];
+    out[k] = '\0';
+    return k;
+}
+
+FI_DIYFP fi_diyfp_mul(FI_DIYFP a, FI_DIYFP b) {
+    // upper 64 bits of the 128-bit product, rounded
+    uint64_t a_hi = a.f >> 32;
+    uint64_t a_lo = a.f & 0xffffffff;
+    uint64_t b_hi = b.f >> 32;
+    uint64_t b_lo = b.f & 0xffffffff;
+    uint64_t hi_lo = a_hi * b_lo;
+    uint64_t lo_hi = a_lo * b_hi;
+    uint64_t mid = ((a_lo * b_lo) >> 32) + (hi_lo & 0xffffffff) +
+                   (lo_hi & 0xffffffff) + (1U << 31);
+    FI_DIYFP r = {a_hi * b_hi + (hi_lo >> 32) + (lo_hi >> 32) + (mid >> 32),
+                  a.e + b.e + 64};
+    return r;
+}
+
+FI_DIYFP fi_diyfp_normalize(FI_DIYFP a) {
+    while (!(a.f & 0x8000000000000000ULL)) {
+        a.f <<= 1;
+        a.e--;
+    }
+    return a;
+}
+
+bool fi_grisu_round_weed(char *buf, int len, uint64_t distance_too_high_w,
+                         uint64_t unsafe_interval, uint64_t rest,
+                         uint64_t ten_kappa, uint64_t unit) {
+    // w is only known within unit, get the digits closest to both ends of
+    // its range
+    uint64_t small_distance = distance_too_high_w - unit;
+    uint64_t big_distance = distance_too_high_w + unit;
+    while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance ||
+            small_distance - rest >= rest + ten_kappa - small_distance)) {
+        buf[len - 1]--;
+        rest += ten_kappa;
+    }
+    // the closest digits differ for both ends, unsure
+    if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance ||
+         big_distance - rest > rest + ten_kappa - big_distance))
+        return false;
+    // within the safe part of the interval
+    return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+bool fi_grisu_digits(FI_DIYFP low, FI_DIYFP w, FI_DIYFP high, char *buf,
+                     int *len, int *kappa) {
+    // the bounds widened by their error, any digits within the unsafe
+    // interval might not read back to w
+    uint64_t unit = 1;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe_interval = too_high - (low.f - unit);
+    int shift = -w.e;
+    uint64_t one = (uint64_t)1 << shift;
+    // w.e is in [-60, -32], the integral part fits in 32 bits
+    uint32_t integrals = (uint32_t)(too_high >> shift);
+    uint64_t fractionals = too_high & (one - 1);
+    uint32_t divisor = 1;
+    *kappa = integrals > 0;
+    while (integrals / divisor >= 10) {
+        divisor *= 10;
+        (*kappa)++;
+    }
+
+    *len = 0;
+    while (*kappa > 0) {
+        buf[(*len)++] = '0' + integrals / divisor;
+        integrals %= divisor;
+        (*kappa)--;
+        uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+        if (rest < unsafe_interval)
+            return fi_grisu_round_weed(buf, *len, too_high - w.f,
+                                       unsafe_interval, rest,
+                                       (uint64_t)divisor << shift, unit);
+        divisor /= 10;
+    }
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        buf[(*len)++] = '0' + (int)(fractionals >> shift);
+        fractionals &= one - 1;
+        (*kappa)--;
+        if (fractionals < unsafe_interval)
+            return fi_grisu_round_weed(buf, *len, (too_high - w.f) * unit,
+                                       unsafe_interval, fractionals, one,
+                                       unit);
+    }
+}
+
+bool fi_grisu3(double v, char *buf, int *len, int *exponent) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(double));
+    uint64_t fraction = bits & 0xfffffffffffffULL;
+    int biased = (int)(bits >> 52) & 0x7ff;
+    FI_DIYFP w = {fraction, -1074};
+    if (biased > 0)
+        w = (FI_DIYFP){fraction | 0x10000000000000ULL, biased - 1075};
+
+    // bounds of the values rounded to v, halfway to its neighbours; the
+    // one below is closer at a power of two
+    FI_DIYFP high = fi_diyfp_normalize((FI_DIYFP){(w.f << 1) + 1, w.e - 1});
+    FI_DIYFP low = {(w.f << 1) - 1, w.e - 1};
+    if (fraction == 0 && biased > 1)
+        low = (FI_DIYFP){(w.f << 2) - 1, w.e - 2};
+    low.f <<= low.e - high.e;
+    low.e = high.e;
+    w = fi_diyfp_normalize(w);
+
+    // a cached power bringing the exponent of the products in [-60, -32]
+    int min_exponent = -60 - (w.e + 64);
+    int k = (int)ceil((min_exponent + 63) * 0.30102999566398114);
+    FI_CACHED_POWER cached = fi_cached_powers[(348 + k - 1) / 8 + 1];
+    FI_DIYFP ten_mk = {cached.f, cached.e};
+
+    int kappa;
+    if (!fi_grisu_digits(fi_diyfp_mul(low, ten_mk), fi_diyfp_mul(w, ten_mk),
+                         fi_diyfp_mul(high, ten_mk), buf, len, &kappa))
+        return false;
+    *exponent = kappa - cached.k;
+    return true;
+}
+
+int fi_format_digits(const char *digits, int n, int exponent, bool negative,
+                     char *out) {
+    // point after the first p digits, or the same in scientific notation
+    int p = n + exponent;
+    int x = p - 1;
+    int x_digits = abs(x) >= 100 ? 3 : (abs(x) >= 10 ? 2 : 1);
+    int len_sci = n + (n > 1) + 1 + (x < 0) + x_digits;
+    int len_fixed = p >= n ? p : (p > 0 ? n + 1 : 2 - p + n);
+
+    int k = 0;
+    if (negative)
+        out[k++] = '-';
+    if (len_fixed <= len_sci) {
+        if (p <= 0) {
+            out[k++] = '0';
+            out[k++] = '.';
+            for (int i = p; i < 0; i++)
+                out[k++] = '0';
+        }
+        for (int i = 0; i < n; i++) {
+            if (i == p && p > 0)
+                out[k++] = '.';
+            out[k++] = digits[i];
+        }
+        for (int i = n; i < p; i++)
+            out[k++] = '0';
+    } else {
+        out[k++] = digits[0];
+        if (n > 1)
+            out[k++] = '.';
+        for (int i = 1; i < n; i++)
+            out[k++] = digits[i];
+        out[k++] = 'e';
+        if (x < 0)
+            out[k++] = '-';
+        for (int d = x_digits - 1, a = abs(x); d >= 0; d--, a /= 10)
+            out[k + d] = '0' + a % 10;
+        k += x_digits;
+    }
+    out[k] = '\0';
+    return k;
+}
+
+int fi_format_shortest(double v, char *out) {
+    // integers are common and easy
+    if (v == floor(v) && fabs(v) < 1e15 && !(v == 0 && signbit(v)))
+        return fi_format_fixed(v, 0, out);
+    char digits[32];
+    int n;
+    int exponent;
+    if (isfinite(v) && v != 0 && fi_grisu3(fabs(v), digits, &n, &exponent))
+        return fi_format_digits(digits, n, exponent, signbit(v), out);
+    n = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        n = snprintf(out, FI_NUMBER_MAX_CHARS, "%.*g", precision, v);
+        if (strtod(out, NULL) == v)
+            break;
+    }
+    return n;
+}
+
+void fi_writer_init(FI_WRITER *w, char *buf, size_t size) {
+    memset(w, 0, sizeof(FI_WRITER));
+    w->buf = buf;
+    w->size = buf != NULL ? size : 0;
+    w->growable = buf == NULL;
+    w->precision = 4;
+    if (w->buf != NULL && w->size > 0)
+        w->buf[0] = '\0';
+}
+
+int fi_writer_flush(FI_WRITER *w) {
+    if (w->out != NULL && w->len > 0) {
+        fwrite(w->buf, 1, w->len, w->out);
+        w->len = 0;
+        w->buf[0] = '\0';
+    }
+    return w->err;
+}
+
+void fi_writer_free(FI_WRITER *w) {
+    if (w->growable)
+        free(w->buf);
+    w->buf = NULL;
+    w->len = 0;
+    w->size = 0;
+}
+
+/* room for n more characters and the terminating 0 */
+int fi_writer_reserve(FI_WRITER *w, size_t n) {
+    if (w->len + n < w->size)
+        return 0;
+    if (w->out != NULL && w->buf != NULL) {
+        fi_writer_flush(w);
+        if (n < w->size)
+            return 0;
+    }
+    if (!w->growable) {
+        w->err = ERR_BUFFER_FULL;
+        return w->err;
+    }
+    size_t size = w->size ? w->size : 4096;
+    while (w->len + n >= size)
+        size *= 2;
+    w->buf = realloc(w->buf, size);
+    w->size = size;
+    return 0;
+}
+
+void fi_writer_append(FI_WRITER *w, const char *str, size_t n) {
+    if (w->err || fi_writer_reserve(w, n))
+        return;
+    memcpy(w->buf + w->len, str, n);
+    w->len += n;
+    w->buf[w->len] = '\0';
+}
+
+/* a number followed by sep, relative to ref (updated to the value read back)
+ * if ref is not NULL
+ */
+void fi_write_number(FI_WRITER *w, double v, double *ref, char sep) {
+    char tmp[FI_NUMBER_MAX_CHARS + 1];
+    int precision = w->precision;
+    if (precision > FI_WRITER_MAX_PRECISION)
+        precision = FI_WRITER_MAX_PRECISION;
+    double scale = precision >= 0 ? fi_pow10[precision] : 1;
+
+    if (ref != NULL) {
+        if (precision >= 0 && fabs(v * scale) < 4503599627370496.0 &&
+            fabs(*ref * scale) < 4503599627370496.0) {
+            // difference of the rounded values, the position does not drift
+            double r = round(v * scale);
+            v = (r - round(*ref * scale)) / scale;
+            *ref = r / scale;
+        } else {
+            v = v - *ref;
+            *ref += v;
+        }
+    }
+
+    int n = precision >= 0 ? fi_format_fixed(v, precision, tmp)
+                           : fi_format_shortest(v, tmp);
+    tmp[n++] = sep;
+    fi_writer_append(w, tmp, n);
+}
+
+void fi_write_point(FI_WRITER *w, FI_POINT_D pt, bool relative) {
+    fi_write_number(w, pt.x, relative ? &w->cur.x : NULL, ',');
+    fi_write_number(w, pt.y, relative ? &w->cur.y : NULL, ' ');
+}
+
+int fi_write_seg(FI_WRITER *w, FI_SEG_TYPE type, FI_SEG_FLAG flag,
+                 FI_POINT_D *pt) {
+    const char *cmd = w->relative ? "zmlaqc" : "ZMLAQC";
+    bool rel = w->relative;
+    int n = fi_seg_n_point(type);
+
+    if (type > FI_SEG_CUB_BEZIER)
+        return w->err;
+    char tmp[2] = {cmd[type], ' '};
+    fi_writer_append(w, tmp, 2);
+    switch (type) {
+    case FI_SEG_END:
+        w->cur = w->start;
+        break;
+    case FI_SEG_MOVE:
+        fi_write_point(w, pt[0], rel);
+        w->start = rel ? w->cur : pt[0];
+        break;
+    case FI_SEG_ARC:
+        fi_write_number(w, pt[0].x, NULL, ' ');
+        fi_write_number(w, pt[0].y, NULL, ' ');
+        fi_write_number(w, pt[1].x, NULL, ' ');
+        fi_writer_append(w, flag & FI_LARGE_ARC ? "1 " : "0 ", 2);
+        fi_writer_append(w, flag & FI_SWEEP ? "1 " : "0 ", 2);
+        fi_write_point(w, pt[2], rel);
+        break;
+    default:
+        // control points are relative to the start of the segment
+        for (int i = 0; i < n; i++) {
+            FI_POINT_D start = w->cur;
+            fi_write_point(w, pt[i], rel);
+            if (i + 1 < n && rel)
+                w->cur = start;
+        }
+        break;
+    }
+    if (!rel && n > 0)
+        w->cur = pt[n - 1];
+    return w->err;
+}
+
+int fi_write_path(FI_WRITER *w, FI_PATH *in) {
+    for (FI_PATH *tmp = in; tmp != NULL && w->err == 0; tmp = tmp->next)
+        fi_write_seg(w, tmp->section.type, tmp->section.flag,
+                     tmp->section.points);
+    return w->err;
+}
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <math.h>
 #include <argp.h>
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
@@ -33,6 +34,24 @@ int _parse_path(const char *in, FI_PATH **out) {
     return fi_parse_path(in, s_in, out);
 }
 
+char *_draw_path(FI_PATH *path) {
+    char *str;
+    size_t len;
+    FILE *stream = open_memstream(&str, &len);
+    fi_draw_path(path, stream);
+    fclose(stream);
+    return str;
+}
+
+char *_draw_packed(FI_PACKED_PATH *path) {
+    char *str;
+    size_t len;
+    FILE *stream = open_memstream(&str, &len);
+    fi_draw_packed(path, stream);
+    fclose(stream);
+    return str;
+}
+
 static error_t parse_opt(int key, char *arg, struct argp_state *state) {
     /* Get the input argument from argp_parse, which we
        know is a pointer to our arguments structure. */
@@ -88,6 +107,240 @@ void test_parse() {
     fi_free_path(path);
 }
 
+void test_parse_grammar() {
+    FI_PATH *path;
+    int ret = _parse_path("m10-20l.5.5h10v-10H1V2"
+                          "c1,1 2,2 3,3s4,4 5,5S1 1 2 2"
+                          "q1 1 2 2t3 3T10 10"
+                          "a5 5 30 1020 20zl1e1,-1.5E-1 2e+1 +3 Z",
+                          &path);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(path->meta->n_move == 1);
+    CU_ASSERT(path->meta->n_line == 7);
+    CU_ASSERT(path->meta->n_cbez == 3);
+    CU_ASSERT(path->meta->n_qbez == 3);
+    CU_ASSERT(path->meta->n_arc == 1);
+    CU_ASSERT(path->meta->n_end == 2);
+
+    // absolute points of all the segments, in order
+    FI_POINT_D expected[] = {
+        {10, -20}, {10.5, -19.5}, {20.5, -19.5}, {20.5, -29.5}, {1, -29.5},
+        {1, 2},    {2, 3},        {3, 4},        {4, 5},        {5, 6},
+        {8, 9},    {9, 10},       {10, 11},      {1, 1},        {2, 2},
+        {3, 3},    {4, 4},        {5, 5},        {7, 7},        {9, 9},
+        {10, 10},  {5, 5},        {30, 0},       {30, 30},      {20, -20.15},
+        {40, -17.15}};
+    size_t n = 0;
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        for (int i = 0; i < tmp->section.n_point; i++, n++) {
+            CU_ASSERT(n < sizeof(expected) / sizeof(expected[0]));
+            if (n >= sizeof(expected) / sizeof(expected[0]))
+                break;
+            CU_ASSERT_DOUBLE_EQUAL(tmp->section.points[i].x, expected[n].x,
+                                   1e-12);
+            CU_ASSERT_DOUBLE_EQUAL(tmp->section.points[i].y, expected[n].y,
+                                   1e-12);
+        }
+        if (tmp->section.type == FI_SEG_ARC)
+            CU_ASSERT(tmp->section.flag == FI_LARGE_ARC);
+    }
+    CU_ASSERT(n == sizeof(expected) / sizeof(expected[0]));
+    fi_free_path(path);
+
+    // numbers without a command
+    ret = _parse_path("1 2 M 0 0", &path);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    ret = _parse_path("M 0 0 Z 1 2", &path);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    // invalid arc flag
+    ret = _parse_path("M 0 0 A 1 1 0 2 0 1 1", &path);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+}
+
+void test_parse_number() {
+    const char *numbers[] = {"0",
+                             "-0",
+                             "0.1",
+                             ".5e+3",
+                             "1E-2",
+                             "123456.789",
+                             "9007199254740993",
+                             "123456789012345678901234567890",
+                             "0.000000000000000000000000000123",
+                             "1e-300",
+                             "1.7976931348623157e308",
+                             "2.2250738585072011e-308",
+                             "4.9406564584124654e-324",
+                             "2.4703282292062327e-324",
+                             "1e400",
+                             "3.14159265358979323846264338327950288",
+                             "0.30000000000000004441",
+                             "7.038531e-26"};
+    for (size_t k = 0; k < sizeof(numbers) / sizeof(numbers[0]); k++) {
+        size_t pos = 0;
+        double v;
+        int ret = fi_parse_number(numbers[k], strlen(numbers[k]), &pos, &v);
+        double ref = strtod(numbers[k], NULL);
+        CU_ASSERT(ret == 0);
+        CU_ASSERT(pos == strlen(numbers[k]));
+        CU_ASSERT(memcmp(&v, &ref, sizeof(double)) == 0);
+    }
+
+    // end of a number
+    size_t pos = 0;
+    double v;
+    CU_ASSERT(fi_parse_number("1.5.5", 5, &pos, &v) == 0);
+    CU_ASSERT(pos == 3 && v == 1.5);
+    pos = 0;
+    CU_ASSERT(fi_parse_number("-2e", 3, &pos, &v) == 0);
+    CU_ASSERT(pos == 2 && v == -2);
+    pos = 0;
+    CU_ASSERT(fi_parse_number("-.", 2, &pos, &v) == ERR_PARSING_FAIL);
+}
+
+int _count_seg(FI_SEG_TYPE type, FI_SEG_FLAG flag, FI_POINT_D *points,
+               void *data) {
+    int *count = data;
+    count[type]++;
+    // stop at the first arc
+    return type == FI_SEG_ARC ? ERR_PARSING_FAIL : 0;
+}
+
+void test_parser() {
+    const char *str = "M 0.0,1.1 l10.0-23.5432e1 L .5.5 H 1e-3 v2 "
+                      "C 50.2,0.567 40,10 5,5.69 s1 2 3 4 Q 1,1 2,2 t3 3 "
+                      "a 10,5 30 1,0 49,10.2 Z m1 1 2 2 3 3z";
+    size_t len = strlen(str);
+    FI_PATH *ref;
+    int ret = _parse_path(str, &ref);
+    CU_ASSERT(ret == 0);
+    char *s_ref = _draw_path(ref);
+
+    // numbers cut at any place, in chunks of any size
+    for (size_t size = 1; size <= len; size++) {
+        FI_PARSER *parser = fi_parser_new(NULL, NULL);
+        for (size_t i = 0; i < len; i += size) {
+            size_t n = len - i < size ? len - i : size;
+            ret = fi_parser_feed(parser, str + i, n);
+            CU_ASSERT(ret == 0);
+        }
+        FI_PATH *path;
+        ret = fi_parser_finish(parser, &path);
+        CU_ASSERT(ret == 0);
+        fi_parser_free(parser);
+
+        char *s_path = _draw_path(path);
+        CU_ASSERT_STRING_EQUAL(s_ref, s_path);
+        CU_ASSERT(path->meta->n_total == ref->meta->n_total);
+        free(s_path);
+        fi_free_path(path);
+    }
+    free(s_ref);
+    fi_free_path(ref);
+
+    // segments given to a callback, which can stop the parsing
+    int count[6] = {0};
+    FI_PARSER *parser = fi_parser_new(_count_seg, count);
+    ret = fi_parser_feed(parser, str, 40);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(count[FI_SEG_MOVE] == 1 && count[FI_SEG_LINE] == 3);
+    ret = fi_parser_feed(parser, str + 40, len - 40);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    CU_ASSERT(count[FI_SEG_ARC] == 1 && count[FI_SEG_END] == 0);
+    ret = fi_parser_feed(parser, "L 1 1", 5);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    fi_parser_free(parser);
+
+    // errors are kept
+    FI_PATH *path;
+    parser = fi_parser_new(NULL, NULL);
+    ret = fi_parser_feed(parser, "M 1 2 L 3", 9);
+    CU_ASSERT(ret == 0);
+    ret = fi_parser_feed(parser, "x", 1);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    ret = fi_parser_finish(parser, &path);
+    CU_ASSERT(ret == ERR_PARSING_FAIL);
+    CU_ASSERT_PTR_NULL(path);
+    fi_parser_free(parser);
+}
+
+void test_writer() {
+    const char *str = "M 0.0,1.1 L 10.0,23.5432 L 0.5,42.987 "
+                      "A 30 50 45.1 1 1 162.55 140.45 C 50.2,0.567 40,10 "
+                      "5,5.69 Q 123,1.3 22.3,123 Z M 1e-7,-3 L 2,2.123456789 Z";
+    FI_PATH *path;
+    int ret = _parse_path(str, &path);
+    CU_ASSERT(ret == 0);
+
+    // same text as the stream API
+    FI_WRITER w;
+    fi_writer_init(&w, NULL, 0);
+    ret = fi_write_path(&w, path);
+    CU_ASSERT(ret == 0);
+    char *s_draw = _draw_path(path);
+    CU_ASSERT_STRING_EQUAL(w.buf, s_draw);
+    CU_ASSERT(w.len == strlen(s_draw));
+    free(s_draw);
+    fi_writer_free(&w);
+
+    // shortest and relative texts read back to the same points
+    for (int k = 0; k < 3; k++) {
+        fi_writer_init(&w, NULL, 0);
+        w.precision = k == 1 ? 4 : -1;
+        w.relative = k > 0;
+        ret = fi_write_path(&w, path);
+        CU_ASSERT(ret == 0);
+        CU_ASSERT(strchr(w.buf, k > 0 ? 'l' : 'L') != NULL);
+        FI_PATH *back;
+        ret = _parse_path(w.buf, &back);
+        CU_ASSERT(ret == 0);
+        CU_ASSERT(back->meta->n_total == path->meta->n_total);
+        double tol = k == 1 ? 0.5e-4 : (k == 2 ? 1e-13 : 0);
+        for (FI_PATH *a = path, *b = back; a != NULL && b != NULL;
+             a = a->next, b = b->next) {
+            CU_ASSERT(a->section.type == b->section.type);
+            CU_ASSERT(a->section.flag == b->section.flag);
+            for (int i = 0; i < a->section.n_point; i++) {
+                CU_ASSERT(fabs(a->section.points[i].x -
+                               b->section.points[i].x) <= tol);
+                CU_ASSERT(fabs(a->section.points[i].y -
+                               b->section.points[i].y) <= tol);
+            }
+        }
+        fi_free_path(back);
+        fi_writer_free(&w);
+    }
+
+    // relative output does not drift
+    FI_PATH *line = NULL;
+    fi_append_new_seg(&line, FI_SEG_MOVE);
+    for (int i = 1; i < 900; i++) {
+        fi_append_new_seg(&line, FI_SEG_LINE);
+        line->meta->last->section.points[0] = (FI_POINT_D){i * 0.33333, 0};
+    }
+    fi_writer_init(&w, NULL, 0);
+    w.relative = true;
+    w.precision = 2;
+    fi_write_path(&w, line);
+    FI_PATH *back;
+    ret = _parse_path(w.buf, &back);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(fabs(back->meta->last->section.points[0].x - 899 * 0.33333) <=
+              0.005 + 1e-9);
+    fi_free_path(back);
+    fi_free_path(line);
+    fi_writer_free(&w);
+
+    // caller supplied buffer
+    char buf[32];
+    fi_writer_init(&w, buf, sizeof(buf));
+    ret = fi_write_path(&w, path);
+    CU_ASSERT(ret == ERR_BUFFER_FULL);
+    CU_ASSERT(w.len < sizeof(buf) && strlen(buf) == w.len);
+    CU_ASSERT(strncmp(buf, "M 0.0000,1.1000 L ", 18) == 0);
+    fi_free_path(path);
+}
+
 void test_validate() {
     FI_PATH *path;
     int err;
@@ -286,6 +539,192 @@ void test_meta() {
     fi_free_path(path);
 }
 
+void test_arena() {
+    FI_PATH *path;
+    int ret =
+        _parse_path("M 0,0 L 10,0 C 20,0 20,10 10,10 Q 0,10 0,5 Z", &path);
+    CU_ASSERT(ret == 0);
+    fi_linearize(&path);
+#ifdef FI_PATH_ARENA
+    // the segments of the curves were moved in the arena of the path
+    CU_ASSERT_PTR_NOT_NULL(path->meta->arena);
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next)
+        if (tmp->section.n_point)
+            CU_ASSERT_PTR_EQUAL(tmp->section.points, (FI_POINT_D *)(tmp + 1));
+#else
+    CU_ASSERT_PTR_NULL(path->meta->arena);
+#endif
+    CU_ASSERT(path->meta->n_total == 2 + 2 * (BEZIER_RES + 1) + 1);
+    CU_ASSERT(path->meta->n_cbez == 0);
+    fi_free_path(path);
+}
+
+double _seg_distance(FI_POINT_D p, FI_POINT_D a, FI_POINT_D b) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double len = dx * dx + dy * dy;
+    double t = len > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len : 0;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    return hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+void test_linearize_tolerance() {
+    FI_POINT_D ctrl[3] = {{147.41071, 143.54167},
+                          {96.761905, 262.98214},
+                          {63.499999, 170}};
+    FI_POINT_D start = {90, 90};
+    double tolerances[] = {1, 0.1, 0.001};
+
+    for (int k = 0; k < 3; k++) {
+        FI_PATH *path;
+        int ret = _parse_path("M 90,90 C 147.41071,143.54167 "
+                              "96.761905,262.98214 63.499999,170 Z",
+                              &path);
+        CU_ASSERT(ret == 0);
+        fi_linearize_tolerance(&path, tolerances[k]);
+        CU_ASSERT(path->meta->n_cbez == 0);
+        if (k == 0)
+            CU_ASSERT(path->meta->n_line < 15);
+
+        // points of the curve are close to the polyline
+        FI_POINT_D curve[1001];
+        fi_cub_bezier_points(start, ctrl, 1000, 0, curve);
+        for (int i = 0; i <= 1000; i++) {
+            double d = INFINITY;
+            FI_POINT_D prev = start;
+            for (FI_PATH *tmp = path->next; tmp->section.type == FI_SEG_LINE;
+                 tmp = tmp->next) {
+                d = fmin(d, _seg_distance(curve[i], prev,
+                                          tmp->section.points[0]));
+                prev = tmp->section.points[0];
+            }
+            CU_ASSERT(d <= tolerances[k]);
+        }
+        fi_free_path(path);
+    }
+
+    // a flat or tiny curve is a single segment
+    FI_PATH *path;
+    int ret =
+        _parse_path("M 0,0 C 1,1 2,2 3,3 Q 3.001,3 3.002,3.001 Z", &path);
+    CU_ASSERT(ret == 0);
+    fi_linearize_tolerance(&path, 0.01);
+    CU_ASSERT(path->meta->n_line == 2);
+    fi_free_path(path);
+}
+
+void test_bezier_points() {
+    FI_POINT_D start = {90, 90};
+    FI_POINT_D ctrl[3] = {{147.41071, 143.54167},
+                          {96.761905, 262.98214},
+                          {63.499999, 170}};
+    FI_POINT_D out[1001];
+
+    // cubic, against de Casteljau, first point skipped
+    fi_cub_bezier_points(start, ctrl, 1000, 1, out);
+    for (int i = 1; i <= 1000; i++) {
+        double t = i / 1000.0;
+        FI_POINT_D p[4] = {start, ctrl[0], ctrl[1], ctrl[2]};
+        for (int k = 3; k > 0; k--)
+            for (int j = 0; j < k; j++) {
+                p[j].x += t * (p[j + 1].x - p[j].x);
+                p[j].y += t * (p[j + 1].y - p[j].y);
+            }
+        CU_ASSERT(fabs(out[i - 1].x - p[0].x) < 1e-9);
+        CU_ASSERT(fabs(out[i - 1].y - p[0].y) < 1e-9);
+    }
+    CU_ASSERT(out[999].x == ctrl[2].x && out[999].y == ctrl[2].y);
+
+    // quadratic, odd number of points
+    fi_qua_bezier_points(start, ctrl, 7, 0, out);
+    CU_ASSERT(out[0].x == start.x && out[0].y == start.y);
+    CU_ASSERT(out[7].x == ctrl[1].x && out[7].y == ctrl[1].y);
+    for (int i = 0; i <= 7; i++) {
+        double t = i / 7.0;
+        double x = (1 - t) * (1 - t) * start.x + 2 * t * (1 - t) * ctrl[0].x +
+                   t * t * ctrl[1].x;
+        double y = (1 - t) * (1 - t) * start.y + 2 * t * (1 - t) * ctrl[0].y +
+                   t * t * ctrl[1].y;
+        CU_ASSERT(fabs(out[i].x - x) < 1e-9);
+        CU_ASSERT(fabs(out[i].y - y) < 1e-9);
+    }
+}
+
+void test_arc_tolerance() {
+    FI_POINT_D start = {0, 0};
+    FI_POINT_D arc[3] = {{50, 30}, {30, 0}, {80, 20}};
+    FI_PARAM_ARC param =
+        fi_arc_endpoint_to_center(start, arc[2], arc[0], 30, FI_SWEEP);
+    double tolerances[] = {1, 0.01};
+
+    for (int k = 0; k < 2; k++) {
+        FI_PATH *path;
+        int ret = _parse_path("M 0,0 A 50 30 30 0 1 80,20 L 0,40 Z", &path);
+        CU_ASSERT(ret == 0);
+        fi_linearize_tolerance(&path, tolerances[k]);
+        CU_ASSERT(path->meta->n_arc == 0);
+        if (k == 0)
+            CU_ASSERT(path->meta->n_line < 10);
+
+        // points of the arc are close to the polyline
+        for (int i = 0; i <= 1000; i++) {
+            double a = param.angle_s + i / 1000.0 * param.angle_d;
+            double x = param.radius.x * cos(a);
+            double y = param.radius.y * sin(a);
+            FI_POINT_D p = {x * param.cos_phi - y * param.sin_phi +
+                                param.center.x,
+                            x * param.sin_phi + y * param.cos_phi +
+                                param.center.y};
+            double d = INFINITY;
+            FI_POINT_D prev = start;
+            FI_PATH *tmp = path->next;
+            for (; tmp->next->section.type == FI_SEG_LINE; tmp = tmp->next) {
+                d = fmin(d, _seg_distance(p, prev, tmp->section.points[0]));
+                prev = tmp->section.points[0];
+            }
+            CU_ASSERT(d <= tolerances[k] + 1e-9);
+        }
+        // the arc ends exactly on its end point
+        FI_POINT_D end = path->meta->last->prev->prev->section.points[0];
+        CU_ASSERT(end.x == 80 && end.y == 20);
+        fi_free_path(path);
+    }
+
+    // the curve after an arc starts at the end of the arc
+    FI_PATH *path;
+    int ret = _parse_path("M 0,0 A 50 30 30 0 1 80,20 Q 100,40 120,20 Z",
+                          &path);
+    CU_ASSERT(ret == 0);
+    fi_linearize(&path);
+    FI_PATH *tmp = path;
+    for (int i = 0; i < ARC_RES + 2; i++)
+        tmp = tmp->next;
+    CU_ASSERT(tmp->section.points[0].x == 80);
+    CU_ASSERT(tmp->section.points[0].y == 20);
+    fi_free_path(path);
+
+    // batch of arcs, same points as one by one
+    FI_POINT_D starts[3] = {{0, 0}, {80, 20}, {80, 20}};
+    FI_POINT_D arcs[9] = {arc[0], arc[1], arc[2], {0, 10}, {0, 0}, {90, 30},
+                          {10, 10}, {0, 0}, {80, 0}};
+    FI_SEG_FLAG flags[3] = {FI_SWEEP, 0, FI_LARGE_ARC};
+    FI_POINT_D *out = NULL;
+    FI_POINT_D *buf = NULL;
+    int s_buf = 0;
+    size_t offset[4];
+    ret = fi_flatten_arcs(starts, arcs, flags, 3, 0.01, &out, offset);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(offset[2] - offset[1] == 1);
+    for (int i = 0; i < 3; i++) {
+        int n = fi_arc_flatten(starts[i], &arcs[3 * i], flags[i], 0.01, &buf,
+                               &s_buf);
+        CU_ASSERT(n == (int)(offset[i + 1] - offset[i]));
+        CU_ASSERT(memcmp(buf, out + offset[i], n * sizeof(FI_POINT_D)) == 0);
+    }
+    free(out);
+    free(buf);
+}
+
 void test_cub_bezier2seg() {
     FI_PATH *path;
     int ret = _parse_path(
@@ -532,6 +971,336 @@ void test_copy() {
     fi_free_path(in);
 }
 
+void test_packed() {
+    FI_PATH *in;
+    int ret = _parse_path("M 0.0,1.1 L 10.0,23.5432 L 0.5,42.987 C 50.2,0.567 "
+                          "40,10 5,5.69 Q 1,1 2,2 A 10,5 30 1,0 49,10.2 Z "
+                          "M 100,100 L 110,100 L 110,110 Z",
+                          &in);
+    CU_ASSERT(ret == 0);
+
+    FI_PACKED_PATH *packed;
+    ret = fi_pack_path(in, &packed);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(packed->n_seg == 11);
+    CU_ASSERT(packed->n_point == 14);
+    CU_ASSERT(packed->n_subpath == 2);
+    CU_ASSERT(packed->subpaths[1] == 7);
+
+    char *s_in = _draw_path(in);
+    char *s_packed = _draw_packed(packed);
+    CU_ASSERT_STRING_EQUAL(s_in, s_packed);
+    free(s_packed);
+
+    // the view shares the points of the packed path
+    FI_PATH *view;
+    ret = fi_unpack_path(packed, &view);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(view->meta->n_total == in->meta->n_total);
+    CU_ASSERT(view->meta->n_cbez == 1);
+    CU_ASSERT(view->meta->last->section.type == FI_SEG_END);
+    CU_ASSERT(view->next->section.points == &packed->points[1]);
+    char *s_view = _draw_path(view);
+    CU_ASSERT_STRING_EQUAL(s_in, s_view);
+    free(s_view);
+
+    FI_POINT_D offset = {10, -5};
+    fi_offset_packed(packed, offset);
+    fi_offset_path(in, offset);
+    s_view = _draw_path(view);
+    free(s_in);
+    s_in = _draw_path(in);
+    CU_ASSERT_STRING_EQUAL(s_in, s_view);
+    free(s_view);
+
+    // linearizing the view replaces borrowed segments
+    FI_PACKED_PATH *copy;
+    fi_copy_packed(packed, &copy);
+    fi_linearize(&view);
+    fi_linearize_packed(&copy);
+    CU_ASSERT(copy->n_seg == (size_t)view->meta->n_total);
+    CU_ASSERT(copy->n_subpath == 2);
+    CU_ASSERT(view->meta->n_line == 4 + 2 * (BEZIER_RES + 1) + ARC_RES + 1);
+    CU_ASSERT(view->meta->n_arc + view->meta->n_qbez + view->meta->n_cbez == 0);
+    s_view = _draw_path(view);
+    s_packed = _draw_packed(copy);
+    CU_ASSERT_STRING_EQUAL(s_view, s_packed);
+    free(s_view);
+    free(s_packed);
+
+    fi_free_path(view);
+    fi_free_packed(copy);
+    fi_free_packed(packed);
+    fi_free_path(in);
+    free(s_in);
+}
+
+void test_binary() {
+    FI_PATH *in;
+    int ret = _parse_path("M 0.0,1.1 L 10.0,23.5432 L 0.5,42.987 C 50.2,0.567 "
+                          "40,10 5,5.69 Q 1,1 2,2 A 10,5 30 1,0 49,10.2 Z "
+                          "M 100,100 L 110,100 L 110,110 Z",
+                          &in);
+    CU_ASSERT(ret == 0);
+    FI_PACKED_PATH *packed;
+    fi_pack_path(in, &packed);
+    char *s_in = _draw_path(in);
+
+    size_t size = fi_binary_size(packed);
+    CU_ASSERT(size == 96 + 14 * 16 + 2 * 8 + 16);
+    double *buf = malloc(size + 8);
+    CU_ASSERT(fi_encode_binary(packed, buf, size - 1) == ERR_BUFFER_FULL);
+    CU_ASSERT(fi_encode_binary(packed, buf, size) == 0);
+
+    FI_BINARY_HEADER hdr;
+    CU_ASSERT(fi_read_binary_header(buf, size, &hdr) == 0);
+    CU_ASSERT(hdr.n_seg == 11 && hdr.n_point == 14 && hdr.n_subpath == 2);
+    CU_ASSERT(hdr.n_move == 2 && hdr.n_line == 4 && hdr.n_end == 2);
+    // the bbox contains the arc (bounded by a circle)
+    CU_ASSERT(hdr.bbox[0].x <= 0 && hdr.bbox[0].y <= 0.567);
+    CU_ASSERT(hdr.bbox[1].x == 110 && hdr.bbox[1].y == 110);
+
+    // aligned data is used in place, the view reads the points from it
+    FI_PACKED_PATH *loaded;
+    CU_ASSERT(fi_load_binary(buf, size, &loaded) == 0);
+    CU_ASSERT(loaded->borrowed);
+    CU_ASSERT((void *)loaded->points == (char *)buf + 96);
+    CU_ASSERT(loaded->subpaths[1] == 7);
+    FI_PATH *view;
+    fi_unpack_path(loaded, &view);
+    CU_ASSERT(view->next->section.points == &loaded->points[1]);
+    char *s_view = _draw_path(view);
+    CU_ASSERT_STRING_EQUAL(s_in, s_view);
+    free(s_view);
+    fi_free_path(view);
+
+    // appending copies the arrays first
+    fi_append_packed_seg(&loaded, FI_SEG_MOVE, 0);
+    CU_ASSERT(!loaded->borrowed);
+    CU_ASSERT(loaded->n_subpath == 3 && loaded->subpaths[2] == 11);
+    fi_free_packed(loaded);
+
+    // unaligned data is copied
+    memmove((char *)buf + 4, buf, size);
+    CU_ASSERT(fi_load_binary((char *)buf + 4, size, &loaded) == 0);
+    CU_ASSERT(!loaded->borrowed);
+    char *s_loaded = _draw_packed(loaded);
+    CU_ASSERT_STRING_EQUAL(s_in, s_loaded);
+    free(s_loaded);
+    fi_free_packed(loaded);
+    memmove(buf, (char *)buf + 4, size);
+
+    // invalid data
+    unsigned char *bytes = (unsigned char *)buf;
+    CU_ASSERT(fi_load_binary(buf, size - 8, &loaded) == ERR_BINARY_FORMAT);
+    CU_ASSERT(loaded == NULL);
+    bytes[96 + 14 * 16 + 16 + 3] = 0x07; // type of segment 3
+    CU_ASSERT(fi_load_binary(buf, size, &loaded) == ERR_BINARY_FORMAT);
+    bytes[96 + 14 * 16 + 16 + 3] = FI_SEG_CUB_BEZIER;
+    bytes[96 + 14 * 16 + 8] = 6; // second subpath
+    CU_ASSERT(fi_load_binary(buf, size, &loaded) == ERR_BINARY_FORMAT);
+    bytes[96 + 14 * 16 + 8] = 7;
+    bytes[8] = FI_BINARY_VERSION + 1;
+    CU_ASSERT(fi_load_binary(buf, size, &loaded) == ERR_BINARY_VERSION);
+    bytes[8] = FI_BINARY_VERSION;
+    bytes[0] = 'X';
+    CU_ASSERT(fi_load_binary(buf, size, &loaded) == ERR_BINARY_FORMAT);
+    free(buf);
+
+    // file mapping
+    char filename[] = "/tmp/ficlip-test-XXXXXX";
+    int fd = mkstemp(filename);
+    FILE *f = fdopen(fd, "wb");
+    CU_ASSERT(fi_save_binary(packed, f) == 0);
+    fclose(f);
+    CU_ASSERT(fi_map_binary(filename, &loaded) == 0);
+    CU_ASSERT(loaded->map != NULL && loaded->s_map == size);
+    s_loaded = _draw_packed(loaded);
+    CU_ASSERT_STRING_EQUAL(s_in, s_loaded);
+    free(s_loaded);
+    FI_POINT_D offset = {10, -5};
+    fi_offset_packed(loaded, offset);
+    CU_ASSERT(loaded->points[0].x == 10);
+    fi_free_packed(loaded);
+    CU_ASSERT(fi_map_binary(filename, &loaded) == 0);
+    CU_ASSERT(loaded->points[0].x == 0);
+    fi_free_packed(loaded);
+    remove(filename);
+    CU_ASSERT(fi_map_binary(filename, &loaded) == ERR_IO);
+
+    fi_free_packed(packed);
+    fi_free_path(in);
+    free(s_in);
+}
+
+void test_linearize_to() {
+    const char *str = "M 0,0 L 10,0 C 20,0 20,10 10,10 Q 0,10 0,5 "
+                      "A 5,5 0 0,1 5,0 Z M 30,30 L 40,30 L 40,40 Z";
+    double tolerances[] = {0, 0.1};
+
+    for (int k = 0; k < 2; k++) {
+        FI_PATH *in;
+        FI_PATH *out;
+        FI_PATH *ref;
+        int ret = _parse_path(str, &in);
+        CU_ASSERT(ret == 0);
+        char *s_in = _draw_path(in);
+
+        ret = fi_linearize_to(in, tolerances[k], &out);
+        CU_ASSERT(ret == 0);
+        CU_ASSERT(out->meta != in->meta);
+        CU_ASSERT(out->meta->n_arc + out->meta->n_qbez + out->meta->n_cbez ==
+                  0);
+        CU_ASSERT(out->meta->n_total == out->meta->n_end + out->meta->n_move +
+                                            out->meta->n_line);
+        CU_ASSERT_PTR_NULL(out->prev);
+        CU_ASSERT_PTR_NULL(out->meta->last->next);
+        if (k == 0) {
+            // the output was sized exactly, one block of the arena
+            CU_ASSERT(out->meta->n_total ==
+                      fi_linearize_n_seg(in->meta, tolerances[k]));
+            CU_ASSERT_PTR_NULL(out->meta->arena->head->next);
+        }
+
+        // the input is untouched
+        char *s_after = _draw_path(in);
+        CU_ASSERT_STRING_EQUAL(s_in, s_after);
+
+        // same result as in place
+        fi_copy_path(in, &ref);
+        fi_linearize_tolerance(&ref, tolerances[k]);
+        char *s_ref = _draw_path(ref);
+        char *s_out = _draw_path(out);
+        CU_ASSERT_STRING_EQUAL(s_ref, s_out);
+        CU_ASSERT(ref->meta->n_total == out->meta->n_total);
+
+        free(s_in);
+        free(s_after);
+        free(s_ref);
+        free(s_out);
+        fi_free_path(in);
+        fi_free_path(out);
+        fi_free_path(ref);
+    }
+}
+
+void test_event_queue() {
+    FI_SWEEP_STATE sweep = {0};
+    fi_arena_init(&sweep.events, 0);
+
+    // pseudo random points, pushed one at a time then heapified at once
+    for (int i = 0; i < 1000; i++) {
+        FI_POINT_D pt = {(i * 7919) % 101, (i * 104729) % 37};
+        FI_SWEEPEVENT *event =
+            fi_arena_alloc(&sweep.events, sizeof(FI_SWEEPEVENT));
+        event->point = pt;
+        event->other = event;
+        event->is_left_event = i % 2;
+        if (i < 500)
+            fi_queue_push(&sweep.queue, event);
+        else
+            fi_queue_append(&sweep.queue, event);
+    }
+    fi_sort_events(&sweep.queue);
+
+    FI_SWEEPEVENT *prev = fi_queue_pop(&sweep.queue);
+    FI_SWEEPEVENT *event;
+    int n = 1;
+    while ((event = fi_queue_pop(&sweep.queue)) != NULL) {
+        CU_ASSERT(fi_compare_point(prev->point, event->point) <= 0);
+        if (fi_compare_point(prev->point, event->point) == 0)
+            // right events first
+            CU_ASSERT(!(prev->is_left_event && !event->is_left_event));
+        prev = event;
+        n++;
+    }
+    CU_ASSERT(n == 1000);
+    CU_ASSERT(fi_queue_pop(&sweep.queue) == NULL);
+    fi_free_sweep(&sweep);
+}
+
+void test_status() {
+    FI_SWEEP_STATE sweep = {0};
+    FI_SWEEPEVENT *events[200];
+    fi_arena_init(&sweep.events, 0);
+
+    // horizontal edges, inserted in a scrambled order of y
+    for (int i = 0; i < 200; i++) {
+        FI_SWEEPEVENT *l =
+            fi_arena_alloc(&sweep.events, sizeof(FI_SWEEPEVENT));
+        FI_SWEEPEVENT *r =
+            fi_arena_alloc(&sweep.events, sizeof(FI_SWEEPEVENT));
+        double y = (i * 37) % 200;
+        l->point = (FI_POINT_D){0, y};
+        r->point = (FI_POINT_D){10, y};
+        l->is_left_event = true;
+        l->other = r;
+        r->other = l;
+        events[i] = l;
+        fi_status_insert(&sweep, l);
+    }
+    // remove every third edge
+    for (int i = 0; i < 200; i += 3)
+        fi_status_remove(&sweep, events[i]);
+    CU_ASSERT(sweep.n_status == 133);
+
+    FI_SWEEPEVENT *e = sweep.status;
+    while (fi_status_prev(e) != NULL)
+        e = fi_status_prev(e);
+    int n = 1;
+    for (FI_SWEEPEVENT *next = fi_status_next(e); next != NULL;
+         next = fi_status_next(next)) {
+        CU_ASSERT(e->point.y < next->point.y);
+        CU_ASSERT(fi_status_prev(next) == e);
+        e = next;
+        n++;
+    }
+    CU_ASSERT(n == 133);
+    for (int i = 0; i < 200; i++)
+        CU_ASSERT(events[i]->node.linked == (i % 3 != 0));
+    fi_free_sweep(&sweep);
+}
+
+void test_predicates() {
+    // points a few ulps from the line of b and c, wrong signs with doubles
+    FI_POINT_D b = {12, 12};
+    FI_POINT_D c = {24, 24};
+    for (int i = 0; i < 16; i++) {
+        for (int j = 0; j < 16; j++) {
+            FI_POINT_D a = {0.5 + i * 0x1p-53, 0.5 + j * 0x1p-53};
+            double det = fi_orient2d(a, b, c);
+            CU_ASSERT_EQUAL((det > 0) - (det < 0), (j > i) - (j < i));
+            CU_ASSERT_EQUAL(fi_signed_area(a, b, c), det);
+        }
+    }
+
+    // the differences are rounded, the point is just above the line y = 3x
+    FI_POINT_D p1 = {0x1p-60, 3 * 0x1p-60};
+    FI_POINT_D p2 = {1, 3};
+    FI_POINT_D p3 = {0x1p54, 3 * 0x1p54};
+    CU_ASSERT(fi_orient2d(p1, p2, p3) == 0);
+    p1.y = nextafter(p1.y, 1);
+    CU_ASSERT(fi_orient2d(p1, p2, p3) > 0);
+    CU_ASSERT(fi_orient2d(p2, p1, p3) < 0);
+
+    FI_POINT_D q[3] = {{1, 0}, {0, 1}, {-1, 0}};
+    FI_POINT_D d = {0, -1};
+    CU_ASSERT(fi_incircle(q[0], q[1], q[2], d) == 0);
+    d.y = nextafter(-1, 0);
+    CU_ASSERT(fi_incircle(q[0], q[1], q[2], d) > 0);
+    CU_ASSERT(fi_incircle(q[2], q[1], q[0], d) < 0);
+    d.y = nextafter(-1, -2);
+    CU_ASSERT(fi_incircle(q[0], q[1], q[2], d) < 0);
+
+    // a small circle far from the origin
+    for (int i = 0; i < 3; i++)
+        q[i] = (FI_POINT_D){q[i].x * 0x1p-30 + 0x1p20, q[i].y * 0x1p-30};
+    d = (FI_POINT_D){0x1p20, -0x1p-30};
+    CU_ASSERT(fi_incircle(q[0], q[1], q[2], d) == 0);
+    d.x = nextafter(d.x, 0);
+    CU_ASSERT(fi_incircle(q[0], q[1], q[2], d) < 0);
+}
+
 void test_sort() {
     FI_PATH *in_1;
     FI_PATH *in_2;
@@ -608,12 +1377,1103 @@ void test_parse_fail_to_long() {
         "CCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCCC"
         "CCCCCCCCCCCCCCCCCCCCCC",
         &path);
-    CU_ASSERT(ret == 2);
+    // paths are not limited in length anymore
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(path->meta->n_total == 1002);
+    CU_ASSERT(path->meta->n_cbez == 1002);
+
+    // unless a limit is set
+    path->meta->n_max = 1002;
+    CU_ASSERT(fi_append_new_seg(&path, FI_SEG_END) == ERR_PATH_TOO_LONG);
+    path->meta->n_max = 0;
+    CU_ASSERT(fi_append_new_seg(&path, FI_SEG_END) == 0);
+    fi_free_path(path);
+}
+
+void test_reserve() {
+    const int n = 200000;
+    FI_PATH *path = NULL;
+    fi_append_new_seg(&path, FI_SEG_MOVE);
+    fi_append_new_seg(&path, FI_SEG_LINE);
+    path->meta->last->section.points[0].x = 1;
+    fi_reserve_path(&path, n);
+
+    // the segments already there were moved in the arena
+    CU_ASSERT_PTR_NOT_NULL(path->meta->arena);
+    CU_ASSERT(path->meta->first == path);
+    CU_ASSERT(path->next->section.points[0].x == 1);
+    CU_ASSERT_PTR_EQUAL(path->next->section.points,
+                        (FI_POINT_D *)(path->next + 1));
+
+    // appending does not allocate another block
+    FI_ARENA_BLOCK *head = path->meta->arena->head;
+    int ret = 0;
+    for (int i = 0; i < n && ret == 0; i++) {
+        ret = fi_append_new_seg(&path, FI_SEG_LINE);
+        path->meta->last->section.points[0].y = i;
+    }
+    CU_ASSERT(ret == 0);
+    CU_ASSERT_PTR_EQUAL(path->meta->arena->head, head);
+    CU_ASSERT(path->meta->n_total == n + 2);
+    CU_ASSERT(path->meta->last->section.points[0].y == n - 1);
+    CU_ASSERT(path->meta->last->prev->section.points[0].y == n - 2);
+
+    // long paths can be parsed, linearized and copied
+    FI_PATH *copy;
+    fi_copy_path(path, &copy);
+    CU_ASSERT(copy->meta->n_total == n + 2);
+    CU_ASSERT(copy->meta->last->section.points[0].y == n - 1);
+    fi_free_path(copy);
     fi_free_path(path);
+    path = NULL;
+    fi_reserve_path(&path, 10);
+    CU_ASSERT_PTR_NULL(path);
+}
+
+/* sum of the areas of the rings of a path, for non nested rings */
+double _path_area(FI_PATH *path) {
+    double area = 0;
+    double ring = 0;
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    FI_PATH *tmp = path;
+    while (tmp != NULL) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
+            ring = 0;
+            break;
+        case FI_SEG_LINE:
+            ring += last.x * pt[0].y - pt[0].x * last.y;
+            last = pt[0];
+            break;
+        case FI_SEG_END:
+            ring += last.x * first.y - first.x * last.y;
+            area += ring < 0 ? -ring / 2 : ring / 2;
+            break;
+        default:
+            break;
+        }
+        tmp = tmp->next;
+    }
+    return area;
+}
+
+size_t _path_edges(FI_PATH *path, FI_POINT_D **out) {
+    size_t n = 0;
+    FI_POINT_D first = {0};
+    FI_POINT_D last = {0};
+    *out = malloc((path ? path->meta->n_total : 1) * 2 * sizeof(FI_POINT_D));
+    for (FI_PATH *tmp = path; tmp != NULL; tmp = tmp->next) {
+        FI_POINT_D *pt = tmp->section.points;
+        switch (tmp->section.type) {
+        case FI_SEG_MOVE:
+            first = pt[0];
+            last = pt[0];
+            break;
+        case FI_SEG_LINE:
+            (*out)[n++] = last;
+            (*out)[n++] = pt[0];
+            last = pt[0];
+            break;
+        case FI_SEG_END:
+            (*out)[n++] = last;
+            (*out)[n++] = first;
+            break;
+        default:
+            break;
+        }
+    }
+    return n / 2;
+}
+
+bool _edges_inside(FI_POINT_D *edges, size_t n, FI_POINT_D p) {
+    bool inside = false;
+    for (size_t i = 0; i < n; i++) {
+        FI_POINT_D a = edges[2 * i];
+        FI_POINT_D b = edges[2 * i + 1];
+        if ((a.y > p.y) != (b.y > p.y) &&
+            p.x < a.x + (p.y - a.y) / (b.y - a.y) * (b.x - a.x))
+            inside = !inside;
+    }
+    return inside;
 }
 
-void test_empty() {
-    return;
+double _edges_distance(FI_POINT_D *edges, size_t n, FI_POINT_D p) {
+    double distance = INFINITY;
+    for (size_t i = 0; i < n; i++) {
+        FI_POINT_D a = edges[2 * i];
+        FI_POINT_D b = edges[2 * i + 1];
+        double dx = b.x - a.x;
+        double dy = b.y - a.y;
+        double len = dx * dx + dy * dy;
+        double t = len > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / len : 0;
+        t = fmin(fmax(t, 0), 1);
+        distance =
+            fmin(distance, hypot(a.x + t * dx - p.x, a.y + t * dy - p.y));
+    }
+    return distance;
+}
+
+/* sample points of a grid over [0, 10] x [0, 10] inside only one of 2 paths
+ * and farther than tolerance from the edges of the operands
+ */
+int _count_mismatches(FI_PATH *out, FI_PATH *expected, FI_PATH **operands,
+                      double tolerance) {
+    FI_POINT_D *edges[4];
+    size_t n[4];
+    FI_PATH *paths[4] = {out, expected, operands[0], operands[1]};
+    for (int k = 0; k < 4; k++)
+        n[k] = _path_edges(paths[k], &edges[k]);
+    int mismatches = 0;
+    for (int i = 0; i < 100; i++)
+        for (int j = 0; j < 100; j++) {
+            FI_POINT_D p = {0.1 * i + 0.037, 0.1 * j + 0.061};
+            if (_edges_inside(edges[0], n[0], p) ==
+                    _edges_inside(edges[1], n[1], p) ||
+                _edges_distance(edges[2], n[2], p) <= tolerance ||
+                _edges_distance(edges[3], n[3], p) <= tolerance)
+                continue;
+            mismatches++;
+        }
+    for (int k = 0; k < 4; k++)
+        free(edges[k]);
+    return mismatches;
+}
+
+void test_clip() {
+    FI_PATH *p1;
+    FI_PATH *p2;
+    FI_PATH *out;
+    int ret = _parse_path("M 0,0 L 10,0 L 10,10 L 0,10 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 5,5 L 15,5 L 15,15 L 5,15 Z", &p2);
+    CU_ASSERT(ret == 0);
+
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(out->meta->n_line == 3);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 25, 1e-9);
+    fi_free_path(out);
+
+    ret = fi_clip(p1, p2, FI_OR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 175, 1e-9);
+    fi_free_path(out);
+
+    ret = fi_clip(p1, p2, FI_XOR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    fi_free_path(out);
+
+    ret = fi_clip(p1, p2, FI_DIFF, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 75, 1e-9);
+    fi_free_path(out);
+
+    // disjoint shapes
+    fi_free_path(p2);
+    ret = _parse_path("M 20,0 L 30,0 L 25,10 Z", &p2);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT_PTR_NULL(out);
+    ret = fi_clip(p1, p2, FI_OR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 2);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 150, 1e-9);
+    fi_free_path(out);
+
+    // invalid operand
+    fi_free_path(p2);
+    ret = _parse_path("M 20,0 L 30,0 Z", &p2);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == ERR_PATH_SECTION_TOO_SHORT);
+
+    fi_free_path(p1);
+    fi_free_path(p2);
+}
+
+void test_clip_shapes() {
+    FI_PATH *p1;
+    FI_PATH *p2;
+    FI_PATH *out;
+    // concave "U" shape and a bar crossing both of its arms
+    int ret = _parse_path(
+        "M 0,0 L 30,0 L 30,30 L 20,30 L 20,10 L 10,10 L 10,30 L 0,30 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M -5,20 L 35,20 L 35,25 L -5,25 Z", &p2);
+    CU_ASSERT(ret == 0);
+
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 2);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 100, 1e-9);
+    fi_free_path(out);
+
+    ret = fi_clip(p2, p1, FI_DIFF, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 3);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 100, 1e-9);
+    fi_free_path(out);
+
+    // shared edge
+    fi_free_path(p2);
+    ret = _parse_path("M 30,0 L 40,0 L 40,30 L 30,30 Z", &p2);
+    ret = fi_clip(p1, p2, FI_OR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 1000, 1e-9);
+    fi_free_path(out);
+
+    // curved operand
+    fi_free_path(p2);
+    ret = _parse_path("M 5,5 C 5,40 25,40 25,5 L 15,0 Z", &p2);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    fi_free_path(out);
+
+    // 3 overlapping edges, 2 of them from the rings of the same operand
+    fi_free_path(p1);
+    fi_free_path(p2);
+    ret = _parse_path(
+        "M 0,0 L 4,0 L 4,3 L 2,4 L 0,4 Z M 0,1 L 3,0 L 3,4 L 1,4 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 0,1 L 3,0 L 4,4 L 0,4 Z", &p2);
+    CU_ASSERT(ret == 0);
+    ret = fi_clip(p1, p2, FI_XOR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 115.0 / 9, 1e-9);
+    fi_free_path(out);
+
+    // vertex of a ring exactly on an edge of the other ring
+    fi_free_path(p1);
+    fi_free_path(p2);
+    ret = _parse_path("M 0,5 L 9,4 L 8,7 Z M 7,7 L 5,6 L 0,7 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 6,1 L 6,8 L 3,6 Z", &p2);
+    CU_ASSERT(ret == 0);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 105926.0 / 18837, 1e-9);
+    fi_free_path(out);
+
+    // vertices exactly on the edges of both operands
+    fi_free_path(p1);
+    fi_free_path(p2);
+    ret = _parse_path("M 8,2 L 6,8 L 6,3 L 3,9 L 2,5 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 8,0 L 2,9 L 3,5 L 0,6 Z", &p2);
+    CU_ASSERT(ret == 0);
+    ret = fi_clip(p1, p2, FI_OR, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 5949.0 / 286, 1e-9);
+    fi_free_path(out);
+
+    // vertex exactly on an edge crossed near it
+    fi_free_path(p1);
+    fi_free_path(p2);
+    ret = _parse_path("M 2,0 L 5,6 L 6,4 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 4,4 L 8,0 L 3,5 L 2,6 L 9,2 Z", &p2);
+    CU_ASSERT(ret == 0);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT_PTR_NOT_NULL(out);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 79.0 / 77, 1e-9);
+    fi_free_path(out);
+
+    // vertex of a ring exactly on its own edge, both crossed by the clip path
+    fi_free_path(p1);
+    fi_free_path(p2);
+    ret = _parse_path("M 5,5 L 9,5 L 5,6 L 9,6 L 5,7 Z", &p1);
+    CU_ASSERT(ret == 0);
+    ret = _parse_path("M 8,2 L 4,9 L 6,3 Z", &p2);
+    CU_ASSERT(ret == 0);
+    ret = fi_clip(p1, p2, FI_AND, &out);
+    CU_ASSERT(ret == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT(fi_validate_path(out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 199.0 / 168, 1e-9);
+    fi_free_path(out);
+
+    fi_free_path(p1);
+    fi_free_path(p2);
+}
+
+void test_clip_prepared() {
+    FI_PATH *clip;
+    FI_PREPARED *prepared;
+    // concave clip path crossing itself, prepared once
+    int ret = _parse_path("M 0,0 L 30,0 L 30,30 L 20,30 L 20,10 L 10,10 "
+                          "L 10,30 L 0,30 Z M 25,-5 L 35,5 L 25,15 Z",
+                          &clip);
+    CU_ASSERT(ret == 0);
+    ret = fi_prepare_clip(clip, &prepared);
+    CU_ASSERT(ret == 0);
+
+    const char *subjects[] = {
+        "M -5,20 L 35,20 L 35,25 L -5,25 Z",
+        "M 12,12 L 18,12 L 18,28 L 12,28 Z",
+        "M 5,5 C 5,40 25,40 25,5 L 15,0 Z",
+        "M 100,100 L 110,100 L 110,110 Z",
+        "M 28,-2 L 32,-2 L 32,2 L 28,2 Z M 1,1 L 2,1 L 2,2 Z",
+    };
+    for (int i = 0; i < 5; i++) {
+        FI_PATH *subject;
+        _parse_path(subjects[i], &subject);
+        for (FI_OPS ops = FI_AND; ops <= FI_DIFF; ops++) {
+            FI_PATH *expected;
+            FI_PATH *out;
+            CU_ASSERT(fi_clip(subject, clip, ops, &expected) == 0);
+            CU_ASSERT(fi_clip_prepared(prepared, subject, ops, &out) == 0);
+            CU_ASSERT_DOUBLE_EQUAL(_path_area(out), _path_area(expected),
+                                   1e-9);
+            CU_ASSERT((out == NULL) == (expected == NULL));
+            if (out != NULL && expected != NULL)
+                CU_ASSERT(out->meta->n_move == expected->meta->n_move);
+            fi_free_path(out);
+            fi_free_path(expected);
+        }
+        fi_free_path(subject);
+    }
+
+    // empty operands and invalid subjects
+    FI_PATH *out;
+    CU_ASSERT(fi_clip_prepared(prepared, NULL, FI_OR, &out) == 0);
+    CU_ASSERT(out != NULL && out->meta->n_total == clip->meta->n_total);
+    fi_free_path(out);
+    FI_PATH *open;
+    _parse_path("M 0,0 L 10,0 L 10,10", &open);
+    CU_ASSERT(fi_clip_prepared(prepared, open, FI_AND, &out) ==
+              ERR_PATH_NO_MZ);
+    fi_free_prepared(prepared);
+
+    CU_ASSERT(fi_prepare_clip(open, &prepared) == ERR_PATH_NO_MZ);
+    CU_ASSERT_PTR_NULL(prepared);
+    CU_ASSERT(fi_prepare_clip(NULL, &prepared) == 0);
+    CU_ASSERT(fi_clip_prepared(prepared, clip, FI_DIFF, &out) == 0);
+    CU_ASSERT(out != NULL && out->meta->n_total == clip->meta->n_total);
+    fi_free_path(out);
+    fi_free_prepared(prepared);
+    fi_free_path(open);
+    fi_free_path(clip);
+}
+
+void test_path_convex() {
+    const char *convex[] = {
+        "M 0,0 L 4,0 L 0,3 Z",
+        "M 0,0 L 0,3 L 4,0 Z",
+        // repeated and collinear points, explicit closing point
+        "M 0,0 L 2,0 L 2,0 L 4,0 L 4,4 L 0,4 L 0,0 Z",
+    };
+    const char *concave[] = {
+        "M 0,0 L 4,0 L 4,4 L 2,1 L 0,4 Z",
+        // star, turning the same way at each corner
+        "M 0,10 L 6,-8 L -9.5,3 L 9.5,3 L -6,-8 Z",
+        "M 0,0 L 4,0 L 0,3 Z M 10,10 L 14,10 L 10,13 Z",
+        "M 0,0 L 4,0 L 8,0 Z",
+        "M 0,0 L 4,0 L 2,0 L 2,3 Z",
+        "M 0,0 Q 4,0 4,4 L 0,4 Z",
+    };
+    for (int i = 0; i < 3; i++) {
+        FI_PATH *path;
+        _parse_path(convex[i], &path);
+        CU_ASSERT(fi_path_convex(path));
+        fi_free_path(path);
+    }
+    for (int i = 0; i < 6; i++) {
+        FI_PATH *path;
+        _parse_path(concave[i], &path);
+        CU_ASSERT(!fi_path_convex(path));
+        fi_free_path(path);
+    }
+
+    // cached until a segment is added
+    FI_PATH *path;
+    FI_PATH *copy;
+    _parse_path("M 0,0 L 4,0 L 0,3 Z", &path);
+    CU_ASSERT(fi_path_convex(path));
+    CU_ASSERT(path->meta->convex_valid);
+    fi_copy_path(path, &copy);
+    CU_ASSERT(copy->meta->convex_valid && copy->meta->convex);
+    fi_append_new_seg(&copy, FI_SEG_MOVE);
+    fi_append_new_seg(&copy, FI_SEG_LINE);
+    fi_append_new_seg(&copy, FI_SEG_LINE);
+    fi_append_new_seg(&copy, FI_SEG_END);
+    CU_ASSERT(!copy->meta->convex_valid);
+    CU_ASSERT(!fi_path_convex(copy));
+    fi_free_path(copy);
+    fi_free_path(path);
+    CU_ASSERT(!fi_path_convex(NULL));
+}
+
+void test_bbox() {
+    FI_PATH *path;
+    FI_POINT_D bbox[2];
+    _parse_path("M 10,10 L 30,5 C 40,0 50,20 30,25 Z", &path);
+    fi_path_bbox(path, bbox);
+    // control points included
+    CU_ASSERT(bbox[0].x == 10 && bbox[0].y == 0);
+    CU_ASSERT(bbox[1].x == 50 && bbox[1].y == 25);
+    CU_ASSERT(path->meta->bbox_valid);
+
+    // moved with the path, kept by a copy
+    fi_offset_path(path, (FI_POINT_D){1, 2});
+    CU_ASSERT(path->meta->bbox_valid);
+    FI_PATH *copy;
+    fi_copy_path(path, &copy);
+    CU_ASSERT(copy->meta->bbox_valid);
+    fi_path_bbox(copy, bbox);
+    CU_ASSERT(bbox[0].x == 11 && bbox[0].y == 2);
+    CU_ASSERT(bbox[1].x == 51 && bbox[1].y == 27);
+
+    // computed again after an append
+    fi_append_new_seg(&copy, FI_SEG_MOVE);
+    copy->meta->last->section.points[0] = (FI_POINT_D){-5, 100};
+    fi_append_new_seg(&copy, FI_SEG_END);
+    CU_ASSERT(!copy->meta->bbox_valid);
+    fi_path_bbox(copy, bbox);
+    CU_ASSERT(bbox[0].x == -5 && bbox[0].y == 2);
+    CU_ASSERT(bbox[1].x == 51 && bbox[1].y == 100);
+    fi_free_path(copy);
+    fi_free_path(path);
+
+    // an arc is within its circle
+    _parse_path("M 0,0 A 10,10 0 0 1 20,0 Z", &path);
+    fi_path_bbox(path, bbox);
+    CU_ASSERT(bbox[0].x <= 0 && bbox[1].x >= 20);
+    CU_ASSERT(bbox[0].y <= -10 && bbox[1].y >= 10);
+    fi_free_path(path);
+
+    fi_path_bbox(NULL, bbox);
+    CU_ASSERT(bbox[0].x == INFINITY && bbox[1].x == -INFINITY);
+}
+
+void test_clip_bbox() {
+    FI_PATH *big;
+    FI_PATH *small;
+    FI_PATH *far;
+    FI_PATH *two;
+    FI_PATH *out;
+    _parse_path("M 0,0 L 100,0 L 100,100 L 0,100 Z", &big);
+    _parse_path("M 40,40 L 60,40 L 60,60 L 40,60 Z", &small);
+    _parse_path("M 200,0 L 210,0 L 210,10 Z", &far);
+    // a ring crossing small and a ring far from it
+    _parse_path("M 50,50 L 70,50 L 70,70 L 50,70 Z "
+                "M 500,500 L 510,500 L 510,510 L 500,510 Z",
+                &two);
+
+    // disjoint boxes
+    double far_area = _path_area(far);
+    CU_ASSERT(fi_clip(big, far, FI_AND, &out) == 0);
+    CU_ASSERT_PTR_NULL(out);
+    CU_ASSERT(fi_clip(big, far, FI_OR, &out) == 0);
+    CU_ASSERT(out->meta->n_move == 2);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 10000 + far_area, 1e-9);
+    fi_free_path(out);
+    CU_ASSERT(fi_clip(big, far, FI_DIFF, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 10000, 1e-9);
+    fi_free_path(out);
+
+    // one operand inside the other
+    double expected[2][4] = {{400, 10000, 10400, 0},
+                             {400, 10000, 10400, 10400}};
+    FI_PATH *operands[2][2] = {{small, big}, {big, small}};
+    for (int i = 0; i < 2; i++) {
+        for (FI_OPS ops = FI_AND; ops <= FI_DIFF; ops++) {
+            CU_ASSERT(fi_clip(operands[i][0], operands[i][1], ops, &out) == 0);
+            CU_ASSERT_DOUBLE_EQUAL(_path_area(out), expected[i][ops - 1],
+                                   1e-9);
+            CU_ASSERT(out == NULL || fi_validate_path(out) == 0);
+            fi_free_path(out);
+        }
+    }
+
+    // the far ring is not swept, but copied when part of the result
+    CU_ASSERT(fi_clip(two, small, FI_AND, &out) == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 100, 1e-9);
+    fi_free_path(out);
+    CU_ASSERT(fi_clip(two, small, FI_OR, &out) == 0);
+    CU_ASSERT(out->meta->n_move == 2);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 700 + 100, 1e-9);
+    fi_free_path(out);
+    CU_ASSERT(fi_clip(small, two, FI_DIFF, &out) == 0);
+    CU_ASSERT(out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 300, 1e-9);
+    fi_free_path(out);
+
+    fi_free_path(big);
+    fi_free_path(small);
+    fi_free_path(far);
+    fi_free_path(two);
+}
+
+void test_clip_convex() {
+    // overlapping, nested, apart with overlapping boxes
+    const char *pairs[][2] = {
+        {"M 2,0 L 4,2 L 2,4 L 0,2 Z", "M 1,1.5 L 5,0.5 L 1.5,5 Z"},
+        {"M 0,0 L 10,1 L 11,8 L 3,11 L -1,6 Z", "M 3,3 L 6,3.5 L 4,6 Z"},
+        {"M 3,3 L 6,3.5 L 4,6 Z", "M 0,0 L 10,1 L 11,8 L 3,11 L -1,6 Z"},
+        {"M 0,0 L 10,0 L 0,10 Z", "M 9,9 L 10,6 L 6,10 Z"},
+    };
+    const double areas[] = {-1, 4.25, 4.25, 0};
+    for (int i = 0; i < 4; i++) {
+        FI_PATH *p1;
+        FI_PATH *p2;
+        FI_PATH *out;
+        FI_PATH *both;
+        int ret = -1;
+        _parse_path(pairs[i][0], &p1);
+        _parse_path(pairs[i][1], &p2);
+        CU_ASSERT(fi_clip_convex(p1, p2, FI_AND, &out, &ret));
+        CU_ASSERT(ret == 0);
+        fi_free_path(out);
+
+        // same area as found by the sweep, from the union
+        CU_ASSERT(fi_clip(p1, p2, FI_AND, &out) == 0);
+        CU_ASSERT(fi_clip(p1, p2, FI_OR, &both) == 0);
+        double area = _path_area(p1) + _path_area(p2) - _path_area(both);
+        CU_ASSERT_DOUBLE_EQUAL(_path_area(out), area, 1e-9);
+        if (areas[i] >= 0)
+            CU_ASSERT_DOUBLE_EQUAL(_path_area(out), areas[i], 1e-9);
+        CU_ASSERT((out == NULL) == (areas[i] == 0));
+        fi_free_path(both);
+        fi_free_path(out);
+        fi_free_path(p1);
+        fi_free_path(p2);
+    }
+
+    // touching along an edge, left to the sweep
+    FI_PATH *p1;
+    FI_PATH *p2;
+    FI_PATH *out;
+    int ret;
+    _parse_path("M 0,0 L 4,0 L 0,4 Z", &p1);
+    _parse_path("M 4,0 L 0,4 L 4,4 L 5,2 Z", &p2);
+    CU_ASSERT(!fi_clip_convex(p1, p2, FI_AND, &out, &ret));
+    CU_ASSERT(fi_clip(p1, p2, FI_AND, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 0, 1e-9);
+    fi_free_path(out);
+    fi_free_path(p2);
+
+    // a rectangle clips a concave path
+    _parse_path("M -1,1 L 5,1 L 5,3 L -1,3 Z", &p2);
+    CU_ASSERT(!fi_clip_convex(p1, p2, FI_OR, &out, &ret));
+    CU_ASSERT(fi_clip_convex(p2, p1, FI_AND, &out, &ret));
+    CU_ASSERT(ret == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 4, 1e-9);
+    fi_free_path(out);
+    fi_free_path(p1);
+    _parse_path("M 0,0 L 4,0 L 4,4 L 2,2 L 0,4 Z", &p1);
+    CU_ASSERT(fi_clip_convex(p1, p2, FI_AND, &out, &ret));
+    CU_ASSERT(out != NULL && out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 7, 1e-9);
+    fi_free_path(out);
+    fi_free_path(p1);
+    fi_free_path(p2);
+}
+
+void test_clip_fixed() {
+    FI_PATH *p1;
+    FI_PATH *p2;
+    FI_PATH *moved;
+    FI_PATH *out;
+    FI_PATH *expected;
+    _parse_path("M 0.1,0.2 L 10.3,1.1 L 9.7,10.9 L 0.6,9.4 Z "
+                "M 3,3 L 7,3 L 7,7 L 3,7 Z",
+                &p1);
+    _parse_path("M 5.04,-2 L 14,5.55 L 5.05,13 L 1.2,5 Z", &p2);
+    for (int ops = FI_AND; ops <= FI_DIFF; ops++) {
+        CU_ASSERT(fi_clip_fixed(p1, p2, ops, 1000, &out) == 0);
+        CU_ASSERT(fi_clip(p1, p2, ops, &expected) == 0);
+        CU_ASSERT(out != NULL && fi_validate_path(out) == 0);
+        CU_ASSERT_DOUBLE_EQUAL(_path_area(out), _path_area(expected), 1e-2);
+        // all the points on the grid
+        bool on_grid = true;
+        for (FI_PATH *tmp = out; tmp != NULL; tmp = tmp->next)
+            for (int i = 0; i < tmp->section.n_point; i++) {
+                FI_POINT_D pt = tmp->section.points[i];
+                on_grid &= fabs(pt.x * 1000 - round(pt.x * 1000)) < 1e-6 &&
+                           fabs(pt.y * 1000 - round(pt.y * 1000)) < 1e-6;
+            }
+        CU_ASSERT(on_grid);
+
+        // moves below the step of the grid do not change the result
+        FI_PATH *out2;
+        fi_copy_path(p1, &moved);
+        fi_offset_path(moved, (FI_POINT_D){1e-5, -1e-5});
+        CU_ASSERT(fi_clip_fixed(moved, p2, ops, 1000, &out2) == 0);
+        CU_ASSERT(out2 != NULL && out->meta->n_total == out2->meta->n_total);
+        bool same = out2 != NULL;
+        for (FI_PATH *a = out, *b = out2; same && a != NULL;
+             a = a->next, b = b->next)
+            for (int i = 0; i < a->section.n_point; i++)
+                same &= a->section.points[i].x == b->section.points[i].x &&
+                        a->section.points[i].y == b->section.points[i].y;
+        CU_ASSERT(same);
+        fi_free_path(out2);
+        fi_free_path(moved);
+        fi_free_path(expected);
+        fi_free_path(out);
+    }
+
+    // against fi_clip(): snapped, the edges move by less than a pixel and the
+    // results only differ along them
+    srand(20);
+    FI_PATH *operands[2];
+    for (int k = 0; k < 100; k++) {
+        for (int j = 0; j < 2; j++) {
+            char buf[1024] = "";
+            for (int ring = 0; ring < 2; ring++) {
+                int n = 3 + rand() % 6;
+                for (int i = 0; i < n; i++)
+                    snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+                             "%c %.17g,%.17g ", i ? 'L' : 'M',
+                             10.0 * rand() / RAND_MAX,
+                             10.0 * rand() / RAND_MAX);
+                strcat(buf, "Z ");
+            }
+            _parse_path(buf, &operands[j]);
+        }
+        double scale = k % 2 ? 1000 : 10;
+        for (int ops = FI_AND; ops <= FI_DIFF; ops++) {
+            CU_ASSERT(fi_clip_fixed(operands[0], operands[1], ops, scale,
+                                    &out) == 0);
+            CU_ASSERT(fi_clip(operands[0], operands[1], ops, &expected) == 0);
+            CU_ASSERT(_count_mismatches(out, expected, operands, 1 / scale) ==
+                      0);
+            fi_free_path(expected);
+            fi_free_path(out);
+        }
+        fi_free_path(operands[0]);
+        fi_free_path(operands[1]);
+    }
+
+    // near vertical edges, rounded crossings in pixels out of the range of
+    // the edges
+    _parse_path("M 5.2188596973586616,3.6975249541703952 "
+                "L 1.1803604843563062,2.0120597179078699 "
+                "L 5.2153910117358526,2.0198655041255007 "
+                "L 6.5568557121329496,3.2573955299045294 "
+                "L 4.4517830212992937,3.5381713109564905 Z",
+                &operands[0]);
+    _parse_path("M 6.8149828177300691,5.3592551564867215 "
+                "L 2.46144862651603,7.1213784875027724 "
+                "L 2.5385644934145839,4.8065362557551108 "
+                "L 2.5397115675951873,1.819321464142456 "
+                "L 3.4304471369235401,2.7822143679409099 "
+                "L 6.0931240485925233,1.6026477856002472 Z",
+                &operands[1]);
+    CU_ASSERT(fi_clip_fixed(operands[0], operands[1], FI_DIFF, 1000, &out) ==
+              0);
+    CU_ASSERT(fi_clip(operands[0], operands[1], FI_DIFF, &expected) == 0);
+    CU_ASSERT(_count_mismatches(out, expected, operands, 1e-3) == 0);
+    fi_free_path(expected);
+    fi_free_path(out);
+    fi_free_path(operands[0]);
+    fi_free_path(operands[1]);
+
+    // an empty operand, the other one is snapped
+    CU_ASSERT(fi_clip_fixed(p2, NULL, FI_OR, 10, &out) == 0);
+    CU_ASSERT(out != NULL && out->meta->n_total == p2->meta->n_total);
+    CU_ASSERT(out->section.points[0].x == 5);
+    CU_ASSERT(out->meta->last->prev->section.points[0].x == 1.2);
+    fi_free_path(out);
+
+    CU_ASSERT(fi_clip_fixed(p1, p2, FI_AND, 0, &out) == ERR_FIXED_RANGE);
+    CU_ASSERT_PTR_NULL(out);
+    CU_ASSERT(fi_clip_fixed(p1, p2, FI_AND, 1e7, &out) == ERR_FIXED_RANGE);
+    CU_ASSERT_PTR_NULL(out);
+    fi_free_path(p1);
+    fi_free_path(p2);
+}
+
+void test_intersects() {
+    // the kernel gives the hits of the scalar filter, and all the segments
+    // meeting the tested one (some of them through an endpoint or collinear)
+    FI_SEGMENTS segs = {0};
+    double t[64];
+    srand(22);
+    for (int i = 0; i < 64; i++) {
+        FI_POINT_D s = {rand() % 9, rand() % 9};
+        FI_POINT_D e = {rand() % 9, rand() % 9};
+        if (i % 5 == 0)
+            e = (FI_POINT_D){s.x + 0.1 * (rand() % 3), s.y + 1e-17 * i};
+        fi_segments_add(&segs, s, e);
+    }
+    for (int k = 0; k < 100; k++) {
+        FI_POINT_D a1 = {rand() % 9, rand() % 9};
+        FI_POINT_D a2 = {rand() % 9 + 0.5 * (k % 2), rand() % 9};
+        for (size_t n = 1; n <= 64; n += 21) {
+            uint64_t mask = fi_segments_hit(&segs, 64 - n, n, a1, a2, t);
+            for (size_t i = 0; i < n; i++) {
+                size_t j = 64 - n + i;
+                FI_POINT_D b1 = {segs.x1[j], segs.y1[j]};
+                FI_POINT_D b2 = {segs.x2[j], segs.y2[j]};
+                double tj;
+                bool hit = (mask >> i) & 1;
+                CU_ASSERT_EQUAL(hit, fi_segment_hit(a1, a2, b1, b2, &tj));
+                if (fi_segments_meet(a1, a2, b1, b2))
+                    CU_ASSERT(hit);
+                double o1 = fi_orient2d(a1, a2, b1);
+                double o2 = fi_orient2d(a1, a2, b2);
+                if (hit && o1 * o2 < 0)
+                    CU_ASSERT_DOUBLE_EQUAL(t[i], tj, 1e-12);
+            }
+        }
+    }
+    fi_free_segments(&segs);
+
+    const char *pairs[][2] = {
+        {"M 0,0 L 4,0 L 4,4 L 0,4 Z", "M 2,2 L 6,2 L 6,6 L 2,6 Z"},
+        {"M 0,0 L 4,0 L 4,4 L 0,4 Z", "M 1,1 L 2,1 L 2,2 Z"},
+        {"M 0,0 L 4,0 L 4,4 L 0,4 Z", "M 4,4 L 6,4 L 6,6 Z"},
+        {"M 0,0 L 10,0 L 10,2 L 2,2 L 2,10 L 0,10 Z",
+         "M 1,11 L 11,11 L 11,1 Z"},
+        // apart, with overlapping boxes
+        {"M 0,0 L 10,0 L 10,2 L 2,2 L 2,10 L 0,10 Z",
+         "M 2,11 L 11,11 L 11,2 Z"},
+        {"M 0,0 L 10,0 L 10,10 L 0,10 Z M 2,2 L 8,2 L 8,8 L 2,8 Z",
+         "M 3,3 L 7,3 L 5,7 Z"},
+        {"M 0,0 L 4,0 L 4,4 L 0,4 Z", "M 5,0 L 9,0 L 9,4 L 5,4 Z"},
+    };
+    bool expected[] = {true, true, true, true, false, false, false};
+    for (int i = 0; i < 7; i++) {
+        FI_PATH *p1;
+        FI_PATH *p2;
+        bool meet;
+        _parse_path(pairs[i][0], &p1);
+        _parse_path(pairs[i][1], &p2);
+        CU_ASSERT(fi_intersects(p1, p2, &meet) == 0);
+        CU_ASSERT_EQUAL(meet, expected[i]);
+        CU_ASSERT(fi_intersects(p2, p1, &meet) == 0);
+        CU_ASSERT_EQUAL(meet, expected[i]);
+
+        // edges apart, the clipping is done ring by ring
+        for (int ops = FI_AND; ops <= FI_DIFF && i >= 4; ops++) {
+            FI_PATH *out;
+            FI_PATH *swept;
+            FI_SWEEP_STATE sweep = {0};
+            CU_ASSERT(fi_clip(p1, p2, ops, &out) == 0);
+            sweep.ops = ops;
+            CU_ASSERT(fi_clip_rings(&sweep, p1, p2, &swept) == 0);
+            fi_free_sweep(&sweep);
+            CU_ASSERT_DOUBLE_EQUAL(_path_area(out), _path_area(swept), 1e-9);
+            fi_free_path(out);
+            fi_free_path(swept);
+        }
+        fi_free_path(p1);
+        fi_free_path(p2);
+    }
+    bool meet = true;
+    CU_ASSERT(fi_intersects(NULL, NULL, &meet) == 0);
+    CU_ASSERT(!meet);
+}
+
+void test_clip_rect() {
+    FI_POINT_D rect[2] = {{0, 0}, {10, 10}};
+    FI_PATH *clip;
+    _parse_path("M 0,0 L 10,0 L 10,10 L 0,10 Z", &clip);
+
+    const char *subjects[] = {
+        // concave, cut in 2 by the rectangle
+        "M -5,2 L 15,2 L 15,8 L 12,8 L 12,4 L -2,4 L -2,8 L -5,8 Z",
+        "M 5,-5 L 15,5 L 5,15 L -5,5 Z M 4,4 L 6,4 L 6,6 Z",
+        "M -5,-5 L 15,-5 L 15,15 L -5,15 Z M 2,2 L 8,2 L 8,8 L 2,8 Z",
+        "M 0,0 L 20,0 L 20,10 L 0,10 Z",
+        "M 3,3 C 3,20 7,20 7,3 L 5,-2 Z",
+        "M 20,20 L 30,20 L 30,30 Z",
+    };
+    for (int i = 0; i < 6; i++) {
+        FI_PATH *subject;
+        FI_PATH *expected;
+        FI_PATH *out;
+        _parse_path(subjects[i], &subject);
+        CU_ASSERT(fi_clip(subject, clip, FI_AND, &expected) == 0);
+        CU_ASSERT(fi_clip_rect(subject, rect, &out) == 0);
+        CU_ASSERT_DOUBLE_EQUAL(_path_area(out), _path_area(expected), 1e-9);
+        CU_ASSERT((out == NULL) == (expected == NULL));
+        if (out != NULL && expected != NULL) {
+            CU_ASSERT(fi_validate_path(out) == 0);
+            CU_ASSERT(out->meta->n_move == expected->meta->n_move);
+        }
+        fi_free_path(out);
+        fi_free_path(expected);
+        fi_free_path(subject);
+    }
+
+    // touching the bottom side from outside before going in: no spike along
+    // the side
+    FI_PATH *subject;
+    FI_PATH *out;
+    _parse_path("M 2,-5 L 2,0 L 4,0 L 4,5 L 8,5 L 8,-5 Z", &subject);
+    CU_ASSERT(fi_clip_rect(subject, rect, &out) == 0);
+    CU_ASSERT(out != NULL && out->meta->n_move == 1 && out->meta->n_line == 3);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 20, 1e-9);
+    fi_free_path(out);
+    fi_free_path(subject);
+
+    // touching a corner from outside: the side of the gaps is not taken there
+    FI_POINT_D small[2] = {{0, 0}, {4, 4}};
+    _parse_path("M -5,-5 L 2,-1 L 5,2 L 5,10 L 1,5 L 0,4 L -5,3 Z", &subject);
+    CU_ASSERT(fi_clip_rect(subject, small, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 15.5, 1e-9);
+    fi_free_path(out);
+    fi_free_path(subject);
+    FI_POINT_D tall[2] = {{3, 1}, {5, 6}};
+    _parse_path("M 10,7 L 7,9 L 6,9 L 5,7 L 1,5 L 4,-1 L 6,4 L 10,3 Z",
+                &subject);
+    CU_ASSERT(fi_clip_rect(subject, tall, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 9.95, 1e-9);
+    fi_free_path(out);
+    fi_free_path(subject);
+
+    // the rectangle inside the subject, empty rectangle
+    _parse_path("M -1,-1 L 11,-1 L 11,11 L -1,11 Z", &subject);
+    CU_ASSERT(fi_clip_rect(subject, rect, &out) == 0);
+    CU_ASSERT(out != NULL && out->meta->n_move == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 100, 1e-9);
+    fi_free_path(out);
+    FI_POINT_D empty[2] = {{5, 5}, {5, 8}};
+    CU_ASSERT(fi_clip_rect(subject, empty, &out) == 0);
+    CU_ASSERT_PTR_NULL(out);
+    CU_ASSERT(fi_clip_rect(NULL, rect, &out) == 0);
+    CU_ASSERT_PTR_NULL(out);
+    fi_free_path(subject);
+    fi_free_path(clip);
+}
+
+void test_clip_batch() {
+    FI_PATH *paths[6];
+    const char *data[] = {
+        "M 0,0 L 30,0 L 30,30 L 20,30 L 20,10 L 10,10 L 10,30 L 0,30 Z",
+        "M -5,20 L 35,20 L 35,25 L -5,25 Z",
+        "M 5,5 C 5,40 25,40 25,5 L 15,0 Z",
+        "M 100,100 L 110,100 L 110,110 Z",
+        "M 28,-2 L 32,-2 L 32,2 L 28,2 Z M 1,1 L 2,1 L 2,2 Z",
+        "M 0,0 L 10,0 L 10,10",
+    };
+    for (int i = 0; i < 6; i++)
+        CU_ASSERT(_parse_path(data[i], &paths[i]) == 0);
+
+    // every pair of valid paths with every operation, the same paths shared
+    // by many jobs
+    FI_CLIP_JOB jobs[5 * 5 * 4];
+    size_t n_job = 0;
+    for (int i = 0; i < 5; i++)
+        for (int j = 0; j < 5; j++)
+            for (FI_OPS ops = FI_AND; ops <= FI_DIFF; ops++)
+                jobs[n_job++] = (FI_CLIP_JOB){paths[i], paths[j], ops};
+
+    int n_threads[] = {1, 3, 0, 200};
+    for (int t = 0; t < 4; t++) {
+        CU_ASSERT(fi_clip_batch(jobs, n_job, n_threads[t]) == 0);
+        // the caches written by the clippings are filled before the threads
+        for (int i = 0; i < 5; i++)
+            CU_ASSERT(paths[i]->meta->bbox_valid &&
+                      paths[i]->meta->convex_valid);
+        for (size_t k = 0; k < n_job; k++) {
+            FI_PATH *expected;
+            CU_ASSERT(jobs[k].ret == 0);
+            CU_ASSERT(fi_clip(jobs[k].subject, jobs[k].clip, jobs[k].ops,
+                              &expected) == 0);
+            CU_ASSERT((jobs[k].out == NULL) == (expected == NULL));
+            CU_ASSERT_DOUBLE_EQUAL(_path_area(jobs[k].out),
+                                   _path_area(expected), 1e-9);
+            if (jobs[k].out != NULL && expected != NULL)
+                CU_ASSERT(jobs[k].out->meta->n_total ==
+                          expected->meta->n_total);
+            fi_free_path(expected);
+            fi_free_path(jobs[k].out);
+            jobs[k].out = NULL;
+        }
+    }
+
+    // the first error in the order of the jobs is returned
+    FI_CLIP_JOB bad[3] = {{paths[0], paths[1], FI_AND},
+                          {paths[5], paths[1], FI_OR},
+                          {paths[2], paths[3], FI_XOR}};
+    CU_ASSERT(fi_clip_batch(bad, 3, 2) == ERR_PATH_NO_MZ);
+    CU_ASSERT(bad[0].ret == 0 && bad[0].out != NULL);
+    CU_ASSERT(bad[1].ret == ERR_PATH_NO_MZ && bad[1].out == NULL);
+    CU_ASSERT(bad[2].ret == 0 && bad[2].out != NULL);
+    for (int k = 0; k < 3; k++)
+        fi_free_path(bad[k].out);
+    CU_ASSERT(fi_clip_batch(NULL, 0, 4) == 0);
+
+    for (int i = 0; i < 6; i++)
+        fi_free_path(paths[i]);
+}
+
+void test_clip_many() {
+    // squares overlapping their neighbours on a grid, and shifted squares
+    // with a common part
+    FI_PATH *grid[12];
+    FI_PATH *shifted[7];
+    char buf[128];
+    for (int i = 0; i < 12; i++) {
+        double x = 2 * (i % 4);
+        double y = 2 * (i / 4) + 0.5 * (i % 2);
+        snprintf(buf, sizeof(buf), "M %g,%g L %g,%g L %g,%g L %g,%g Z", x, y,
+                 x + 3, y, x + 3, y + 3, x, y + 3);
+        CU_ASSERT(_parse_path(buf, &grid[i]) == 0);
+    }
+    for (int i = 0; i < 7; i++) {
+        double x = 0.5 * i;
+        double y = 0.25 * i;
+        snprintf(buf, sizeof(buf), "M %g,%g L %g,%g L %g,%g L %g,%g Z", x, y,
+                 x + 5, y, x + 5, y + 6, x, y + 6);
+        CU_ASSERT(_parse_path(buf, &shifted[i]) == 0);
+    }
+
+    FI_PATH **sets[] = {grid, shifted};
+    size_t sizes[] = {12, 7};
+    for (int k = 0; k < 2; k++) {
+        for (FI_OPS ops = FI_AND; ops <= FI_DIFF; ops++) {
+            // the same operation one path after the other
+            FI_PATH *expected = NULL;
+            fi_copy_path(sets[k][0], &expected);
+            for (size_t i = 1; i < sizes[k]; i++) {
+                FI_PATH *next;
+                CU_ASSERT(fi_clip(expected, sets[k][i], ops, &next) == 0);
+                fi_free_path(expected);
+                expected = next;
+            }
+            for (int n_thread = 1; n_thread <= 4; n_thread += 3) {
+                FI_PATH *out;
+                CU_ASSERT(fi_clip_many(sets[k], sizes[k], ops, n_thread,
+                                       &out) == 0);
+                CU_ASSERT((out == NULL) == (expected == NULL));
+                CU_ASSERT_DOUBLE_EQUAL(_path_area(out), _path_area(expected),
+                                       1e-9);
+                fi_free_path(out);
+            }
+            fi_free_path(expected);
+        }
+    }
+
+    // empty operands, a single one, none
+    FI_PATH *out;
+    FI_PATH *some[3] = {grid[0], NULL, grid[10]};
+    CU_ASSERT(fi_clip_many(some, 3, FI_OR, 2, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 18, 1e-9);
+    fi_free_path(out);
+    CU_ASSERT(fi_clip_many(some, 3, FI_AND, 2, &out) == 0);
+    CU_ASSERT(out == NULL);
+    CU_ASSERT(fi_clip_many(some, 1, FI_DIFF, 2, &out) == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(out), 9, 1e-9);
+    CU_ASSERT(out != grid[0]);
+    fi_free_path(out);
+    CU_ASSERT(fi_clip_many(some, 0, FI_XOR, 2, &out) == 0);
+    CU_ASSERT(out == NULL);
+
+    FI_PATH *bad;
+    CU_ASSERT(_parse_path("M 0,0 L 10,0 L 10,10", &bad) == 0);
+    some[1] = bad;
+    CU_ASSERT(fi_clip_many(some, 3, FI_OR, 2, &out) == ERR_PATH_NO_MZ);
+    CU_ASSERT(out == NULL);
+    fi_free_path(bad);
+
+    for (int i = 0; i < 12; i++)
+        fi_free_path(grid[i]);
+    for (int i = 0; i < 7; i++)
+        fi_free_path(shifted[i]);
+}
+
+void test_overlay() {
+    // a U shaped subject, rows of parcels overlapping their neighbours, a
+    // parcel covering everything, one far away and a triangle
+    FI_PATH *subject;
+    CU_ASSERT(_parse_path("M 0,0 L 10,0 L 10,10 L 6,10 L 6,4 L 4,4 L 4,10 "
+                          "L 0,10 Z",
+                          &subject) == 0);
+    FI_PATH *clips[13] = {NULL};
+    char buf[128];
+    for (int i = 0; i < 9; i++) {
+        double x = 3.5 * (i % 3) - 1;
+        double y = 3.5 * (i / 3) - 1;
+        snprintf(buf, sizeof(buf), "M %g,%g L %g,%g L %g,%g L %g,%g Z", x, y,
+                 x + 4.5, y, x + 4.5, y + 3, x, y + 3);
+        CU_ASSERT(_parse_path(buf, &clips[i]) == 0);
+    }
+    CU_ASSERT(_parse_path("M -1,-1 L 11,-1 L 11,11 L -1,11 Z", &clips[9]) ==
+              0);
+    CU_ASSERT(_parse_path("M 20,20 L 30,20 L 30,30 Z", &clips[10]) == 0);
+    CU_ASSERT(_parse_path("M 0,0 L 10,10 L 10,0 Z", &clips[12]) == 0);
+
+    FI_OVERLAY_FACE *faces;
+    size_t n_face;
+    CU_ASSERT(fi_overlay(subject, clips, 13, &faces, &n_face) == 0);
+    CU_ASSERT(n_face > 9);
+    double total = 0;
+    double per_clip[13] = {0};
+    for (size_t i = 0; i < n_face; i++) {
+        double area = _path_area(faces[i].path);
+        CU_ASSERT(area > 0);
+        total += area;
+        for (size_t j = 0; j < faces[i].n_label; j++) {
+            CU_ASSERT(faces[i].labels[j] < 13);
+            CU_ASSERT(j == 0 || faces[i].labels[j - 1] < faces[i].labels[j]);
+            per_clip[faces[i].labels[j]] += area;
+        }
+        // every face is covered by the parcel around everything
+        CU_ASSERT(faces[i].n_label > 0);
+        CU_ASSERT(faces[i].labels[faces[i].n_label - 1] >= 9);
+    }
+    CU_ASSERT_DOUBLE_EQUAL(total, 88, 1e-9);
+
+    // the faces of a parcel are its part of the subject
+    for (int i = 0; i < 13; i++) {
+        FI_PATH *part;
+        CU_ASSERT(fi_clip(subject, clips[i], FI_AND, &part) == 0);
+        CU_ASSERT_DOUBLE_EQUAL(per_clip[i], _path_area(part), 1e-9);
+        fi_free_path(part);
+    }
+    fi_free_overlay(faces, n_face);
+
+    // the part of the subject covered by no parcel
+    CU_ASSERT(fi_overlay(subject, clips, 9, &faces, &n_face) == 0);
+    FI_PATH *all;
+    FI_PATH *rest;
+    CU_ASSERT(fi_clip_many(clips, 9, FI_OR, 1, &all) == 0);
+    CU_ASSERT(fi_clip(subject, all, FI_DIFF, &rest) == 0);
+    CU_ASSERT(n_face > 0 && faces[0].n_label == 0);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(faces[0].path), _path_area(rest), 1e-9);
+    fi_free_path(all);
+    fi_free_path(rest);
+    fi_free_overlay(faces, n_face);
+
+    // a parcel on the subject, no subject, a broken parcel
+    CU_ASSERT(fi_overlay(subject, &subject, 1, &faces, &n_face) == 0);
+    CU_ASSERT(n_face == 1 && faces[0].n_label == 1);
+    CU_ASSERT_DOUBLE_EQUAL(_path_area(faces[0].path), 88, 1e-9);
+    fi_free_overlay(faces, n_face);
+    CU_ASSERT(fi_overlay(NULL, clips, 13, &faces, &n_face) == 0);
+    CU_ASSERT(faces == NULL && n_face == 0);
+    CU_ASSERT(_parse_path("M 0,0 L 10,0 L 10,10", &clips[11]) == 0);
+    CU_ASSERT(fi_overlay(subject, clips, 13, &faces, &n_face) ==
+              ERR_PATH_NO_MZ);
+    CU_ASSERT(faces == NULL && n_face == 0);
+
+    fi_free_path(subject);
+    for (int i = 0; i < 13; i++)
+        fi_free_path(clips[i]);
 }
 
 int main(int argc, char **argv) {
@@ -639,15 +2499,25 @@ int main(int argc, char **argv) {
 
     /* add the tests to the suite */
     if ((NULL == CU_add_test(pSuite, "test of fi_draw_path()", test_parse)) ||
+        (NULL ==
+         CU_add_test(pSuite, "path data grammar", test_parse_grammar)) ||
+        (NULL == CU_add_test(pSuite, "number conversion", test_parse_number)) ||
+        (NULL == CU_add_test(pSuite, "incremental parser", test_parser)) ||
+        (NULL == CU_add_test(pSuite, "path data writer", test_writer)) ||
         (NULL == CU_add_test(pSuite, "test of fi_draw_path() (error wrong)",
                              test_parse_fail)) ||
         (NULL == CU_add_test(pSuite, "test of fi_draw_path() (error too long)",
                              test_parse_fail_to_long)) ||
+        (NULL == CU_add_test(pSuite, "fi_reserve_path()", test_reserve)) ||
         (NULL == CU_add_test(pSuite, "test reverse list", test_reverse)) ||
         (NULL ==
          CU_add_test(pSuite, "test validation of path", test_validate)) ||
         (NULL == CU_add_test(pSuite, "test offset", test_offset)) ||
-        (NULL == CU_add_test(pSuite, "fi_copy_path", test_copy))) {
+        (NULL == CU_add_test(pSuite, "fi_copy_path", test_copy)) ||
+        (NULL == CU_add_test(pSuite, "packed path", test_packed)) ||
+        (NULL == CU_add_test(pSuite, "binary path data", test_binary)) ||
+        (NULL == CU_add_test(pSuite, "fi_path_bbox()", test_bbox)) ||
+        (NULL == CU_add_test(pSuite, "fi_path_convex()", test_path_convex))) {
         CU_cleanup_registry();
         return CU_get_error();
     }
@@ -667,7 +2537,14 @@ int main(int argc, char **argv) {
         (NULL ==
          CU_add_test(pSuite, "test of bezier arc to segment", test_arc2seg)) ||
 
-        (NULL == CU_add_test(pSuite, "test meta after convert", test_meta))) {
+        (NULL == CU_add_test(pSuite, "test meta after convert", test_meta)) ||
+        (NULL == CU_add_test(pSuite, "segments in an arena", test_arena)) ||
+        (NULL == CU_add_test(pSuite, "fi_linearize_tolerance()",
+                             test_linearize_tolerance)) ||
+        (NULL == CU_add_test(pSuite, "bezier sampling kernel",
+                             test_bezier_points)) ||
+        (NULL == CU_add_test(pSuite, "arc tolerance", test_arc_tolerance)) ||
+        (NULL == CU_add_test(pSuite, "fi_linearize_to()", test_linearize_to))) {
         CU_cleanup_registry();
         return CU_get_error();
     }
@@ -680,7 +2557,24 @@ int main(int argc, char **argv) {
 
     /* add the tests to the suite */
     if ((NULL == CU_add_test(pSuite, "test sorted", test_sort)) ||
-        (NULL == CU_add_test(pSuite, "place holder 5", test_empty))) {
+        (NULL == CU_add_test(pSuite, "event queue", test_event_queue)) ||
+        (NULL == CU_add_test(pSuite, "sweep line status", test_status)) ||
+        (NULL ==
+         CU_add_test(pSuite, "geometric predicates", test_predicates)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip() squares", test_clip)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip() shapes", test_clip_shapes)) ||
+        (NULL ==
+         CU_add_test(pSuite, "fi_clip_prepared()", test_clip_prepared)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip() bounding boxes",
+                             test_clip_bbox)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip_rect()", test_clip_rect)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip() convex operands",
+                             test_clip_convex)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip_fixed()", test_clip_fixed)) ||
+        (NULL == CU_add_test(pSuite, "fi_intersects()", test_intersects)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip_batch()", test_clip_batch)) ||
+        (NULL == CU_add_test(pSuite, "fi_clip_many()", test_clip_many)) ||
+        (NULL == CU_add_test(pSuite, "fi_overlay()", test_overlay))) {
         CU_cleanup_registry();
         return CU_get_error();
     }